@@ -60,6 +60,9 @@
         #include <unistd.h> // needed for close()
         #include <string>
     #endif
+    #include <string>
+    #include <vector>
+    #include <atomic>
 
     #ifdef OMICRON_OS_WIN     
         #define PRINT_SOCKET_ERROR(msg) printf(msg" - socket error: %d\n", WSAGetLastError());
@@ -492,6 +495,39 @@ namespace omicronConnector
             return OINT_PTR(extraData[index * 4]);
         }
     };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // Reliable UDP channel, enabled by clients that set the ReliableUDP flag (1 << 14) in their
+    // V3 handshake. Every datagram sent to such a client starts with a ReliableHeader, followed by a
+    // regular event packet. Reliable packets (discrete events like Down, Up and Click) carry their own
+    // sequence number. Unreliable packets (Update and Move) carry the sequence number of the last 
+    // reliable packet sent before them, so the client can keep both streams in order. The client 
+    // acknowledges reliable packets by sending a header-only Ack datagram back to the server.
+    enum ReliablePacketKind
+    {
+        ReliableKindUnreliable = 0,
+        ReliableKindReliable = 1,
+        ReliableKindAck = 2
+    };
+
+    struct ReliableHeader
+    {
+        //! Always ReliableMagic. Its value can never be a valid event timestamp, so plain event
+        //! packets are not mistaken for channel packets.
+        unsigned int magic;
+        unsigned int kind;
+        //! Reliable: the packet sequence number. Unreliable: the sequence number of the last
+        //! reliable packet sent. Ack: the last sequence number received in order.
+        unsigned int seq;
+        //! Reliable and Unreliable: the oldest sequence number the server still retransmits;
+        //! anything older has been given up on. Ack: selective ack bitmask, where bit i is set
+        //! if sequence number seq + 2 + i has been received.
+        unsigned int aux;
+    };
+
+    static const unsigned int ReliableMagic = 0x4c524d4f;
+    //! Maximum number of reliable packets in flight.
+    static const int ReliableWindowSize = 256;
 #endif
 
 // if OMICRON_CONNECTOR_LEAN_AND_MEAN, only define the omicron::EventBase and omicronConnector::EventData classes.
@@ -508,22 +544,162 @@ namespace omicronConnector
         virtual void onEvent(const EventData& e) = 0;
     };
 
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    //! Table of the latest event received from each (serviceType, sourceId) pair.
+    //! The table has a single writer (the thread polling the connector) and any number of readers.
+    //! Each slot is protected by a sequence lock: the writer makes the slot sequence number odd while
+    //! it updates the slot, and readers retry if the sequence number was odd or changed during their
+    //! copy. Readers never block the writer or each other, so render threads can read the latest
+    //! head and wand poses at frame start without queues or locks.
+    //! Slots are allocated on first use and never released. Extra data is truncated to
+    //! MaxExtraDataSize bytes, enough for skeleton joints but not for images.
+    class EventStateTable
+    {
+    public:
+        static const int MaxExtraDataSize = DEFAULT_BUFLEN;
+
+        //! capacity is rounded up to a power of two. Keep it at least twice the number of sources.
+        EventStateTable(int capacity = 256);
+        ~EventStateTable();
+
+        //! Stores an event. Writer thread only.
+        void update(const EventData& ed, int extraDataLength);
+        //! Copies the latest event of a source. Returns false if no event was received from it.
+        bool get(unsigned int serviceType, unsigned int sourceId, EventData* ed) const;
+        //! Copies the latest pose (x, y, z and w, x, y, z) and flags of a source, skipping extra data.
+        bool getPose(unsigned int serviceType, unsigned int sourceId, float* position, float* orientation, unsigned int* flags = NULL) const;
+        //! Returns the number of sources in the table.
+        int getSize() const { return size.load(std::memory_order_acquire); }
+
+    private:
+        //! Fields read while the writer may update them are relaxed atomics, so readers get
+        //! either the old or the new value, and the sequence check discards mixed copies.
+        //! Extra data is copied with memcpy instead, as it is too large to copy word by word.
+        //! A reader copying it during an update gets torn bytes, but they are discarded the
+        //! same way, and the length used for the copy is clamped first.
+        struct SlotData
+        {
+            std::atomic<unsigned int> timestamp;
+            std::atomic<unsigned int> deviceTag;
+            std::atomic<unsigned int> type;
+            std::atomic<unsigned int> flags;
+            std::atomic<float> pos[3];
+            std::atomic<float> orient[4];
+            std::atomic<unsigned int> extraDataType;
+            std::atomic<int> extraDataItems;
+            std::atomic<unsigned int> extraDataMask;
+            std::atomic<int> extraDataLength;
+            unsigned char extraData[MaxExtraDataSize];
+        };
+
+        struct Slot
+        {
+            std::atomic<unsigned int> sequence;
+            //! 0 if the slot is free, (serviceType + 1) << 32 | sourceId otherwise.
+            std::atomic<unsigned long long> key;
+            SlotData data;
+        };
+
+        static unsigned long long makeKey(unsigned int serviceType, unsigned int sourceId)
+        { return ((unsigned long long)(serviceType + 1) << 32) | sourceId; }
+        const Slot* find(unsigned long long key) const;
+        template<typename ReadFunc> bool read(const Slot* slot, ReadFunc& func) const;
+
+        // Not copyable
+        EventStateTable(const EventStateTable&);
+        EventStateTable& operator=(const EventStateTable&);
+
+        Slot* slots;
+        unsigned int mask;
+        std::atomic<int> size;
+        bool fullWarningShown;
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    //! Client flags sent with the V3 handshake. Must match the flags in InputServer's NetClient.
+    enum ClientFlags
+    {
+        FlagDataIn = 1 << 0,
+        FlagServiceTypePointer = 1 << 1,
+        FlagServiceTypeMocap = 1 << 2,
+        FlagServiceTypeKeyboard = 1 << 3,
+        FlagServiceTypeController = 1 << 4,
+        FlagServiceTypeUi = 1 << 5,
+        FlagServiceTypeGeneric = 1 << 6,
+        FlagServiceTypeBrain = 1 << 7,
+        FlagServiceTypeWand = 1 << 8,
+        FlagServiceTypeSpeech = 1 << 9,
+        FlagServiceTypeImage = 1 << 10,
+        FlagAlwaysTCP = 1 << 11,
+        FlagAlwaysUDP = 1 << 12,
+        FlagServiceTypeAudio = 1 << 13,
+        //! Receive discrete events on a reliable, ordered channel over UDP instead of TCP.
+        FlagReliableUDP = 1 << 14,
+
+        FlagServiceTypeAll = FlagServiceTypePointer | FlagServiceTypeMocap | FlagServiceTypeKeyboard |
+            FlagServiceTypeController | FlagServiceTypeUi | FlagServiceTypeGeneric | FlagServiceTypeBrain |
+            FlagServiceTypeWand | FlagServiceTypeSpeech | FlagServiceTypeImage | FlagServiceTypeAudio
+    };
+
+    //! Handshake modes accepted by OmicronConnectorClient::connect
+    enum ConnectorMode
+    {
+        //! Receive data (omicron_data_on)
+        ModeDataOn = 0,
+        //! Send data to the server (omicron_data_in)
+        ModeDataIn = 1,
+        //! Dual TCP/UDP (omicronV2_data_on)
+        ModeV2 = 2,
+        //! Client flags (omicronV3_data_on), see setClientFlags
+        ModeV3 = 3,
+        //! Client flags and subscription (omicronV4_data_on), see setSubscription
+        ModeV4 = 4
+    };
+
     //////////////////////////////////////////////////////////////////////////////////////////////////
     //template<typename ListenerType>
     class OmicronConnectorClient
     {
     public:
-        OmicronConnectorClient(IOmicronConnectorClientListener* clistener): listener(clistener)
+        OmicronConnectorClient(IOmicronConnectorClientListener* clistener): listener(clistener),
+            clientFlags(FlagServiceTypeAll), stateTable(NULL), receivedBytes(0)
         {}
+        ~OmicronConnectorClient() { delete stateTable; }
 
         bool connect(const char* server, int port = 27000, int dataPort = 7000, int mode = 0);
         void poll();
         void dispose();
         void setDataport(int);
 		bool sendMsg(char*);
+        //! Sets the flags sent with the ModeV3 handshake. Must be called before connect.
+        void setClientFlags(int flags) { clientFlags = flags; }
+        int getClientFlags() { return clientFlags; }
+        //! Sets the subscription sent with the ModeV4 handshake. The server only sends events
+        //! matching the subscription, i.e. "service=Mocap;source=1,4-7;type=Update,Down,Up".
+        //! See omicron::EventFilter for the full syntax. Must be called before connect.
+        void setSubscription(const char* value) { subscription = value != NULL ? value : ""; }
+
+        //! Keeps the latest event of each source in a table readable from any thread (see 
+        //! EventStateTable). The listener passed to the constructor can be NULL if the application
+        //! only reads the table.
+        void enableStateTable(int capacity = 256) { if(stateTable == NULL) stateTable = new EventStateTable(capacity); }
+        const EventStateTable* getStateTable() const { return stateTable; }
+
+        //! Returns the number of bytes received on the data socket since the client was created,
+        //! including packet headers.
+        unsigned long long getReceivedBytes() const { return receivedBytes; }
+
+        //! Decodes an event packet of the given length. Returns false if the packet is too short.
+        static bool parseEventPacket(const char* eventPacket, int length, EventData* ed);
+
     private:
         bool initHandshake(int);
         void parseDGram(int);
+        void dispatchEvent(const char* eventPacket, int length);
+        void receiveReliable(const char* packet, int length);
+        void deliverReliable(unsigned int base);
+        void flushHeldPackets();
+        void sendReliableAck();
 
     private:
         //typedef ListenerType Listener;
@@ -549,6 +725,28 @@ namespace omicronConnector
         bool readyToReceive;
 
         IOmicronConnectorClientListener* listener;
+        int clientFlags;
+        std::string subscription;
+        EventStateTable* stateTable;
+        unsigned long long receivedBytes;
+
+        // Reliable channel receiver state. Reliable packets that arrive ahead of
+        // a missing one wait in the reorder window. Unreliable packets that
+        // follow a missing reliable one wait in the held queue, so updates are
+        // never delivered before the discrete events sent ahead of them.
+        static const int HeldPacketsSize = 64;
+        struct PendingPacket
+        {
+            unsigned int seq;
+            bool present;
+            std::vector<char> data;
+        };
+        bool reliableChannel;
+        unsigned int nextReliableSeq;
+        PendingPacket reorderWindow[ReliableWindowSize];
+        PendingPacket heldPackets[HeldPacketsSize];
+        int heldHead;
+        int heldCount;
     };
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -605,15 +803,34 @@ namespace omicronConnector
     //template<typename ListenerType>
     inline bool OmicronConnectorClient::initHandshake(int mode) 
     {
-        char sendbuf[50];
-		if (mode == 1)
+        char sendbuf[DEFAULT_BUFLEN];
+		reliableChannel = false;
+		if (mode == ModeDataIn)
 		{
 			sprintf(sendbuf, "omicron_data_in,%d", dataPort);
 		}
+		else if (mode == ModeV2)
+		{
+			sprintf(sendbuf, "omicronV2_data_on,%d", dataPort);
+		}
+		else if (mode == ModeV3)
+		{
+			sprintf(sendbuf, "omicronV3_data_on,%d,%d", dataPort, clientFlags);
+			reliableChannel = (clientFlags & FlagReliableUDP) != 0 && (clientFlags & FlagAlwaysTCP) == 0;
+		}
+		else if (mode == ModeV4)
+		{
+			snprintf(sendbuf, DEFAULT_BUFLEN, "omicronV4_data_on,%d,%d,%s", dataPort, clientFlags, subscription.c_str());
+			reliableChannel = (clientFlags & FlagReliableUDP) != 0 && (clientFlags & FlagAlwaysTCP) == 0;
+		}
 		else
 		{
 			sprintf(sendbuf, "omicron_data_on,%d", dataPort);
 		}
+        nextReliableSeq = 1;
+        heldHead = 0;
+        heldCount = 0;
+        for(int i = 0; i < ReliableWindowSize; i++) reorderWindow[i].present = false;
         printf("NetService: Sending handshake: '%s'\n", sendbuf);
 
 		bool result = sendMsg(sendbuf);
@@ -712,48 +929,347 @@ namespace omicronConnector
             (socklen_t*)&SenderAddrSize);
         if(result > 0)
         {
-            int offset = 0;
-#if !defined (__GNUC__) // gcc with Werror does not like unused variables
-            int msgLen = result - 1;
-#endif
-            char* eventPacket = recvbuf;
-
-            EventData ed;
-
-            OI_READBUF(unsigned int, eventPacket, offset, ed.timestamp); 
-            OI_READBUF(unsigned int, eventPacket, offset, ed.sourceId); 
-            OI_READBUF(unsigned int, eventPacket, offset, ed.deviceTag); 
-            OI_READBUF(unsigned int, eventPacket, offset, ed.serviceType); 
-            OI_READBUF(unsigned int, eventPacket, offset, ed.type); 
-            OI_READBUF(unsigned int, eventPacket, offset, ed.flags); 
-            OI_READBUF(float, eventPacket, offset, ed.posx); 
-            OI_READBUF(float, eventPacket, offset, ed.posy); 
-            OI_READBUF(float, eventPacket, offset, ed.posz); 
-            OI_READBUF(float, eventPacket, offset, ed.orw); 
-            OI_READBUF(float, eventPacket, offset, ed.orx); 
-            OI_READBUF(float, eventPacket, offset, ed.ory); 
-            OI_READBUF(float, eventPacket, offset, ed.orz); 
-        
-            OI_READBUF(unsigned int, eventPacket, offset, ed.extraDataType); 
-            OI_READBUF(unsigned int, eventPacket, offset, ed.extraDataItems); 
-            OI_READBUF(unsigned int, eventPacket, offset, ed.extraDataMask); 
-
-			if (ed.extraDataItems > EventData::ExtraDataSize)
-			{
-				memcpy(ed.extraData, &eventPacket[offset], DEFAULT_LRGBUFLEN);
-			}
-			else
-			{
-				memcpy(ed.extraData, &eventPacket[offset], EventData::ExtraDataSize);
-			}
-
-            listener->onEvent(ed);
+            receivedBytes += result;
+            if(reliableChannel)
+            {
+                receiveReliable(recvbuf, result);
+            }
+            else
+            {
+                dispatchEvent(recvbuf, result);
+            }
         } 
         else 
         {
             PRINT_SOCKET_ERROR("recvfrom failed");
         }
     }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline bool OmicronConnectorClient::parseEventPacket(const char* eventPacket, int length, EventData* ed)
+    {
+        // Event header: 16 4-byte fields.
+        if(length < 64) return false;
+
+        int offset = 0;
+        OI_READBUF(unsigned int, eventPacket, offset, ed->timestamp); 
+        OI_READBUF(unsigned int, eventPacket, offset, ed->sourceId); 
+        OI_READBUF(unsigned int, eventPacket, offset, ed->deviceTag); 
+        OI_READBUF(unsigned int, eventPacket, offset, ed->serviceType); 
+        OI_READBUF(unsigned int, eventPacket, offset, ed->type); 
+        OI_READBUF(unsigned int, eventPacket, offset, ed->flags); 
+        OI_READBUF(float, eventPacket, offset, ed->posx); 
+        OI_READBUF(float, eventPacket, offset, ed->posy); 
+        OI_READBUF(float, eventPacket, offset, ed->posz); 
+        OI_READBUF(float, eventPacket, offset, ed->orw); 
+        OI_READBUF(float, eventPacket, offset, ed->orx); 
+        OI_READBUF(float, eventPacket, offset, ed->ory); 
+        OI_READBUF(float, eventPacket, offset, ed->orz); 
+    
+        OI_READBUF(unsigned int, eventPacket, offset, ed->extraDataType); 
+        OI_READBUF(unsigned int, eventPacket, offset, ed->extraDataItems); 
+        OI_READBUF(unsigned int, eventPacket, offset, ed->extraDataMask); 
+
+        // Only copy the extra data that was actually received.
+        int extraDataLength = length - offset;
+        if(extraDataLength > EventData::ExtraDataSize) extraDataLength = EventData::ExtraDataSize;
+        memcpy(ed->extraData, &eventPacket[offset], extraDataLength);
+        return true;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline void OmicronConnectorClient::dispatchEvent(const char* eventPacket, int length)
+    {
+        EventData ed;
+        if(parseEventPacket(eventPacket, length, &ed))
+        {
+            if(stateTable != NULL) stateTable->update(ed, length - 64);
+            if(listener != NULL) listener->onEvent(ed);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline EventStateTable::EventStateTable(int capacity): size(0), fullWarningShown(false)
+    {
+        unsigned int n = 16;
+        while(n < (unsigned int)capacity) n <<= 1;
+        mask = n - 1;
+        slots = new Slot[n];
+        for(unsigned int i = 0; i < n; i++)
+        {
+            slots[i].sequence.store(0, std::memory_order_relaxed);
+            slots[i].key.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline EventStateTable::~EventStateTable()
+    {
+        delete[] slots;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline const EventStateTable::Slot* EventStateTable::find(unsigned long long key) const
+    {
+        // Open addressing, linear probing. Keys are never removed, so the first empty slot ends the search.
+        unsigned int index = (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+        for(unsigned int probe = 0; probe <= mask; probe++)
+        {
+            const Slot* slot = &slots[(index + probe) & mask];
+            unsigned long long slotKey = slot->key.load(std::memory_order_acquire);
+            if(slotKey == key) return slot;
+            if(slotKey == 0) return NULL;
+        }
+        return NULL;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline void EventStateTable::update(const EventData& ed, int extraDataLength)
+    {
+        unsigned long long key = makeKey(ed.serviceType, ed.sourceId);
+        Slot* slot = const_cast<Slot*>(find(key));
+        bool newSlot = false;
+        if(slot == NULL)
+        {
+            if(size.load(std::memory_order_relaxed) > (int)mask)
+            {
+                if(!fullWarningShown) printf("EventStateTable: table full, new sources will be ignored\n");
+                fullWarningShown = true;
+                return;
+            }
+            unsigned int index = (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+            while(slots[index].key.load(std::memory_order_relaxed) != 0) index = (index + 1) & mask;
+            slot = &slots[index];
+            newSlot = true;
+        }
+
+        if(extraDataLength < 0) extraDataLength = 0;
+        if(extraDataLength > MaxExtraDataSize) extraDataLength = MaxExtraDataSize;
+
+        // Odd sequence number: readers will retry until the update is complete.
+        unsigned int seq = slot->sequence.load(std::memory_order_relaxed);
+        slot->sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        const std::memory_order relaxed = std::memory_order_relaxed;
+        SlotData& d = slot->data;
+        d.timestamp.store(ed.timestamp, relaxed);
+        d.deviceTag.store(ed.deviceTag, relaxed);
+        d.type.store(ed.type, relaxed);
+        d.flags.store(ed.flags, relaxed);
+        d.pos[0].store(ed.posx, relaxed); d.pos[1].store(ed.posy, relaxed); d.pos[2].store(ed.posz, relaxed);
+        d.orient[0].store(ed.orw, relaxed); d.orient[1].store(ed.orx, relaxed); 
+        d.orient[2].store(ed.ory, relaxed); d.orient[3].store(ed.orz, relaxed);
+        d.extraDataType.store(ed.extraDataType, relaxed);
+        d.extraDataItems.store(ed.extraDataItems, relaxed);
+        d.extraDataMask.store(ed.extraDataMask, relaxed);
+        d.extraDataLength.store(extraDataLength, relaxed);
+        memcpy(d.extraData, ed.extraData, extraDataLength);
+
+        slot->sequence.store(seq + 2, std::memory_order_release);
+
+        // Publish new slots only once their data is valid.
+        if(newSlot)
+        {
+            slot->key.store(key, std::memory_order_release);
+            size.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    template<typename ReadFunc> 
+    inline bool EventStateTable::read(const Slot* slot, ReadFunc& func) const
+    {
+        while(true)
+        {
+            unsigned int seq1 = slot->sequence.load(std::memory_order_acquire);
+            if(seq1 & 1) continue; // Update in progress
+            func(slot->data);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            unsigned int seq2 = slot->sequence.load(std::memory_order_relaxed);
+            if(seq1 == seq2) return true;
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline bool EventStateTable::get(unsigned int serviceType, unsigned int sourceId, EventData* ed) const
+    {
+        const Slot* slot = find(makeKey(serviceType, sourceId));
+        if(slot == NULL) return false;
+
+        struct CopyEvent
+        {
+            EventData* ed;
+            void operator()(const SlotData& d)
+            {
+                const std::memory_order relaxed = std::memory_order_relaxed;
+                ed->timestamp = d.timestamp.load(relaxed);
+                ed->deviceTag = d.deviceTag.load(relaxed);
+                ed->type = d.type.load(relaxed);
+                ed->flags = d.flags.load(relaxed);
+                ed->posx = d.pos[0].load(relaxed); ed->posy = d.pos[1].load(relaxed); ed->posz = d.pos[2].load(relaxed);
+                ed->orw = d.orient[0].load(relaxed); ed->orx = d.orient[1].load(relaxed); 
+                ed->ory = d.orient[2].load(relaxed); ed->orz = d.orient[3].load(relaxed);
+                ed->extraDataType = d.extraDataType.load(relaxed);
+                ed->extraDataItems = d.extraDataItems.load(relaxed);
+                ed->extraDataMask = d.extraDataMask.load(relaxed);
+                // The length may be from a newer update than the data if the writer is 
+                // active: clamp it. The copy is discarded and retried in that case anyway.
+                int length = d.extraDataLength.load(relaxed);
+                if(length < 0 || length > MaxExtraDataSize) length = 0;
+                memcpy(ed->extraData, d.extraData, length);
+            }
+        } copy;
+        copy.ed = ed;
+        read(slot, copy);
+        ed->serviceType = serviceType;
+        ed->sourceId = sourceId;
+        return true;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline bool EventStateTable::getPose(unsigned int serviceType, unsigned int sourceId, float* position, float* orientation, unsigned int* flags) const
+    {
+        const Slot* slot = find(makeKey(serviceType, sourceId));
+        if(slot == NULL) return false;
+
+        struct CopyPose
+        {
+            float* position;
+            float* orientation;
+            unsigned int flags;
+            void operator()(const SlotData& d)
+            {
+                const std::memory_order relaxed = std::memory_order_relaxed;
+                if(position != NULL) for(int i = 0; i < 3; i++) position[i] = d.pos[i].load(relaxed);
+                if(orientation != NULL) for(int i = 0; i < 4; i++) orientation[i] = d.orient[i].load(relaxed);
+                flags = d.flags.load(relaxed);
+            }
+        } copy;
+        copy.position = position;
+        copy.orientation = orientation;
+        read(slot, copy);
+        if(flags != NULL) *flags = copy.flags;
+        return true;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline void OmicronConnectorClient::receiveReliable(const char* packet, int length)
+    {
+        ReliableHeader header;
+        if(length < (int)sizeof(header))
+        {
+            dispatchEvent(packet, length);
+            return;
+        }
+        memcpy(&header, packet, sizeof(header));
+        if(header.magic != ReliableMagic)
+        {
+            // Server does not support the reliable channel: plain event packet.
+            dispatchEvent(packet, length);
+            return;
+        }
+
+        const char* payload = packet + sizeof(header);
+        int payloadLength = length - (int)sizeof(header);
+        if(header.kind != ReliableKindAck && payloadLength <= 0) return;
+
+        if(header.kind == ReliableKindReliable)
+        {
+            int distance = (int)(header.seq - nextReliableSeq);
+            if(distance >= 0 && distance < ReliableWindowSize)
+            {
+                PendingPacket& slot = reorderWindow[header.seq % ReliableWindowSize];
+                if(!slot.present)
+                {
+                    slot.seq = header.seq;
+                    slot.present = true;
+                    slot.data.assign(payload, payload + payloadLength);
+                }
+            }
+            // Always ack, even duplicates: the previous ack may have been lost.
+            deliverReliable(header.aux);
+            sendReliableAck();
+        }
+        else if(header.kind == ReliableKindUnreliable)
+        {
+            deliverReliable(header.aux);
+            if(heldCount == 0 && (int)(header.seq - nextReliableSeq) < 0)
+            {
+                dispatchEvent(payload, payloadLength);
+            }
+            else
+            {
+                // A reliable packet sent before this one is still missing. Hold the
+                // packet. If the queue is full, drop the oldest held update.
+                if(heldCount == HeldPacketsSize)
+                {
+                    heldHead = (heldHead + 1) % HeldPacketsSize;
+                    heldCount--;
+                }
+                PendingPacket& held = heldPackets[(heldHead + heldCount) % HeldPacketsSize];
+                held.seq = header.seq;
+                held.data.assign(payload, payload + payloadLength);
+                heldCount++;
+            }
+        }
+        flushHeldPackets();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline void OmicronConnectorClient::deliverReliable(unsigned int base)
+    {
+        // The server gave up on packets older than base: skip them.
+        while((int)(base - nextReliableSeq) > 0)
+        {
+            PendingPacket& slot = reorderWindow[nextReliableSeq % ReliableWindowSize];
+            if(slot.present && slot.seq == nextReliableSeq)
+            {
+                slot.present = false;
+                dispatchEvent(&slot.data[0], (int)slot.data.size());
+            }
+            nextReliableSeq++;
+        }
+        // Deliver all the packets that are now in order.
+        while(true)
+        {
+            PendingPacket& slot = reorderWindow[nextReliableSeq % ReliableWindowSize];
+            if(!slot.present || slot.seq != nextReliableSeq) break;
+            slot.present = false;
+            nextReliableSeq++;
+            dispatchEvent(&slot.data[0], (int)slot.data.size());
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline void OmicronConnectorClient::flushHeldPackets()
+    {
+        while(heldCount > 0)
+        {
+            PendingPacket& held = heldPackets[heldHead];
+            if((int)(held.seq - nextReliableSeq) >= 0) break;
+            heldHead = (heldHead + 1) % HeldPacketsSize;
+            heldCount--;
+            dispatchEvent(&held.data[0], (int)held.data.size());
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    inline void OmicronConnectorClient::sendReliableAck()
+    {
+        ReliableHeader ack;
+        ack.magic = ReliableMagic;
+        ack.kind = ReliableKindAck;
+        ack.seq = nextReliableSeq - 1;
+        ack.aux = 0;
+        for(int i = 0; i < 32; i++)
+        {
+            unsigned int seq = nextReliableSeq + 1 + i;
+            const PendingPacket& slot = reorderWindow[seq % ReliableWindowSize];
+            if(slot.present && slot.seq == seq) ack.aux |= (1u << i);
+        }
+        sendto(RecvSocket, (const char*)&ack, sizeof(ack), 0, (sockaddr*)&SenderAddr, SenderAddrSize);
+    }
 #endif
 #endif
 };
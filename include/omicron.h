@@ -11,10 +11,12 @@
 #include "omicron/Config.h"
 #include "omicron/DataManager.h"
 #include "omicron/Event.h"
+#include "omicron/EventJournal.h"
 #include "omicron/FileDataStream.h"
 #include "omicron/FilesystemDataSource.h"
 #include "omicron/IEventListener.h"
 #include "omicron/Library.h"
+#include "omicron/Metrics.h"
 #include "omicron/NameGenerator.h"
 #include "omicron/PointSetId.h"
 #include "omicron/Thread.h"
@@ -23,6 +25,7 @@
 #include "omicron/StringUtils.h"
 #include "omicron/Tcp.h"
 #include "omicron/Timer.h"
+#include "omicron/Trace.h"
 #include "omicron/xml/tinyxml.h"
 #include "omicron/RayPointMapper.h"
 
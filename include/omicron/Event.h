@@ -48,7 +48,7 @@
 // following this one will include the full header.
 #undef OMICRON_CONNECTOR_LEAN_AND_MEAN
 
-// Used for timestamp
+// Event timestamps now come from otimestamp(). Kept for code that gets ftime from here.
 #include <sys/timeb.h>
 
 #define FLOAT_PTR(x) *((float*)&x)
@@ -309,10 +309,7 @@ namespace omicron
         if(serviceId != 0) myDeviceTag = (serviceId << DTServiceIdOffset);
         myDeviceTag |= (userId << DTUserIdOffset);
 
-        timeb tb;
-        ftime( &tb );
-        int curTime = tb.millitm + (tb.time & 0xfffff) * 1000; // Millisecond timer
-        myTimestamp = curTime;
+        myTimestamp = otimestamp();
 
 		if (usingExtraDataLarge)
 		{
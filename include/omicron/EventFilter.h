@@ -0,0 +1,150 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A compiled event predicate, used by the input server to implement
+ *  fine-grained client subscriptions.
+ ******************************************************************************/
+#ifndef __EVENT_FILTER_H__
+#define __EVENT_FILTER_H__
+
+#include "omicron/osystem.h"
+#include "omicron/Event.h"
+
+namespace omicron {
+
+///////////////////////////////////////////////////////////////////////////////
+//! A compiled event predicate. Filters are built from a subscription string
+//! made of semicolon-separated clauses. Each clause lists comma-separated
+//! values; numeric values can be written as ranges (a-b):
+//!
+//!   service=Mocap,Wand;source=1,4-7;type=Update,Down,Up;user=0;region=-2,0,-2,2,3,2
+//!
+//! - service: service type names (Pointer, Mocap, ...) or numbers
+//! - source: source ids
+//! - type: event type names (Update, Down, ...) or numbers
+//! - user: user ids (as stored in the event device tag)
+//! - region: min x,y,z and max x,y,z of a box. Only applies to Mocap and Wand
+//!   events, the services that report positions in world space.
+//!
+//! An event matches if it satisfies every clause. Missing clauses match all
+//! events. Matching does not allocate: small source and user ids are tested
+//! against bitmasks, larger ones against a sorted list of merged ranges.
+class OMICRON_API EventFilter
+{
+public:
+	EventFilter();
+
+	//! Compiles a subscription string. Returns false and leaves the filter
+	//! matching all events if the string contains errors.
+	bool parse(const String& subscription);
+	//! Resets the filter so it matches all events.
+	void clear();
+
+	bool matches(const Event& evt) const;
+
+	const String& getSubscription() const { return mySubscription; }
+
+private:
+	//! A set of unsigned integers: a bitmask for values below BitmaskSize,
+	//! and sorted, non-overlapping ranges for larger values.
+	struct IdSet
+	{
+		static const unsigned int BitmaskSize = 1024;
+
+		bool all;
+		uint bits[BitmaskSize / 32];
+		Vector< std::pair<unsigned int, unsigned int> > ranges;
+
+		void clear();
+		void add(unsigned int first, unsigned int last);
+		void compile();
+		bool contains(unsigned int value) const;
+	};
+
+	bool parseIdSet(const String& values, IdSet& set, int (*nameToId)(const String&));
+
+private:
+	String mySubscription;
+
+	uint myServiceMask;
+	IdSet myTypes;
+	IdSet mySources;
+	IdSet myUsers;
+
+	bool myHasRegion;
+	Vector3f myRegionMin;
+	Vector3f myRegionMax;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+inline bool EventFilter::IdSet::contains(unsigned int value) const
+{
+	if(all) return true;
+	if(value < BitmaskSize) return (bits[value >> 5] & (1u << (value & 31))) != 0;
+
+	// Binary search on the range list
+	int lo = 0;
+	int hi = (int)ranges.size() - 1;
+	while(lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+		if(value < ranges[mid].first) hi = mid - 1;
+		else if(value > ranges[mid].second) lo = mid + 1;
+		else return true;
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+inline bool EventFilter::matches(const Event& evt) const
+{
+	// Cheapest tests first
+	uint serviceType = evt.getServiceType();
+	if(serviceType >= 32 || (myServiceMask & (1u << serviceType)) == 0) return false;
+	if(!myTypes.contains(evt.getType())) return false;
+	if(!mySources.contains(evt.getSourceId())) return false;
+	if(!myUsers.contains(evt.getUserId())) return false;
+	if(myHasRegion && 
+		(serviceType == (uint)Event::ServiceTypeMocap || serviceType == (uint)Event::ServiceTypeWand))
+	{
+		const Vector3f& pos = evt.getPosition();
+		if(pos.x() < myRegionMin.x() || pos.x() > myRegionMax.x() ||
+			pos.y() < myRegionMin.y() || pos.y() > myRegionMax.y() ||
+			pos.z() < myRegionMin.z() || pos.z() > myRegionMax.z()) return false;
+	}
+	return true;
+}
+
+}; // namespace omicron
+
+#endif
@@ -0,0 +1,367 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A binary, append-only event journal. Events are stored as compact 
+ *  records packed in compressed blocks, followed by a block index and 
+ *  per-source summaries.
+ ******************************************************************************/
+#ifndef __EVENT_JOURNAL_H__
+#define __EVENT_JOURNAL_H__
+
+#include <atomic>
+
+#include "omicron/osystem.h"
+#include "omicron/Event.h"
+#include "omicron/Thread.h"
+#include "omicron/Timer.h"
+
+namespace omicron {
+
+///////////////////////////////////////////////////////////////////////////////
+//! Journal file format. All values are stored little endian.
+//!
+//!   FileHeader
+//!   BlockHeader, block payload    (repeated)
+//!   IndexEntry                    (one per block)
+//!   SummaryHeader                 (version 2)
+//!   SourceSummary                 (one per service type / source id pair)
+//!   Trailer
+//!
+//! A block payload is a sequence of records: a Record header followed by 
+//! extraDataSize bytes of extra data. Payloads are compressed with a small
+//! LZ77 compressor (LZ4 block layout); when compression does not help, the
+//! payload is stored as-is and compressedSize equals rawSize.
+//! The index, summaries and trailer are written when the journal is closed.
+//! The index is sparse (one entry per block) but enough to find the block
+//! holding a given time with a binary search, and to skip blocks that hold 
+//! no events of interest without decompressing them.
+//! If the index is missing (i.e. the writer process crashed) readers rebuild
+//! it by scanning the block headers.
+class OMICRON_API EventJournal
+{
+public:
+	static const uint FileMagic = 0x4e524a4f; // 'OJRN'
+	static const uint BlockMagic = 0x4b424a4f; // 'OJBK'
+	static const uint IndexMagic = 0x58494a4f; // 'OJIX'
+	static const uint SummaryMagic = 0x4d534a4f; // 'OJSM'
+	static const uint Version = 2;
+	//! Service type mask matching all service types.
+	static const uint AllServiceTypes = 0xffffffff;
+	//! Source id matching all sources (see EventJournalReader::blockMayContain)
+	static const uint AnySource = 0xffffffff;
+
+	struct FileHeader
+	{
+		uint magic;
+		uint version;
+		uint blockSize;
+		uint reserved;
+		//! Journal creation time, in seconds since the epoch.
+		uint64 creationTime;
+		uint64 reserved2;
+	};
+
+	struct BlockHeader
+	{
+		uint magic;
+		uint compressedSize;
+		uint rawSize;
+		uint recordCount;
+		//! Times of the first and last record in the block, in microseconds
+		//! since the journal was opened.
+		uint64 firstTime;
+		uint64 lastTime;
+	};
+
+	struct IndexEntry
+	{
+		//! File offset of the block header.
+		uint64 offset;
+		uint compressedSize;
+		uint rawSize;
+		uint recordCount;
+		//! Mask of the service types found in the block (see getServiceTypeMask).
+		//! Reserved in version 1 journals.
+		uint serviceTypes;
+		uint64 firstTime;
+		uint64 lastTime;
+	};
+
+	struct SummaryHeader
+	{
+		uint magic;
+		uint count;
+	};
+
+	//! Summary of the events of a single source.
+	struct SourceSummary
+	{
+		uint sourceId;
+		uint serviceType;
+		uint64 eventCount;
+		uint64 firstTime;
+		uint64 lastTime;
+		//! Indices of the first and last blocks holding events of this source.
+		uint firstBlock;
+		uint lastBlock;
+	};
+
+	struct Trailer
+	{
+		uint64 indexOffset;
+		uint blockCount;
+		uint magic;
+	};
+
+	//! A journaled event. 64 bytes, followed by extraDataSize bytes of extra data.
+	struct Record
+	{
+		//! Microseconds since the journal was opened.
+		uint64 time;
+		//! The original event timestamp.
+		uint timestamp;
+		uint sourceId;
+		uint deviceTag;
+		uint flags;
+		unsigned short type;
+		unsigned char serviceType;
+		unsigned char extraDataType;
+		unsigned short extraDataItems;
+		unsigned short extraDataSize;
+		uint extraDataMask;
+		float position[3];
+		//! w, x, y, z
+		float orientation[4];
+	};
+
+	static uint getServiceTypeMask(uint serviceType) { return 1u << (serviceType & 31); }
+
+	//! Fills a record header with the event data. Does not copy extra data.
+	static void writeRecord(const Event& evt, uint64 time, Record* record);
+	//! Rebuilds an event from a record and its extra data. The event 
+	//! timestamp is reset to the current time, like for any new event.
+	static void readRecord(const Record& record, const void* extraData, Event* evt);
+
+	//! Returns an upper bound for the compressed size of rawSize bytes.
+	static int getMaxCompressedSize(int rawSize);
+	//! Compresses src into dst. Returns the compressed size, or 0 if the 
+	//! compressed data does not fit in dstCapacity bytes.
+	static int compress(const char* src, int srcSize, char* dst, int dstCapacity);
+	//! Decompresses src into dst, that must be exactly rawSize bytes. Returns
+	//! false if the compressed data is corrupt.
+	static bool decompress(const char* src, int srcSize, char* dst, int rawSize);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! Writes events to a journal file. write() copies the event to a lock-free
+//! single producer / single consumer queue and returns immediately; a 
+//! background thread packs queued events into blocks, compresses them and 
+//! writes them to disk. If the disk can't keep up and the queue fills up,
+//! events are dropped (and counted) instead of blocking the caller.
+//! write() must always be called from the same thread.
+//! Journals opened with create() have no queue and writer thread; records
+//! and blocks copied from other journals are written synchronously.
+class OMICRON_API EventJournalWriter: public Thread
+{
+public:
+	static const uint DefaultQueueSize = 8 * 1024 * 1024;
+	static const uint DefaultBlockSize = 64 * 1024;
+	//! Maximum time a partially filled block waits before being written.
+	static const uint FlushIntervalMs = 1000;
+
+	EventJournalWriter();
+	~EventJournalWriter();
+
+	bool open(const String& filename, uint queueSize = DefaultQueueSize, uint blockSize = DefaultBlockSize);
+	//! Opens a journal to be filled with copyRecord() and copyBlock(). 
+	//! creationTime defaults to the current time.
+	bool create(const String& filename, uint blockSize = DefaultBlockSize, uint64 creationTime = 0);
+	//! Writes all queued events, the block index and closes the file.
+	void close();
+	bool isOpen() { return myFile != NULL; }
+	const String& getFilename() { return myFilename; }
+
+	//! Queues an event. Returns false if the event was dropped because the
+	//! queue is full.
+	bool write(const Event& evt);
+
+	//! Appends a record read from another journal, keeping its time. Only
+	//! valid for journals opened with create(). Records must be copied in
+	//! time order.
+	bool copyRecord(const EventJournal::Record& record, const char* extraData);
+	//! Appends a whole block read from another journal, without recompressing
+	//! it. payload is the (possibly compressed) block payload, data the raw 
+	//! records, used to update the block index and source summaries.
+	bool copyBlock(const EventJournal::IndexEntry& block, const char* payload, const char* data);
+
+	uint64 getWrittenEvents() { return myWrittenEvents.load(std::memory_order_relaxed); }
+	uint64 getDroppedEvents() { return myDroppedEvents.load(std::memory_order_relaxed); }
+	uint64 getWrittenBlocks() { return myWrittenBlocks.load(std::memory_order_relaxed); }
+	uint64 getBytesWritten() { return myBytesWritten.load(std::memory_order_relaxed); }
+
+	virtual void threadProc();
+
+private:
+	// Not copyable
+	EventJournalWriter(const EventJournalWriter&);
+	EventJournalWriter& operator=(const EventJournalWriter&);
+
+	bool openFile(const String& filename, uint blockSize, uint64 creationTime);
+	// Consumer side: moves queued records to the current block. Returns the
+	// number of records dequeued.
+	int drainQueue();
+	void addRecord(const EventJournal::Record& record, const char* extraData);
+	void flushBlock();
+	void writeBlock(const EventJournal::BlockHeader& header, const char* payload, uint serviceTypes);
+	void writeIndex();
+
+private:
+	String myFilename;
+	FILE* myFile;
+	std::atomic<bool> myRunning;
+
+	// Queue. Head and tail are monotonic byte counters; each entry is a 
+	// 4-byte length, 4 bytes of padding and the record, aligned to 8 bytes.
+	char* myQueue;
+	uint myQueueSize;
+	std::atomic<uint64> myHead;
+	std::atomic<uint64> myTail;
+
+	// Producer side
+	Timer myTimer;
+
+	// Consumer side
+	char* myBlock;
+	char* myCompressedBlock;
+	uint myBlockSize;
+	uint myBlockCapacity;
+	uint myBlockUsed;
+	EventJournal::BlockHeader myBlockHeader;
+	uint myBlockServiceTypes;
+	Vector<EventJournal::IndexEntry> myIndex;
+	// Source summaries, keyed by service type and source id.
+	Dictionary<uint64, EventJournal::SourceSummary> mySummaries;
+	uint64 myFileOffset;
+
+	std::atomic<uint64> myWrittenEvents;
+	std::atomic<uint64> myDroppedEvents;
+	std::atomic<uint64> myWrittenBlocks;
+	std::atomic<uint64> myBytesWritten;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! Reads events from a journal file, one block at a time. The file is memory
+//! mapped: blocks are decompressed only when read, and uncompressed blocks
+//! are read in place.
+class OMICRON_API EventJournalReader
+{
+public:
+	EventJournalReader();
+	~EventJournalReader();
+
+	bool open(const String& filename);
+	void close();
+	bool isOpen() { return myData != NULL; }
+
+	//! Returns true if the journal was not closed cleanly and its block index
+	//! has been rebuilt by scanning the file.
+	bool isRecovered() { return myRecovered; }
+
+	int getBlockCount() { return (int)myIndex.size(); }
+	const EventJournal::IndexEntry& getBlock(int index) { return myIndex[index]; }
+	const EventJournal::FileHeader& getFileHeader() { return myHeader; }
+	uint64 getFileSize() { return mySize; }
+
+	//! Returns the per-source summaries. For journals that have none (older
+	//! or recovered journals) they are rebuilt by reading the whole journal
+	//! the first time this is called.
+	const Vector<EventJournal::SourceSummary>& getSourceSummaries();
+	//! Returns false if the block surely holds no events of the given service
+	//! types (a getServiceTypeMask combination) and source.
+	bool blockMayContain(int index, uint serviceTypes, uint sourceId = EventJournal::AnySource);
+	//! Returns the index of the first block ending at or after the given time,
+	//! or getBlockCount() if there is none.
+	int findBlock(uint64 time);
+
+	//! Moves the read position to the first record of a block.
+	bool seekBlock(int index);
+	//! Moves the read position to the first record with time >= the given 
+	//! time (in microseconds since the journal was opened).
+	bool seekTime(uint64 time);
+	void rewind() { seekBlock(0); }
+
+	//! Returns the block payload as stored in the file (compressed unless
+	//! its compressedSize equals its rawSize), or NULL if the block is 
+	//! truncated.
+	const char* getBlockPayload(int index);
+	//! Returns the raw records of the current block (the one the last seek or
+	//! next call read from), or NULL if there is none.
+	const char* getBlockData() { return myBlockSize > 0 ? myBlock : NULL; }
+	int getCurrentBlock() { return myCurrentBlock; }
+
+	//! Reads the next record. extraData (optional) is set to the record extra
+	//! data, and stays valid until the next call. Returns false at the end of
+	//! the journal.
+	bool next(EventJournal::Record* record, const char** extraData = NULL);
+	//! Reads the next record into an event.
+	bool next(Event* evt, uint64* time = NULL);
+
+private:
+	// Not copyable
+	EventJournalReader(const EventJournalReader&);
+	EventJournalReader& operator=(const EventJournalReader&);
+
+	bool loadBlock(int index);
+	void rebuildIndex();
+	bool loadSummaries(uint64 offset);
+	void rebuildSummaries();
+
+private:
+	const char* myData;
+	uint64 mySize;
+	EventJournal::FileHeader myHeader;
+	Vector<EventJournal::IndexEntry> myIndex;
+	Vector<EventJournal::SourceSummary> mySummaries;
+	bool myHasSummaries;
+	bool myRecovered;
+
+	Vector<char> myBlockBuffer;
+	const char* myBlock;
+	int myCurrentBlock;
+	uint myBlockPosition;
+	uint myBlockSize;
+};
+
+}; // namespace omicron
+
+#endif
@@ -51,6 +51,8 @@ namespace omicron
 	private:
 		static GestureService* mysInstance;
 		MocapGestureManager* mocapManager;
+		// Event sequence number of the last event processed (see ServiceManager::getEventsSince)
+		uint64 lastEventSequence;
 	};
 
 };
@@ -42,6 +42,11 @@
 #include "omicron/DataManager.h"
 #include "omicron/Event.h"
 #include "omicron/Config.h"
+#include "omicron/Timer.h"
+#include "omicron/EventFilter.h"
+#include "omicron/Metrics.h"
+#include "omicron/SourceStateTable.h"
+#include "omicron/EventJournal.h"
 
 #ifdef WIN32
     #define OMICRON_OS_WIN
@@ -92,7 +97,82 @@
 #define INVALID_SOCKET            (0)
 #endif
 
-enum DataMode { data_omicron, data_omicron_legacy, data_omicron_in, data_tactile, data_omicronV2, data_omicronV3 };
+namespace omicron {
+
+///////////////////////////////////////////////////////////////////////////////
+//! Sender side of the reliable UDP channel (see omicronConnector::ReliableHeader).
+//! Every datagram is prefixed with a channel header. Reliable packets are kept
+//! in a retransmission window until the client acknowledges them. A packet is
+//! retransmitted as soon as selective acks show later packets arrived without
+//! it (fast retransmit), or when its retransmission timeout expires. The
+//! timeout tracks the measured round trip time and is kept short, so on a LAN a
+//! lost button press is usually repaired in a few milliseconds.
+class OMICRON_API ReliableSender
+{
+public:
+	ReliableSender();
+	~ReliableSender();
+
+	//! Sends a packet. Reliable packets are delivered once and in order.
+	//! Unreliable packets may be lost, but are never delivered before the
+	//! reliable packets sent ahead of them.
+	void send(SOCKET s, const sockaddr_in& addr, const char* data, int length, bool reliable);
+	//! Reads acknowledgements from the socket and retransmits lost packets.
+	//! Should be called frequently (i.e. once per server loop).
+	void poll(SOCKET s, const sockaddr_in& addr);
+
+	//! Returns the number of reliable packets waiting for an acknowledgement.
+	int getUnackedCount() { return (int)(myNextSeq - myBaseSeq); }
+	//! Returns the current retransmission timeout in milliseconds.
+	double getRetransmitTimeout() { return myRto; }
+	//! Returns the number of reliable packets given up on because the
+	//! retransmission window was full.
+	int getDroppedCount() { return myDroppedCount; }
+
+private:
+	struct Slot
+	{
+		unsigned int seq;
+		bool acked;
+		int retransmits;
+		int nacks;
+		double sendTime;
+		char* data;
+		int length;
+		int capacity;
+	};
+
+	void readAcks(SOCKET s, const sockaddr_in& addr);
+	void processAck(SOCKET s, const sockaddr_in& addr, unsigned int cumulativeAck, unsigned int sackBits);
+	void transmit(SOCKET s, const sockaddr_in& addr, Slot& slot);
+	void updateRtt(double sample);
+	bool isPending(unsigned int seq)
+	{ return (int)(seq - myBaseSeq) >= 0 && (int)(seq - myNextSeq) < 0; }
+
+	// Not copyable
+	ReliableSender(const ReliableSender&);
+	ReliableSender& operator=(const ReliableSender&);
+
+private:
+	Slot* mySlots;
+	// Sequence number assigned to the next reliable packet
+	unsigned int myNextSeq;
+	// Oldest reliable packet not yet acknowledged
+	unsigned int myBaseSeq;
+	// Buffer used to prefix unreliable packets with the channel header
+	char* myScratch;
+	int myDroppedCount;
+
+	bool myHasRtt;
+	double mySrtt;
+	double myRttVar;
+	double myRto;
+	Timer myTimer;
+};
+
+}; // namespace omicron
+
+enum DataMode { data_omicron, data_omicron_legacy, data_omicron_in, data_tactile, data_omicronV2, data_omicronV3, data_omicronV4 };
 
 ///////////////////////////////////////////////////////////////////////////////
 // Based on Winsock UDP Server Example:
@@ -138,9 +218,51 @@ private:
 		ServiceTypeImage = 1 << 10,
 		AlwaysTCP = 1 << 11,
 		AlwaysUDP = 1 << 12,
-		ServiceTypeAudio = 1 << 13
+		ServiceTypeAudio = 1 << 13,
+		ReliableUDP = 1 << 14
 	};
 
+	// Reliable UDP channel state. Only allocated for clients that set the
+	// ReliableUDP flag.
+	omicron::ReliableSender* reliableSender;
+
+	// V4 subscription filter. NULL if the client did not send a subscription.
+	omicron::EventFilter* filter;
+
+	// Metrics (see omicron::MetricsRegistry)
+	omicron::MetricCounter* bytesMetric;
+	omicron::MetricCounter* packetsMetric;
+	omicron::MetricCounter* sendErrorsMetric;
+	omicron::MetricGauge* queueDepthMetric;
+	omicron::MetricCounter* reliableDropsMetric;
+
+	void createMetrics()
+	{
+		omicron::MetricsRegistry* mr = omicron::MetricsRegistry::getInstance();
+		char name[64];
+		sprintf(name, "%.48s:%i", clientAddress, clientPort);
+		omicron::String label = omicron::MetricsRegistry::label("client", name);
+		bytesMetric = mr->addCounter("omicron_client_sent_bytes_total", "Bytes sent to the client.", label);
+		packetsMetric = mr->addCounter("omicron_client_sent_packets_total", "Packets sent to the client.", label);
+		sendErrorsMetric = mr->addCounter("omicron_client_send_errors_total", "Failed sends to the client.", label);
+		queueDepthMetric = mr->addGauge("omicron_client_queue_depth", "Reliable packets waiting for an acknowledgement from the client.", label);
+		reliableDropsMetric = mr->addCounter("omicron_client_reliable_dropped_total", "Reliable packets dropped because the retransmission window was full.", label);
+	}
+
+	void countSend(int result)
+	{
+		if (packetsMetric == NULL) return;
+		if (result == SOCKET_ERROR)
+		{
+			sendErrorsMetric->add();
+		}
+		else
+		{
+			packetsMetric->add();
+			bytesMetric->add(result);
+		}
+	}
+
 public:
 	static int GetDefaultFlag()
 	{
@@ -168,6 +290,10 @@ public:
 		clientPort = port;
 
 		clientMode = data_omicron;
+		reliableSender = NULL;
+		filter = NULL;
+		tcpSocket = INVALID_SOCKET;
+		createMetrics();
 		updateFlags(flags);
 
 		// Create a UDP socket for sending data
@@ -189,6 +315,9 @@ public:
 		clientPort = port;
 
 		clientMode = data_omicron;
+		reliableSender = NULL;
+		filter = NULL;
+		createMetrics();
 		updateFlags(flags);
 
 		// Create a UDP socket for sending data
@@ -212,6 +341,9 @@ public:
 		clientPort = port;
 
 		clientMode = mode;
+		reliableSender = NULL;
+		filter = NULL;
+		createMetrics();
 		updateFlags(flags);
 
 		// Create a UDP socket for sending data
@@ -271,19 +403,54 @@ public:
 		{
 			sendMsg(eventPacket, length);
 		}
+		else if (reliableSender != NULL)
+		{
+			reliableSender->send(udpSocket, recvAddr, eventPacket, length, false);
+			countSend(length);
+		}
 		else
 		{
 			// Send a datagram to the receiver
-			sendto(udpSocket,
+			int result = sendto(udpSocket,
 				eventPacket,
 				length,
 				0,
 				(const struct sockaddr*)&recvAddr,
 				sizeof(recvAddr)
 			);
+			countSend(result);
 		}
 	}// SendEvent
 
+	// Sends an event that must not be lost (i.e. button Down/Up). Uses the
+	// reliable UDP channel if the client enabled it, the TCP socket otherwise.
+	void sendReliableEvent(char* eventPacket, int length)
+	{
+		if (reliableSender != NULL && !isFlagEnabled(ClientFlags::AlwaysTCP))
+		{
+			reliableSender->send(udpSocket, recvAddr, eventPacket, length, true);
+			countSend(length);
+		}
+		else
+		{
+			sendMsg(eventPacket, length);
+		}
+	}// sendReliableEvent
+
+	// Processes reliable channel acknowledgements and retransmissions.
+	void poll()
+	{
+		if (reliableSender != NULL)
+		{
+			reliableSender->poll(udpSocket, recvAddr);
+			if (queueDepthMetric != NULL)
+			{
+				queueDepthMetric->set(reliableSender->getUnackedCount());
+				reliableDropsMetric->set(reliableSender->getDroppedCount());
+			}
+		}
+	}
+
 	int recvEvent(char* eventPacket, int length)
 	{
 		int result;
@@ -334,6 +501,7 @@ public:
 				0,
 				(const struct sockaddr*)&recvAddr,
 				sizeof(recvAddr));
+			countSend(result);
 
 			if (result == SOCKET_ERROR)
 			{
@@ -371,6 +539,19 @@ public:
 		{
 			clientMode = data_omicron_in;
 		}
+
+		// Flags are set on every handshake. A reconnecting client restarts its 
+		// reliable sequence numbers, so the sender state is restarted too.
+		if (reliableSender != NULL)
+		{
+			delete reliableSender;
+			reliableSender = NULL;
+		}
+		if (isFlagEnabled(ClientFlags::ReliableUDP))
+		{
+			printf("NetClient %s:%i using reliable UDP channel.\n", clientAddress, clientPort);
+			reliableSender = new omicron::ReliableSender();
+		}
 	}
 
 	DataMode getMode()
@@ -393,6 +574,37 @@ public:
 		return (clientFlags & flag) == flag;
 	}
 
+	bool isReliable()
+	{
+		return reliableSender != NULL;
+	}
+
+	// Sets the V4 subscription. An empty subscription removes the filter.
+	void setSubscription(const char* subscription)
+	{
+		if (subscription == NULL || subscription[0] == '\0')
+		{
+			delete filter;
+			filter = NULL;
+			return;
+		}
+		if (filter == NULL) filter = new omicron::EventFilter();
+		if (filter->parse(subscription))
+		{
+			printf("NetClient %s:%i subscribed to '%s'\n", clientAddress, clientPort, subscription);
+		}
+		else
+		{
+			printf("NetClient %s:%i invalid subscription '%s', sending all events\n", clientAddress, clientPort, subscription);
+		}
+	}
+
+	// Returns true if the event should be sent to this client.
+	bool acceptsEvent(const omicron::Event& evt)
+	{
+		return requestedServiceType(evt.getServiceType()) && (filter == NULL || filter->matches(evt));
+	}
+
 	bool requestedServiceType(omicron::Service::ServiceType type)
 	{
 		switch (type)
@@ -438,11 +650,71 @@ public:
 				printf("NetClient: Cleaned up udpSocket\n");
 			}
 		}
+		if (tcpSocket != INVALID_SOCKET)
+		{
+			SOCKET_CLOSE(tcpSocket);
+			tcpSocket = INVALID_SOCKET;
+		}
+		if (reliableSender != NULL)
+		{
+			delete reliableSender;
+			reliableSender = NULL;
+		}
+		delete filter;
+		filter = NULL;
+
+		omicron::MetricsRegistry* mr = omicron::MetricsRegistry::getInstance();
+		mr->remove(bytesMetric);
+		mr->remove(packetsMetric);
+		mr->remove(sendErrorsMetric);
+		mr->remove(queueDepthMetric);
+		mr->remove(reliableDropsMetric);
+		bytesMetric = packetsMetric = sendErrorsMetric = reliableDropsMetric = NULL;
+		queueDepthMetric = NULL;
 	}
 };
 
 namespace omicron {
-	
+
+///////////////////////////////////////////////////////////////////////////////
+//! Encodes a batch of events as omicron packets into a single reusable buffer.
+//! Each packet keeps its exact encoded length, so it can be sent without being
+//! padded to DEFAULT_BUFLEN. The buffer only grows: once the batch has seen its
+//! peak load, encoding and sending events does not allocate memory.
+class OMICRON_API EventPacketBatch
+{
+public:
+	EventPacketBatch(int initialCapacity = DEFAULT_LRGBUFLEN);
+	~EventPacketBatch();
+
+	//! Encodes the event and appends the packet to the batch.
+	void add(const Event* evt);
+	//! Sends all the packets in the batch to the client, in order.
+	void send(NetClient* client);
+	//! Empties the batch. Allocated memory is kept for reuse.
+	void clear();
+
+	int getPacketCount() { return (int)myPackets.size(); }
+	char* getPacket(int index) { return &myBuffer[myPackets[index].offset]; }
+	int getPacketLength(int index) { return myPackets[index].length; }
+
+private:
+	struct PacketRef
+	{
+		int offset;
+		int length;
+	};
+
+	// Not copyable
+	EventPacketBatch(const EventPacketBatch&);
+	EventPacketBatch& operator=(const EventPacketBatch&);
+
+	char* myBuffer;
+	int myCapacity;
+	int mySize;
+	Vector<PacketRef> myPackets;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class OMICRON_API InputServer
 {
@@ -451,10 +723,21 @@ public:
     virtual bool handleLegacyEvent(const Event& evt);
 	virtual bool handleTacTileEvent(const Event& evt);
     void startConnection(Config* cfg);
+    //! Disconnects all clients, stops listening and closes the event journal, 
+    //! writing its index and summaries. Call before exiting, or the journal 
+    //! will only open in recovered mode.
+    void dispose();
     SOCKET startListening();
     // VRPN Server (for CalVR)
     void loop();
 
+	//! Returns the size in bytes of the omicron packet encoding the event.
+	static int getOmicronPacketSize(const Event*);
+	//! Encodes the event into a caller-provided buffer, that must be at least
+	//! getOmicronPacketSize() bytes long. Returns the number of bytes written.
+	static int writeOmicronPacketFromEvent(const Event*, char* buffer);
+	//! Allocates a buffer and encodes the event into it. The caller owns the
+	//! returned buffer (release it with delete[]).
 	static char* createOmicronPacketFromEvent(const Event*);
 	static omicronConnector::EventData createOmicronEventDataFromEventPacket(char*);
 
@@ -462,7 +745,9 @@ public:
 
 protected:
     void sendToClients(char*);
-    void createClient(const char*, int, DataMode mode, SOCKET, int flags = -1);
+    NetClient* createClient(const char*, int, DataMode mode, SOCKET, int flags = -1, const char* subscription = NULL);
+    //! Sends the latest state of every source the client subscribed to.
+    void sendStateSnapshot(NetClient* client);
 private:
 	const char* serverIP;
     const char* serverPort;
@@ -475,6 +760,7 @@ private:
 	const static char* legacyHandshake;
 	const static char* tactileHandshake;
 	const static char* omicronV3Handshake;
+	const static char* omicronV4Handshake;
 
     char eventPacket[DEFAULT_BUFLEN];
     char legacyPacket[DEFAULT_BUFLEN];
@@ -502,6 +788,20 @@ private:
     int lastOutgoingEventTime;
     int eventCount;
 
+	// Latest state of each source, sent to clients when they connect
+	SourceStateTable stateTable;
+	bool stateSnapshotEnabled;
+
+	// Optional journal of all outgoing events (see journalFile config option)
+	EventJournalWriter* journal;
+
+	// Server metrics, and the optional server exposing all metrics (see 
+	// metricsPort and metricsLogInterval config options)
+	MetricCounter* eventsMetric;
+	MetricGauge* clientsMetric;
+	MetricHistogram* eventAgeMetric;
+	MetricsServer* metricsServer;
+
 	bool logClientConnectionsToFile;
 	const char* clientConnectLogFilePath;
 
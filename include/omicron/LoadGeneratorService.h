@@ -0,0 +1,142 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A service generating synthetic mocap, skeleton, touch and image events, 
+ *  used to load test the event pipeline without tracking hardware.
+ ******************************************************************************/
+#ifndef __LOAD_GENERATOR_SERVICE_H__
+#define __LOAD_GENERATOR_SERVICE_H__
+
+#include "omicron/osystem.h"
+#include "omicron/ServiceManager.h"
+#include "omicron/Timer.h"
+#include "omicron/TouchGestureManager.h"
+
+namespace omicron {
+	///////////////////////////////////////////////////////////////////////////////////////////////
+	//! LoadGeneratorService extends the HeartbeatService idea to realistic workloads: it 
+	//! simulates several event streams, each with its own source count and rate:
+	//!   rigidBodies / rigidBodyRate: mocap rigid bodies moving on circular paths.
+	//!   skeletons / skeletonRate: mocap skeletons, with one Vector3 extra data item per joint.
+	//!   touches / touchRate: touch points with Down / Move / Up lifecycles. Touches last 
+	//!     touchDuration seconds on average, and a new touch id is used for each Down.
+	//!   images / imageRate / imageSize: Image events with imageSize bytes of extra data.
+	//!   probeRate: Generic Update events from source probeSourceId, carrying a sequence number
+	//!     and the steady clock time in microseconds they were generated at as an int array
+	//!     (seq, time low bits, time high bits). Used by oinputbench to measure latency and loss
+	//!     across processes. Disabled by default.
+	//! Source ids of each stream start at rigidBodySourceId, skeletonSourceId, touchSourceId
+	//! and imageSourceId. Rigid bodies and skeletons are both mocap sources: skeletonSourceId
+	//! defaults to 100 or to the first id after the rigid bodies, and skeletons are moved
+	//! after the rigid bodies if the two ranges overlap. Touches can also be routed through a
+	//! TouchGestureManager (useGestureManager = true) to load the gesture recognizer.
+	//! The generator is deterministic for a given seed.
+	class OMICRON_API LoadGeneratorService: public Service
+	{
+	public:
+		//! Allocator function (will be used to register the service inside SystemManager)
+		static LoadGeneratorService* New() { return new LoadGeneratorService(); }
+
+	public:
+		LoadGeneratorService();
+		~LoadGeneratorService();
+
+		virtual void setup(Setting& settings);
+		virtual void initialize();
+		virtual void poll();
+		virtual void dispose();
+
+		uint64 getGeneratedEvents() { return myGeneratedEvents; }
+
+	private:
+		//! A set of sources generating frames at a fixed rate.
+		struct Stream
+		{
+			int count;
+			float rate;
+			uint sourceId;
+			double nextFrameTime;
+		};
+
+		struct TouchPoint
+		{
+			bool active;
+			uint id;
+			float x, y;
+			float vx, vy;
+			float width;
+			double endTime;
+		};
+
+		//! Returns the number of frames of the stream due since the last call.
+		int framesDue(Stream& stream, double now, int maxFrames);
+		void generateRigidBodies(double now);
+		void generateSkeletons(double now);
+		void generateTouches(double now);
+		void generateImages(double now);
+		void generateProbes(double now);
+
+		//! Uniform random number in [0, 1)
+		float random();
+
+	private:
+		Timer myTimer;
+		uint myRandomState;
+
+		Stream myRigidBodies;
+		Stream mySkeletons;
+		Stream myTouches;
+		Stream myImages;
+		Stream myProbes;
+		uint myProbeSequence;
+
+		float myTouchDuration;
+		float myTouchSpeed;
+		uint myNextTouchId;
+		Vector<TouchPoint> myTouchPoints;
+		Vector<Touch> myFrameTouches;
+		Vector<Event::Type> myFrameTypes;
+		bool myUseGestureManager;
+		TouchGestureManager* myTouchGestureManager;
+
+		int myImageSize;
+		char* myImageData;
+		int myImageFrame;
+
+		uint64 myGeneratedEvents;
+		uint64 myLastReportedEvents;
+		double myLastReportTime;
+	};
+}; // namespace omicron
+
+#endif
@@ -0,0 +1,234 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A registry of counters, gauges and latency histograms describing the 
+ *  live state of the input pipeline, and a server exposing them.
+ ******************************************************************************/
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <atomic>
+
+#include "connector/omicronConnectorClient.h"
+#include "omicron/osystem.h"
+#include "omicron/Thread.h"
+#include "omicron/Timer.h"
+
+namespace omicron {
+
+///////////////////////////////////////////////////////////////////////////////
+//! Base class of all metrics. Metrics are created by the MetricsRegistry and 
+//! stay valid until they are removed from it. Updating a metric is a relaxed
+//! atomic operation, so it can be done from any thread at a negligible cost.
+//! Metrics with the same name and labels are shared: the registry counts the
+//! components that added each metric, and deletes it when all removed it.
+class OMICRON_API Metric
+{
+friend class MetricsRegistry;
+public:
+	enum Type { Counter, Gauge, Histogram };
+
+	virtual ~Metric() {}
+
+	Type getType() { return myType; }
+	const String& getName() { return myName; }
+	const String& getHelp() { return myHelp; }
+	//! The metric labels in Prometheus syntax (i.e. service="MocapService").
+	const String& getLabels() { return myLabels; }
+
+protected:
+	Metric(Type type, const String& name, const String& help, const String& labels):
+		myType(type), myName(name), myHelp(help), myLabels(labels), myRefCount(1) {}
+
+private:
+	Type myType;
+	String myName;
+	String myHelp;
+	String myLabels;
+	int myRefCount;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! A monotonically increasing value.
+class OMICRON_API MetricCounter: public Metric
+{
+friend class MetricsRegistry;
+public:
+	void add(uint64 value = 1) { myValue.fetch_add(value, std::memory_order_relaxed); }
+	//! Mirrors a counter maintained elsewhere (i.e. ServiceManager dropped events).
+	void set(uint64 value) { myValue.store(value, std::memory_order_relaxed); }
+	uint64 get() { return myValue.load(std::memory_order_relaxed); }
+
+private:
+	MetricCounter(const String& name, const String& help, const String& labels):
+		Metric(Counter, name, help, labels), myValue(0) {}
+
+	std::atomic<uint64> myValue;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! A value that can go up and down.
+class OMICRON_API MetricGauge: public Metric
+{
+friend class MetricsRegistry;
+public:
+	void set(int64 value) { myValue.store(value, std::memory_order_relaxed); }
+	void add(int64 value) { myValue.fetch_add(value, std::memory_order_relaxed); }
+	int64 get() { return myValue.load(std::memory_order_relaxed); }
+
+private:
+	MetricGauge(const String& name, const String& help, const String& labels):
+		Metric(Gauge, name, help, labels), myValue(0) {}
+
+	std::atomic<int64> myValue;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! A distribution of durations, in seconds. Observations are counted in 
+//! fixed exponential buckets going from 1 microsecond to 10 seconds.
+class OMICRON_API MetricHistogram: public Metric
+{
+friend class MetricsRegistry;
+public:
+	static const int BucketCount = 22;
+	//! Returns the upper bound of a bucket, in seconds.
+	static double getBucketBound(int bucket);
+
+	void observe(double seconds);
+
+	uint64 getCount() { return myCount.load(std::memory_order_relaxed); }
+	//! Returns the sum of all the observed values, in seconds.
+	double getSum() { return mySumNanos.load(std::memory_order_relaxed) / 1e9; }
+	//! Returns the number of observations in a bucket. The bucket at index 
+	//! BucketCount counts the observations above the last bound.
+	uint64 getBucket(int bucket) { return myBuckets[bucket].load(std::memory_order_relaxed); }
+	//! Returns the upper bound of the bucket containing the given quantile.
+	double getQuantileBound(double q);
+
+private:
+	MetricHistogram(const String& name, const String& help, const String& labels);
+
+	std::atomic<uint64> myBuckets[BucketCount + 1];
+	std::atomic<uint64> myCount;
+	std::atomic<uint64> mySumNanos;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! The global metric registry. Components add their metrics when they are
+//! created and remove them when they are destroyed.
+//! Metrics that are cheap to keep (counters, gauges) are always updated. 
+//! Metrics that need timing (i.e. service poll times) are only collected
+//! when the registry is enabled, that is when something reads them (see
+//! MetricsServer).
+class OMICRON_API MetricsRegistry
+{
+public:
+	static MetricsRegistry* getInstance();
+	static void cleanup();
+
+	//! Formats a label in Prometheus syntax, escaping the value.
+	static String label(const String& name, const String& value);
+
+	bool isEnabled() { return myEnabled.load(std::memory_order_relaxed); }
+	void setEnabled(bool value) { myEnabled.store(value, std::memory_order_relaxed); }
+
+	//! Adds a metric, or returns the registered metric with the same name and
+	//! labels. Each add must be paired with a remove.
+	MetricCounter* addCounter(const String& name, const String& help, const String& labels = "");
+	MetricGauge* addGauge(const String& name, const String& help, const String& labels = "");
+	MetricHistogram* addHistogram(const String& name, const String& help, const String& labels = "");
+	//! Removes a metric, deleting it once every component that added it removed
+	//! it. Does nothing if the metric is NULL.
+	void remove(Metric* metric);
+
+	//! Returns all metrics in the Prometheus text exposition format.
+	String getText();
+	//! Returns a one line summary of all metrics: the per second rate of
+	//! counters, the value of gauges (summed over all their label sets) and
+	//! the mean and 99th percentile of histograms. Rates are computed since 
+	//! the previous call.
+	String getSummary();
+
+private:
+	MetricsRegistry();
+	Metric* add(Metric* metric);
+
+private:
+	static MetricsRegistry* mysInstance;
+
+	std::atomic<bool> myEnabled;
+	Lock myLock;
+	Vector<Metric*> myMetrics;
+
+	// Counter totals at the previous summary, by metric name.
+	Dictionary<String, uint64> myLastTotals;
+	Timer mySummaryTimer;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! Serves the registry metrics over HTTP in the Prometheus text format, and 
+//! optionally logs a summary line at a fixed interval. The /trace path serves
+//! the spans recorded by the Tracer, as Chrome trace JSON. The server thread 
+//! sleeps in select() between requests, so it costs nothing when nobody is
+//! scraping. The registry is enabled while the summary line is logged, and 
+//! for ScrapeTimeout seconds after each metrics request: timing metrics start
+//! collecting at the first scrape, and stop when scrapes stop.
+class OMICRON_API MetricsServer: public Thread
+{
+public:
+	MetricsServer();
+	~MetricsServer();
+
+	//! Starts serving metrics. A port of 0 disables the HTTP endpoint, a log
+	//! interval of 0 disables the summary line.
+	bool startServing(const String& address, int port, float logInterval);
+	void stopServing();
+	bool isServing() { return myRunning; }
+
+	static const int ScrapeTimeout = 60;
+
+	virtual void threadProc();
+
+private:
+	void serveClient(SOCKET clientSocket);
+
+private:
+	volatile bool myRunning;
+	SOCKET myListenSocket;
+	float myLogInterval;
+	Timer myScrapeTimer;
+};
+
+}; // namespace omicron
+
+#endif
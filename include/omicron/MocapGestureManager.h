@@ -36,56 +36,68 @@ using namespace std;
 namespace omicron {
 	class GestureService;
 
-	struct Joint{
-		int ID; // Trackable / Joint ID
+	// A gesture waiting to be published (see MocapGestureManager::flushGestures)
+	struct MocapGesture{
+		Event::Type type;
 		int userID;
-		Vector3f position;
-		Quaternion orientation;
-
-		Vector3f lastPosition;
-		Quaternion lastOrientation;
-	};
-
-	struct MocapUser{
-		int userID;
-
-		// Convient access to user's head
-		Vector3f position;
-		Quaternion orientation;
-
-		map<int,Joint> joints;
-
-		Joint head;
-		Joint leftHand;
-		Joint rightHand;
-		Joint spine;
+		int jointID[2];
+		Vector3f position[2];
+		Vector3f rotation;
+		Vector3f initialRotation;
+		bool isRotate;
 	};
 
 	class MocapGestureManager : public Service
 	{
 
 	public:
+		// Maximum number of tracked users. When all slots are taken, a new user
+		// replaces the one that was updated least recently.
+		static const int MaxUsers = 16;
+
 		MocapGestureManager( Service* );
 
 		void setup(Setting& settings);
 		void poll();
+		// Updates the skeleton of the event user in place and runs gesture
+		// detection on it.
 		void processEvent(const Event& e);
 		void generateGesture( Event::Type, int userID, int jointID, Vector3f position );
 		void generateRotateGesture( Event::Type, int userID, int jointID0, Vector3f position0, int jointID1, Vector3f position1, Vector3f rotation, Vector3f intialRotation );
+		// Publishes the gestures generated since the last call. processEvent
+		// is called with the event buffer locked, so gestures are queued 
+		// and written out here once it is unlocked.
+		void flushGestures();
+	private:
+		int findUser(int userID);
+		int addUser(int userID);
+		// Detects gestures from the latest skeleton update of a user
+		void updateGestures(int user);
+
 	private:
 		Service* gestureService;
-		map<int,MocapUser> userList;
 
-		float lastClickTime;
+		// Skeletons of all users, indexed by [user slot][joint][axis] so a
+		// skeleton update writes one contiguous block.
+		float joints[MaxUsers][Event::OMICRON_SKEL_COUNT][3];
+		int numUsers;
+		int userIDs[MaxUsers];
+		// Value of updateCount at the last update of each user
+		uint64 userLastUpdate[MaxUsers];
+		uint64 updateCount;
+
+		// Per user gesture state
+		float lastRightHandZ[MaxUsers];
+		float lastClickTime[MaxUsers];
+		bool handRotateGestureTriggered[MaxUsers];
+		Vector3f initialRotation[MaxUsers];
 
-		// Gesture flags
-		static bool handRotateGestureTriggered;
+		Vector<MocapGesture> pendingGestures;
 
 		// Gesture data
 		// Two-handed rotation
 		float handRotateGestureSeparationTrigger; // Maximum distance (in meters) between hands to trigger gesture
 		bool useRadians; // Send data in radians or degrees
-		Vector3f initialRotation;
 	};
 }
 
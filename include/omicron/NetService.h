@@ -64,9 +64,11 @@ namespace omicron
 		bool dataStreamOut;
 		bool showDebug;
 		int reconnectDelay;
-		clock_t init, timer;
+		double init, timer;
 
 		NetClient* streamClient;
+		// Reused across polls to encode outgoing events without per-event allocations
+		EventPacketBatch myPacketBatch;
 	};
 
 };
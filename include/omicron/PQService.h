@@ -97,9 +97,16 @@ private:
 	static int eventCount;
 
 	std::map<int,Touch> touchlist; // Internal touch list to generate custom gestures
+
+	// Scratch buffers for the touch frame being processed
+	Vector<Touch> frameTouches;
+	Vector<Event::Type> frameEventTypes;
 	
 	TouchGestureManager* touchGestureManager;
 
+	// Normalized touch frames are recorded here, in the touchtrace CSV format
+	FILE* touchTraceFile;
+
 	//////////////////////call back functions///////////////////////
 	// OnReceivePointFrame: function to handle when recieve touch point frame
 	//	the unmoving touch point won't be sent from server. The new touch point with its pointevent is TP_DOWN
@@ -120,6 +127,8 @@ private:
 
 	// OnTouchPoint: function to handle TouchPoint
 	void OnTouchPoint(const TouchPoint & tp);
+	// OnTouchFrame: function to handle a whole frame of TouchPoints at once
+	void OnTouchFrame(const TouchPoint * points, int count);
 	
 	// OSC Sockets for TUIO connection (Linux)
 	UdpSocket tuioMsgSocket;
@@ -0,0 +1,117 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A service that replays events recorded in an event journal.
+ ******************************************************************************/
+#ifndef __PLAYBACK_SERVICE_H__
+#define __PLAYBACK_SERVICE_H__
+
+#include "omicron/osystem.h"
+#include "omicron/ServiceManager.h"
+#include "omicron/EventJournal.h"
+#include "omicron/Timer.h"
+
+namespace omicron {
+
+///////////////////////////////////////////////////////////////////////////////
+//! Reads an event journal (see EventJournalWriter) and re-injects the recorded
+//! events, so sessions recorded on real hardware can be replayed anywhere.
+//! Configuration options:
+//!   file: the journal file to play back.
+//!   speed: playback speed multiplier (default 1, original timing). A speed 
+//!     of 0 plays events back as fast as possible.
+//!   loop: restart from the beginning at the end of the journal (default false).
+//!   startTime: seconds from the start of the journal to begin playback at.
+//!   maxEventsPerPoll: maximum number of events queued in a single poll 
+//!     (default 1024), so fast playback does not overrun the event buffer.
+//!   sourceIdOffset: added to the source id of every event (default 0).
+//!   sourceIdMap: a list of [from, to] source id pairs. Mapped sources ignore
+//!     sourceIdOffset.
+//!   virtualClock: drive the omicron clock (see osetclock) from the journal
+//!     (default false). The clock follows the recorded event times, so 
+//!     timestamps and gesture timing match the recording at any speed, and 
+//!     fast playback is deterministic.
+class OMICRON_API PlaybackService: public Service
+{
+public:
+	//! Allocator function
+	static PlaybackService* New() { return new PlaybackService(); }
+
+public:
+	PlaybackService();
+
+	virtual void setup(Setting& settings);
+	virtual void initialize();
+	virtual void poll();
+	virtual void dispose();
+
+	//! Restarts playback from the configured start time.
+	void restart();
+
+	uint64 getPlayedEvents() { return myPlayedEvents; }
+
+private:
+	uint mapSourceId(uint sourceId);
+	//! Reads the next record into the pending record. Handles looping.
+	bool readNext();
+	void setClock(uint64 journalTime);
+
+private:
+	String myFilename;
+	float mySpeed;
+	bool myLoop;
+	uint64 myStartTime;
+	int myMaxEventsPerPoll;
+	int mySourceIdOffset;
+	Dictionary<uint, uint> mySourceIdMap;
+
+	EventJournalReader myReader;
+	Timer myTimer;
+	//! Journal time played back when the timer was started.
+	uint64 myTimeOrigin;
+
+	bool myUseVirtualClock;
+	VirtualClock myClock;
+	//! Virtual clock time corresponding to journal time 0.
+	uint64 myClockOrigin;
+
+	bool myHasPending;
+	EventJournal::Record myPending;
+	const char* myPendingExtraData;
+	bool myFinished;
+	uint64 myPlayedEvents;
+};
+
+}; // namespace omicron
+
+#endif
@@ -0,0 +1,107 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	Pointer position smoothing (One Euro filter) and latency compensation,
+ *  applied by the service manager to the events of a service.
+ ******************************************************************************/
+#ifndef __POINTER_FILTER_H__
+#define __POINTER_FILTER_H__
+
+#include "omicron/osystem.h"
+#include "omicron/Event.h"
+
+namespace omicron {
+
+///////////////////////////////////////////////////////////////////////////////
+//! Smooths pointer positions with a One Euro filter (Casiez et al. 2012) and
+//! predicts them forward with a constant velocity model, to compensate for
+//! the time until the position is displayed. Each source id of the service
+//! has its own filter state. A service gets a filter from a pointerFilter
+//! section in its configuration:
+//!
+//!   pointerFilter: { minCutoff = 1.0; beta = 0.01; derivativeCutoff = 1.0; prediction = 0.016; };
+//!
+//! - minCutoff: cutoff frequency (Hz) at low speeds. Lower values remove more
+//!   jitter but add lag.
+//! - beta: how fast the cutoff frequency grows with speed, in the units of
+//!   the service positions. Higher values reduce lag on fast motion.
+//! - derivativeCutoff: cutoff frequency (Hz) of the speed estimate.
+//! - prediction: time (seconds) the positions are predicted forward.
+//!
+//! Only the x and y positions of Down, Move, Update and Up pointer events are
+//! filtered. A Down restarts the filter of its source, an Up ends it. A
+//! sample older than the previous one of its source restarts the filter too.
+//! Events with user flags set (such as touch gesture events) are left alone,
+//! since they can share a source id with raw pointer events. A sample with
+//! the same timestamp as the previous one of its source does not update the
+//! filter and gets the current position estimate.
+class OMICRON_API PointerFilter
+{
+public:
+	PointerFilter();
+
+	void setup(const Setting& settings);
+
+	//! Filters the position of a pointer event in place.
+	void filter(Event& evt);
+	//! Forgets the state of every source.
+	void reset();
+
+private:
+	struct SourceState
+	{
+		bool active;
+		int timestamp; // Milliseconds
+		float x;
+		float y;
+		float dx;
+		float dy;
+	};
+
+	SourceState* getSourceState(uint sourceId);
+
+private:
+	float myMinCutoff;
+	float myBeta;
+	float myDerivativeCutoff;
+	float myPrediction;
+
+	// Small source ids are indexed directly, larger ones go through a map
+	static const uint MaxIndexedSources = 1024;
+	Vector<SourceState> myIndexedSources;
+	Dictionary<uint, SourceState> myMappedSources;
+};
+
+}; // namespace omicron
+
+#endif
@@ -52,6 +52,9 @@ namespace omicron
 	// Forward declarations
 	class Event;
 	class ServiceManager;
+	class MetricCounter;
+	class MetricHistogram;
+	class PointerFilter;
 
 	///////////////////////////////////////////////////////////////////////////
 	//! The base class for Services: a Service has code that is executed periodically
@@ -82,12 +85,13 @@ namespace omicron
 
 	public:
 		// Class constructor
-		Service(): myManager(NULL), myPriority(PollNormal), myDebug(false), myInitialized(false) {}
+		Service(): myManager(NULL), myPriority(PollNormal), myDebug(false), myInitialized(false),
+			myEventsMetric(NULL), myPollTimeMetric(NULL), myTraceName("Service"), myPointerFilter(NULL) {}
 
 		int getServiceId() { return myId; }
 
 	   // Class destructor
-		virtual ~Service() {}
+		virtual ~Service();
 
 		ServiceManager* getManager();
 		String getName();
@@ -97,6 +101,10 @@ namespace omicron
 		//! Returns true if debug mode is enabled for this service.
 		bool isDebugEnabled();
 
+		//! Returns the filter applied to the pointer events of this service, 
+		//! or NULL if the service has none (see PointerFilter).
+		PointerFilter* getPointerFilter();
+
 		ServicePollPriority getPollPriority();
 		void setPollPriority(ServicePollPriority value);
 
@@ -127,6 +135,15 @@ namespace omicron
 		int myId;
 		bool myDebug;
 		bool myInitialized;
+
+		// Metrics (see MetricsRegistry). The poll time is measured by the
+		// service manager.
+		MetricCounter* myEventsMetric;
+		MetricHistogram* myPollTimeMetric;
+		// Name of the poll spans in traces (see Tracer)
+		const char* myTraceName;
+		// Applied to the service events by the service manager
+		PointerFilter* myPointerFilter;
 	};
 
 	///////////////////////////////////////////////////////////////////////////
@@ -148,6 +165,10 @@ namespace omicron
 	///////////////////////////////////////////////////////////////////////////
 	inline bool Service::isDebugEnabled()
 	{ return myDebug; }
+
+	///////////////////////////////////////////////////////////////////////////
+	inline PointerFilter* Service::getPointerFilter()
+	{ return myPointerFilter; }
 }; // namespace omicron
 
 #endif
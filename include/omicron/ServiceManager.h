@@ -40,6 +40,7 @@
 #include "Config.h"
 #include "Event.h"
 #include "Thread.h"
+#include "Timer.h"
 
 // Preprocessor macro, bleah.. Forced to use this instead of static constant as a quick workaround 
 // to a gcc 4.2 build error. Think of a better solution in the future.
@@ -47,9 +48,36 @@
 
 namespace omicron
 {
+	class MetricGauge;
+	class PointerFilter;
+
 	typedef Service* (*ServiceAllocator)();
 	typedef Dictionary<String, ServiceAllocator> ServiceAllocatorDictionary;
 
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+	//! A read-only view of a range of events in the service manager event buffer.
+	//! Events are neither copied nor consumed. The view is only valid while the 
+	//! event buffer is locked.
+	class EventView
+	{
+	public:
+		EventView(const Event* buffer, int first, int count):
+			myBuffer(buffer), myFirst(first), myCount(count) {}
+
+		int size() const { return myCount; }
+		const Event& operator[](int i) const
+		{
+			int index = myFirst + i;
+			if(index >= OMICRON_MAX_EVENTS) index -= OMICRON_MAX_EVENTS;
+			return myBuffer[index];
+		}
+
+	private:
+		const Event* myBuffer;
+		int myFirst;
+		int myCount;
+	};
+
 	///////////////////////////////////////////////////////////////////////////////////////////////////
 	class OMICRON_API ServiceManager
 	{
@@ -101,6 +129,12 @@ namespace omicron
 		Event* writeHead();
 		Event* readHead();
 		Event* readTail();
+		//! Number of events written to the event buffer so far.
+		uint64 getEventSequence() { return myEventSequence; }
+		//! Returns the events written after the given event sequence number that 
+		//! are still in the event buffer. Call with the event buffer locked. A 
+		//! sequence number past the current one (after readHead) returns no events.
+		EventView getEventsSince(uint64 sequence);
 		//@}
 
 	public:
@@ -113,6 +147,9 @@ namespace omicron
 		int incrementBufferIndex(int index);
 		int decrementBufferIndex(int index);
 
+		void updatePointerFilters();
+		void filterPointerEvents();
+
 	private:
 		bool myInitialized;
 
@@ -131,6 +168,22 @@ namespace omicron
 
 		int myAvailableEvents;
 		int myDroppedEvents;
+
+		// Pointer filters by service id (see PointerFilter). Events are
+		// filtered in one pass per poll, and before getEvents, getEvent or 
+		// getEventsSince return them.
+		Vector<PointerFilter*> myPointerFilters;
+		int myUnfilteredEvents;
+
+		// Incremented by writeHead, used to find events written since a 
+		// given point (see getEventsSince)
+		uint64 myEventSequence;
+
+		// Metrics (see MetricsRegistry)
+		MetricGauge* myRingCapacityMetric;
+		MetricGauge* myRingOccupancyMetric;
+		MetricCounter* myDroppedEventsMetric;
+		Timer myPollTimer;
 	};
 
 	///////////////////////////////////////////////////////////////////////////////////////////////
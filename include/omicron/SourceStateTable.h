@@ -0,0 +1,97 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A table of the latest state of each event source, used by the input 
+ *  server to send new clients a snapshot of the current state.
+ ******************************************************************************/
+#ifndef __SOURCE_STATE_TABLE_H__
+#define __SOURCE_STATE_TABLE_H__
+
+#include "omicron/osystem.h"
+#include "omicron/Event.h"
+
+namespace omicron {
+
+///////////////////////////////////////////////////////////////////////////////
+//! Keeps the latest state (pose, flags and extra data) of each event source,
+//! keyed by service type and source id. States are stored as encoded omicron
+//! packets with their type rewritten to Update, so a snapshot can be sent to a
+//! client as-is, without triggering Down or Click handlers on the client side.
+//! Sources are removed on Untrace, and pointers are removed on Up.
+//! Packet buffers are reused: updating a known source does not allocate.
+class OMICRON_API SourceStateTable
+{
+public:
+	SourceStateTable();
+	~SourceStateTable();
+
+	//! Returns true if the event carries state worth keeping in the table.
+	static bool isStateEvent(const Event& evt);
+
+	//! Updates the source state with an event and its encoded packet.
+	void update(const Event& evt, const char* packet, int length);
+	void clear();
+
+	int getSize() { return (int)myEntries.size(); }
+	const char* getPacket(int index) { return myEntries[index]->packet; }
+	int getPacketLength(int index) { return myEntries[index]->length; }
+	//! Returns the size of the buffer holding the packet. It is at least 
+	//! DEFAULT_BUFLEN, so packets can be sent padded to the legacy size.
+	int getPacketCapacity(int index) { return myEntries[index]->capacity; }
+	//! Decodes the header of a stored packet into evt, leaving extra data out.
+	//! Useful to test a state against a client subscription.
+	void getEventHeader(int index, Event* evt);
+
+private:
+	struct Entry
+	{
+		uint64 key;
+		char* packet;
+		int length;
+		int capacity;
+	};
+
+	// Not copyable
+	SourceStateTable(const SourceStateTable&);
+	SourceStateTable& operator=(const SourceStateTable&);
+
+	void remove(uint64 key);
+
+	Vector<Entry*> myEntries;
+	// Maps a source key to its index in myEntries
+	Dictionary<uint64, int> myIndex;
+};
+
+}; // namespace omicron
+
+#endif
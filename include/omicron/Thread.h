@@ -64,7 +64,7 @@ namespace omicron
     {
     public:
         Thread();
-        ~Thread();
+        virtual ~Thread();
         void start();
         void stop();
         virtual void threadProc() {}
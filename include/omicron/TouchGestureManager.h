@@ -29,6 +29,7 @@
 
 #include "osystem.h"
 #include "ServiceManager.h"
+#include "TouchGestureRecognizer.h"
 #include <set>
 
 using namespace std;
@@ -64,11 +65,13 @@ namespace omicron {
 	class TouchGestureManager;
 
 	// Holds the initial and current center of mass of touches
-	// as well as all touches in the group
+	// as well as all touches in the group. Groups live in a pool owned by
+	// the gesture manager and are reset when their slot is reused.
 	class TouchGroup
 	{
 		private:
 			TouchGestureManager* gestureManager;
+			int slot; // Index in the gesture manager group pool
 			Touch centerTouch;
 			Touch mainTouch; // Touch that created/manages the group
 
@@ -87,38 +90,42 @@ namespace omicron {
 			float diameter;
 
 			int lastUpdated; // Milliseconds
-			
-			float initialZoomDistance;
-			float zoomDistance;
-			float zoomLastDistance;
 
 			float farthestTouchDistance;
 
-			map<int,Touch> touchList;
-			map<int,Touch> longRangeTouchList;
+			// Sorted by touch ID. Cleared, not freed, when the group is reused.
+			Vector<Touch> touchList;
+			Vector<Touch> longRangeTouchList;
 
-			// Maybe replace these with a function call to generate on demand?
-			map<int,Touch> idleTouchList;
-			map<int,Touch> movingTouchList;
+			int idleTouchCount;
 
 			enum GroupHandedness { NONE, LEFT, RIGHT };
 			int groupHandedness;
 
 			Lock* touchListLock;
 
-			// Gesture flags
-			bool fiveFingerGestureTriggered;
-			bool threeFingerGestureTriggered;
-			bool bigTouchGestureTriggered;
-			bool zoomGestureTriggered;
-			bool singleClickTriggered;
-			bool doubleClickTriggered;
+			TouchGroupRecognizers recognizers;
+
+			// Gesture of the Move event for the touch being added (0 for none),
+			// see setMoveGesture
+			int moveGesture;
+			// Move gesture waiting for the end of the current touch frame (0 if none)
+			int pendingMoveGesture;
+
+			void generateMoveEvent(int gesture);
+
+			static int findTouch(const Vector<Touch>& list, int touchID);
+			static void setTouch(Vector<Touch>& list, const Touch& touch);
 		public:
-			TouchGroup(TouchGestureManager*, int);
+			TouchGroup(TouchGestureManager*, int slot);
 			~TouchGroup();
 
+			void reset(int ID);
 			int getID();
+			int getSlot();
+			TouchGestureManager* getGestureManager();
 
+			bool containsPoint( float x, float y );
 			bool isInsideGroup( Event::Type eventType, float x, float y, int id, float w, float h );
 
 			void addTouch( Event::Type eventType, float x, float y, int ID, float w, float h );
@@ -126,46 +133,76 @@ namespace omicron {
 
 			void process();
 			void generateGestures();
+			int takePendingMoveGesture();
+			// Called by recognizers from touchMoved, to change the gesture of
+			// the Move event sent for the touch (0 to send none).
+			void setMoveGesture(int gesture);
 
 			int getTouchCount();
+			int getIdleTouchCount();
+			float getFarthestTouchDistance();
+			TouchGroupRecognizers& getRecognizers();
 			Touch getCenterTouch();
 			Touch getMainTouch();
 			int getGestureFlag();
 			bool isRemovable();
 			void setRemove();
 
-			map<int, Touch> getTouchList();
+			const Touch& getTouch(int index);
 			void lockTouchList();
 			void unlockTouchList();
 
 			float getZoomDelta();
 			float getDiameter();
 			float getLongRangeDiameter();
-			
-			bool isSingleClickTriggered();
-			bool isDoubleClickTriggered();
 
 			void removeTouch(int id);
 			Event::Type getEventType();
 	};
 
+	// Groups touches and generates gesture events for a touch service.
+	// Unless gestureThread is false, registerPQService() starts a gesture
+	// thread: addTouch()/addTouches() then only queue the touches, poll() does
+	// nothing, and the thread sends gesture events through the registered
+	// service. Touches must be added from a single thread.
+	//
+	// With gestureRegionColumns/gestureRegionRows set, the normalized screen
+	// is split into regions, each handled by its own gesture manager (and
+	// thread). This manager then only routes touches: a touch stays with the
+	// region it went down in, and a new touch that lands near a live touch of
+	// another region joins that region, so a group straddling a region
+	// boundary is still recognized by a single manager.
 	class TouchGestureManager: public Thread
 	{
 
 	public:
 		TouchGestureManager();
+		~TouchGestureManager();
 		void setup(Setting&);
 		void registerPQService(Service*);
 		void setMaxTouchIDs(int);
 
 		void poll();
+
+		void startThread();
+		void stopThread();
+		bool isThreadRunning();
+		uint64 getDroppedTouches();
+		virtual void threadProc();
 		
 		bool addTouch(Event::Type eventType, Touch touch);
+		void addTouches(const Event::Type* eventTypes, const Touch* touches, int count);
+		bool isBatchingTouches();
+		void queueMoveEvent(TouchGroup* touchGroup);
 		TouchGroup* getTouchGroup(int ID);
+		void updateTouchGroupCell(TouchGroup* touchGroup);
+		int getTouchGroupCount();
+		int getRegionCount();
 		void setNextID( int ID );
 
 		void generatePQServiceEvent(Event::Type eventType, TouchGroup* touchGroup, int advancedGesture);
 		void generateZoomEvent(Event::Type eventType, TouchGroup* touchGroup, float deltaDistance);
+		void generateStrokeEvent(TouchGroup* touchGroup, int strokeTemplate, float score);
 		//void generatePQServiceEvent(Event::Type eventType, Touch touch, int advancedGesture);
 		//void generatePQServiceEvent(Event::Type eventType, Touch mainTouch, map<int, Touch> touchList, int advancedGesture);
 	private:
@@ -173,15 +210,102 @@ namespace omicron {
 		Lock* touchListLock;
 		map<int, Touch> rawTouchList;
 		Lock* touchGroupListLock;
-		map<int,TouchGroup*> touchGroupList;
-		set<int> groupedIDs;
+
+		// Touch groups are pooled: slots are recycled through a free list, so
+		// steady-state processing does not allocate. Active slots are kept in
+		// creation order.
+		Vector<TouchGroup*> touchGroupPool;
+		Vector<int> freeTouchGroupSlots;
+		Vector<int> activeTouchGroups;
+
+		// Group slot for each touch ID: NoTouchGroup if the ID never created
+		// a group, ExpiredTouchGroup if its group has been removed.
+		enum { NoTouchGroup = -1, ExpiredTouchGroup = -2 };
+		Vector<int> touchGroupSlots;
+
+		// Groups with a Move gesture pending until the end of the frame
+		// passed to addTouches
+		bool batchingTouches;
+		vector<TouchGroup*> pendingMoveGroups;
+
+		// Uniform grid over touch group centers, with cells the size of a
+		// group diameter. A touch can only fall inside groups whose center is
+		// in its own cell or one of the 8 neighbouring cells. Cells hold group
+		// slots, and group centers are kept per slot for the inside test.
+		// Empty cells are kept to reuse their storage.
+		// Guarded by touchGroupListLock.
+		float gridCellSize;
+		Dictionary<uint64, Vector<int> > touchGroupGrid;
+		Vector<float> groupCenterX;
+		Vector<float> groupCenterY;
+		Vector<float> groupRadius;
+		Vector<uint64> groupCells;
+		Vector<bool> groupInGrid;
+
+		uint64 getGridCell(int cellX, int cellY);
+		int getGridCoordinate(float pos);
+		void removeTouchGroupCell(TouchGroup* touchGroup);
+
+		TouchGroup* createTouchGroup(int ID);
+		void releaseTouchGroup(TouchGroup* touchGroup);
 
 		bool addTouchGroup( Event::Type eventType, float xPos, float yPos, int id, float xWidth, float yWidth );
+		void writePQServiceEvent(Event::Type eventType, TouchGroup* touchGroup, int advancedGesture);
+		void processTouches(const Event::Type* eventTypes, const Touch* touches, int count);
+		void update();
 
 		// Threaded
-		bool runGestureThread;
+		bool runGestureThread; // Start the gesture thread on registerPQService
+		std::atomic<bool> gestureThreadRunning;
+
+		// Touch updates queued for the gesture thread. Single producer / 
+		// single consumer ring; head and tail are monotonic counters.
+		struct TouchUpdate
+		{
+			Touch touch;
+			Event::Type eventType;
+		};
+		int touchQueueSize;
+		Vector<TouchUpdate> touchQueue;
+		std::atomic<uint64> touchQueueHead;
+		std::atomic<uint64> touchQueueTail;
+		std::atomic<uint64> droppedTouches;
+
+		// Gesture thread copies of the dequeued touches
+		Vector<Touch> queuedTouches;
+		Vector<Event::Type> queuedEventTypes;
+
+		bool queueTouch(Event::Type eventType, const Touch& touch);
+		int drainTouchQueue();
 		
 		int timeLastEventSent; // Milliseconds
+
+		// Screen regions. Region managers are owned by the routing manager;
+		// regionIndex is -1 for a top level manager.
+		int regionIndex;
+		int regionColumns;
+		int regionRows;
+		Vector<TouchGestureManager*> regionManagers;
+
+		// Routing state, per touch ID
+		struct TouchRoute
+		{
+			int region; // -1 if the touch ID has not been seen
+			float xPos;
+			float yPos;
+			int lastUpdated; // Milliseconds
+			bool tracked; // In routedTouches
+		};
+		Vector<TouchRoute> touchRoutes;
+		Vector<int> routedTouches; // Touch IDs that can still attract new touches
+
+		// Per region copies of the touch frame being routed
+		Vector< Vector<Touch> > regionTouches;
+		Vector< Vector<Event::Type> > regionEventTypes;
+
+		void createRegions(Setting& settings);
+		int getRegion(float x, float y);
+		int routeTouch(Event::Type eventType, const Touch& touch);
 	};
 }
 
@@ -0,0 +1,218 @@
+/**************************************************************************************************
+ * THE OMICRON PROJECT
+ *-------------------------------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *-------------------------------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory, University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted 
+ * provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this list of conditions 
+ * and the following disclaimer. Redistributions in binary form must reproduce the above copyright 
+ * notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR 
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND 
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR SERVICES; LOSS OF 
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *************************************************************************************************/
+#ifndef __TOUCH_GESTURE_RECOGNIZER_H__
+#define __TOUCH_GESTURE_RECOGNIZER_H__
+
+#include "osystem.h"
+#include "Config.h"
+
+namespace omicron {
+
+	class TouchGroup;
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Touch gesture recognizers. A recognizer keeps its own state for one touch
+	// group and provides:
+	//   void reset();                         // The group slot is (re)used
+	//   void update(TouchGroup& tg);          // Once per frame, after the group is processed
+	//   void touchMoved(TouchGroup& tg);      // A touch of the group moved
+	//   void touchesReleased(TouchGroup& tg); // The last touch of the group was released
+	//   void groupRemoved(TouchGroup& tg);    // Before the group Up event is sent
+	// Recognizers derive from TouchGestureRecognizer, that does nothing for the
+	// calls they do not need. Recognizers are combined at compile time with 
+	// TouchGestureRecognizers, so calls are not virtual and recognizers left 
+	// out of the list cost nothing.
+	class TouchGestureRecognizer
+	{
+	public:
+		void reset() {}
+		void update(TouchGroup&) {}
+		void touchMoved(TouchGroup&) {}
+		void touchesReleased(TouchGroup&) {}
+		void groupRemoved(TouchGroup&) {}
+	};
+
+	template<typename... Recognizers> class TouchGestureRecognizers;
+
+	template<> class TouchGestureRecognizers<>
+	{
+	public:
+		void reset() {}
+		void update(TouchGroup&) {}
+		void touchMoved(TouchGroup&) {}
+		void touchesReleased(TouchGroup&) {}
+		void groupRemoved(TouchGroup&) {}
+	protected:
+		void getRecognizer() {}
+	};
+
+	template<typename R, typename... Rest>
+	class TouchGestureRecognizers<R, Rest...>: private TouchGestureRecognizers<Rest...>
+	{
+	public:
+		void reset()
+		{
+			recognizer.reset();
+			TouchGestureRecognizers<Rest...>::reset();
+		}
+
+		void update(TouchGroup& tg)
+		{
+			recognizer.update(tg);
+			TouchGestureRecognizers<Rest...>::update(tg);
+		}
+
+		void touchMoved(TouchGroup& tg)
+		{
+			recognizer.touchMoved(tg);
+			TouchGestureRecognizers<Rest...>::touchMoved(tg);
+		}
+
+		void touchesReleased(TouchGroup& tg)
+		{
+			recognizer.touchesReleased(tg);
+			TouchGestureRecognizers<Rest...>::touchesReleased(tg);
+		}
+
+		void groupRemoved(TouchGroup& tg)
+		{
+			recognizer.groupRemoved(tg);
+			TouchGestureRecognizers<Rest...>::groupRemoved(tg);
+		}
+
+		// Returns the state of recognizer T. Does not compile if T is not in the list.
+		template<typename T> T& get() { return *getRecognizer((T*)NULL); }
+
+	protected:
+		using TouchGestureRecognizers<Rest...>::getRecognizer;
+		R* getRecognizer(R*) { return &recognizer; }
+
+	private:
+		R recognizer;
+	};
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Single touch wider than bigTouchMinSize. Sends a big touch Down when the
+	// touch first gets wide enough, and makes its later Moves big touch Moves.
+	class BigTouchRecognizer: public TouchGestureRecognizer
+	{
+	public:
+		void reset();
+		void touchMoved(TouchGroup& tg);
+
+		bool isTriggered() { return triggered; }
+
+	private:
+		bool triggered;
+	};
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Single and double click: the group touches were released close to where
+	// the group started. A second release before the group times out makes it
+	// a double click. The click is sent when the group is removed.
+	class ClickRecognizer: public TouchGestureRecognizer
+	{
+	public:
+		void reset();
+		void touchesReleased(TouchGroup& tg);
+		void groupRemoved(TouchGroup& tg);
+
+		bool isSingleClick() { return singleClick; }
+		bool isDoubleClick() { return doubleClick; }
+
+	private:
+		bool singleClick;
+		bool doubleClick;
+	};
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Two touch zoom.
+	class ZoomRecognizer: public TouchGestureRecognizer
+	{
+	public:
+		void reset();
+		void update(TouchGroup& tg);
+
+		bool isTriggered() { return triggered; }
+		float getDelta() { return distance - lastDistance; }
+
+	private:
+		bool triggered;
+		float initialDistance;
+		float distance;
+		float lastDistance;
+	};
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Single touch stroke recognizer, using the $1 unistroke algorithm
+	// (Wobbrock et al. 2007). The path of a group that only ever had one
+	// touch is recorded, and matched against the stroke templates when the
+	// touch is released. Templates are resampled and normalized once, when
+	// first used. Templates that are far off at the indicative angle are
+	// rejected before the rotation search.
+	class StrokeRecognizer: public TouchGestureRecognizer
+	{
+	public:
+		enum { MaxPathPoints = 256, ResampledPoints = 64 };
+
+		// Minimum score (0-1) for a stroke to be recognized
+		static float minScore;
+		// Minimum stroke path length (ratio of screen size)
+		static float minLength;
+
+		static void setup(Setting& settings);
+		static int getTemplateCount();
+		static const char* getTemplateName(int index);
+
+		// Matches a stroke path against the templates. Returns the template
+		// index, or -1 if no template scores at least minScore.
+		static int recognize(const float* x, const float* y, int count, float* score);
+
+		void reset();
+		void update(TouchGroup& tg);
+
+	private:
+		void addPoint(float x, float y);
+
+		bool touching;
+		bool multiTouch; // The current stroke had more than one touch
+		int pathCount;
+		float pathX[MaxPathPoints];
+		float pathY[MaxPathPoints];
+	};
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Recognizers run on every touch group. The stroke recognizer is enabled
+	// with the OMICRON_USE_STROKE_GESTURES build option.
+#ifdef OMICRON_USE_STROKE_GESTURES
+	typedef TouchGestureRecognizers<BigTouchRecognizer, ClickRecognizer, ZoomRecognizer, StrokeRecognizer> TouchGroupRecognizers;
+#else
+	typedef TouchGestureRecognizers<BigTouchRecognizer, ClickRecognizer, ZoomRecognizer> TouchGroupRecognizers;
+#endif
+}
+
+#endif
@@ -0,0 +1,117 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A low overhead tracer recording timed spans in per-thread ring buffers,
+ *  that can be dumped in the Chrome trace event format.
+ ******************************************************************************/
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <atomic>
+
+#include "omicron/osystem.h"
+
+namespace omicron {
+
+///////////////////////////////////////////////////////////////////////////////
+//! Records timed spans (i.e. a service poll, a network send) into per-thread 
+//! ring buffers. Each thread only writes to its own buffer, so recording a 
+//! span takes no lock. When tracing is disabled (the default) a span costs a
+//! relaxed atomic load. Buffers keep the most recent spans and can be dumped
+//! at any time as Chrome trace JSON, that can be loaded in chrome://tracing
+//! or in the Perfetto UI. Spans overwritten while a dump copies them are left
+//! out of the dump.
+//! Span names and categories are not copied: they must be string literals or
+//! strings returned by intern().
+class OMICRON_API Tracer
+{
+public:
+	static const int DefaultBufferSize = 16384;
+
+	static bool isEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+	static void setEnabled(bool value) { sEnabled.store(value, std::memory_order_relaxed); }
+	//! Sets the number of spans kept for each thread. Only affects threads
+	//! recording their first span after the call.
+	static void setBufferSize(int spans);
+
+	//! Returns the current trace time, in microseconds.
+	static uint64 now();
+	//! Records a span. Times are in microseconds, as returned by now().
+	static void record(const char* name, const char* category, uint64 begin, uint64 end);
+	//! Names the calling thread in the trace. Cheap when tracing is disabled:
+	//! the span buffer of a thread is only allocated by its first span.
+	static void setThreadName(const String& name);
+	//! Returns a copy of the string that stays valid for the lifetime of the
+	//! program, so it can be used as a span name.
+	static const char* intern(const String& str);
+
+	//! Returns all recorded spans as Chrome trace JSON.
+	static String getJson();
+	//! Writes the recorded spans to a Chrome trace JSON file.
+	static bool dump(const String& filename);
+
+	//! Requests a dump to the given file whenever the process receives SIGUSR1
+	//! (not available on Windows). The dump is done by the next call to poll,
+	//! outside of the signal handler.
+	static void dumpOnSignal(const String& filename);
+	//! Performs requested dumps. Should be called periodically (i.e. once per
+	//! server loop).
+	static void poll();
+
+private:
+	static std::atomic<bool> sEnabled;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! Records a span covering the lifetime of the object, if tracing is enabled
+//! when the object is created.
+class TraceScope
+{
+public:
+	TraceScope(const char* name, const char* category):
+		myName(name), myCategory(category), myBegin(Tracer::isEnabled() ? Tracer::now() : 0) {}
+
+	~TraceScope()
+	{
+		if(myBegin != 0) Tracer::record(myName, myCategory, myBegin, Tracer::now());
+	}
+
+private:
+	const char* myName;
+	const char* myCategory;
+	uint64 myBegin;
+};
+
+}; // namespace omicron
+
+#endif
@@ -43,6 +43,7 @@
 // Standard C includes
 #include <stdio.h>
 #include <stdlib.h>
+#include <atomic>
 
 #include "otypes.h"
 
@@ -57,6 +58,32 @@ namespace omicron
 		virtual void addLine(const String& line) = 0;
 	};
 
+	///////////////////////////////////////////////////////////////////////////////////////////////
+	//! A time source. Event timestamps, gesture timers and service update rates all read the
+	//! current clock (see osetclock), so replacing it with a VirtualClock lets tests and journal
+	//! playback run in deterministic time.
+	class IClock
+	{
+	public:
+		virtual ~IClock() {}
+		//! Returns the current time in microseconds.
+		virtual uint64 getTime() = 0;
+	};
+
+	///////////////////////////////////////////////////////////////////////////////////////////////
+	//! A clock that only moves when told to. Can be read from any thread.
+	class VirtualClock: public IClock
+	{
+	public:
+		VirtualClock(uint64 time = 0): myTime(time) {}
+		virtual uint64 getTime() { return myTime.load(std::memory_order_acquire); }
+		void setTime(uint64 time) { myTime.store(time, std::memory_order_release); }
+		void advance(uint64 micros) { myTime.fetch_add(micros, std::memory_order_acq_rel); }
+
+	private:
+		std::atomic<uint64> myTime;
+	};
+
 
 	///////////////////////////////////////////////////////////////////////////////////////////////
 	// Function definitions.
@@ -77,6 +104,20 @@ namespace omicron
 	OMICRON_API void oabort(const char* file, int line, const char* reason);
 
 	OMICRON_API void osleep(uint msecs);
+
+	//! Sets the clock read by otime and otimestamp. NULL restores the system clock, that reads
+	//! the wall clock time in microseconds since the epoch. The clock is not owned.
+	OMICRON_API void osetclock(IClock* clock);
+	OMICRON_API IClock* ogetclock();
+	//! Returns the current clock time in microseconds.
+	OMICRON_API uint64 oclocktime();
+	//! Returns the time in seconds since the first call. Setting a clock does not restart it: 
+	//! otime continues from its current value, and advances with the new clock from there. 
+	//! Small enough to be stored in a float.
+	OMICRON_API double otime();
+	//! Returns the current clock time as an event timestamp: milliseconds, wrapping around every
+	//! 2^20 seconds (about 12 days).
+	OMICRON_API uint otimestamp();
 };
 
 #define odbg(str) omsg(str);
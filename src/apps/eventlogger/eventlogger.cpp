@@ -26,6 +26,8 @@
  *************************************************************************************************/
 #include <omicron.h>
 
+#include <csignal>
+
 using namespace omicron;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -63,7 +65,20 @@ void logEvent(const Event& e)
 	}
 }
 
+// Set by SIGINT / SIGTERM to leave the main loop and close the journal.
+static volatile sig_atomic_t sQuit = 0;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+static void onQuitSignal(int)
+{
+	sQuit = 1;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
+// Usage: eventlogger [config file] [journal file]
+// When a journal file is specified (on the command line or with the config/journalFile option),
+// events are written to it in binary form. Events are printed to the console unless 
+// config/logEvents is set to false (by default, they are printed only when not journaling).
 int main(int argc, char** argv)
 {
 	// Add a default filesystem data sources (used to retrieve configuration files and other resources)
@@ -74,33 +89,50 @@ int main(int argc, char** argv)
 	// Load a configuration file for this application and setup the system manager.
 	// Read config file name from command line or use default one.
 	const char* cfgName = "eventlogger.cfg";
-	if(argc == 2) cfgName = argv[1];
+	if(argc >= 2) cfgName = argv[1];
 	Config* cfg = new Config(cfgName);
 
 	// Start running services and listening to events.
 	ServiceManager* sm = new ServiceManager();
 	sm->setupAndStart(cfg);
 
+	String journalFile = "";
+	if(cfg->exists("config/journalFile")) journalFile = (const char*)cfg->lookup("config/journalFile");
+	if(argc >= 3) journalFile = argv[2];
+
+	EventJournalWriter journal;
+	if(journalFile != "") journal.open(journalFile);
+	bool log = cfg->getBoolValue("config/logEvents", !journal.isOpen());
+
+	signal(SIGINT, onQuitSignal);
+	signal(SIGTERM, onQuitSignal);
+
 	omsg("eventlogger start logging events...");
-	while(true)
+	static Event evts[OMICRON_MAX_EVENTS];
+	while(!sQuit)
 	{
 		// Poll services for new events.
 		sm->poll(); 
-		/*
+
 		// Get available events
-		Event evts[OMICRON_MAX_EVENTS];
 		int av;
 		if(0 != (av = sm->getEvents(evts, ServiceManager::MaxEvents)))
 		{
 			for( int evtNum = 0; evtNum < av; evtNum++)
 			{
-				logEvent(evts[evtNum]);
+				if(journal.isOpen()) journal.write(evts[evtNum]);
+				if(log) logEvent(evts[evtNum]);
 			}
 		}// if
-		*/
+		else
+		{
+			osleep(1);
+		}
 	}// while
-	
+
+	// Closing the journal writes its block index, summaries and trailer.
+	journal.close();
+	sm->stop();
+	delete sm;
 	delete cfg;
 }
-
-
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Usage: journaltest.sh <oinputserver> <ojournal> <work dir>
+# Journals a few seconds of synthetic events with oinputserver, stops it with 
+# SIGINT and checks the journal reopens with its index (not recovered).
+OINPUTSERVER=$1
+OJOURNAL=$2
+DIR=$3
+# Config files are looked up relative to the working directory.
+cd $DIR || exit 1
+CFG=journaltest.cfg
+JOURNAL=journaltest.ojr
+
+rm -f $JOURNAL
+cat > $CFG <<CFGEOF
+config:
+{
+	serverPort = "28731";
+	journalFile = "$JOURNAL";
+	services:
+	{
+		LoadGeneratorService: { rigidBodies = 4; rigidBodyRate = 120.0; };
+	};
+};
+CFGEOF
+
+$OINPUTSERVER $CFG > journaltest.log 2>&1 &
+PID=$!
+sleep 2
+kill -INT $PID
+wait $PID || { echo "oinputserver exited with an error"; exit 1; }
+
+INFO=$($OJOURNAL info $JOURNAL) || { echo "could not open $JOURNAL"; exit 1; }
+echo "$INFO"
+if echo "$INFO" | grep -q "(recovered)"; then
+	echo "journal was not closed: opened in recovered mode"
+	exit 1
+fi
+exit 0
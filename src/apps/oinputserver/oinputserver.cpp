@@ -28,8 +28,19 @@
 #include <omicron.h>
 #include "omicron/InputServer.h"
 
+#include <csignal>
+
 using namespace omicron;
 
+// Set by SIGINT / SIGTERM to leave the main loop and shut down cleanly.
+static volatile sig_atomic_t sQuit = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+static void onQuitSignal(int)
+{
+	sQuit = 1;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 int main(int argc, char** argv)
 {
@@ -56,9 +67,12 @@ int main(int argc, char** argv)
 
     app.startConnection(cfg);
 
+    signal(SIGINT, onQuitSignal);
+    signal(SIGTERM, onQuitSignal);
+
     omsg("oinputserver: Starting to listen for clients...");
     int i = 0;
-    while(true)
+    while(!sQuit)
     {
         sm->poll();
         app.loop();
@@ -90,6 +104,8 @@ int main(int argc, char** argv)
         }
     }
 
+    omsg("oinputserver: shutting down");
+    app.dispose();
     sm->stop();
     delete sm;
     delete cfg;
@@ -0,0 +1,639 @@
+/**************************************************************************************************
+* THE OMICRON PROJECT
+ *-------------------------------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *-------------------------------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory, University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted 
+ * provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this list of conditions 
+ * and the following disclaimer. Redistributions in binary form must reproduce the above copyright 
+ * notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR 
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND 
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR SERVICES; LOSS OF 
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *************************************************************************************************/
+// ojournal: inspects, slices and exports event journals written by eventlogger and oinputserver.
+// Journals are memory mapped, and the block index and source summaries are used to find time
+// windows and sources: only the blocks that can hold the requested events are decompressed.
+#include <omicron.h>
+#include <omicron/libconfig/ArgumentHelper.h>
+
+#include <time.h>
+#include <limits>
+
+using namespace omicron;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+static const char* sServiceTypeNames[] = {
+	"pointer", "mocap", "keyboard", "controller", "ui", "generic", 
+	"brain", "wand", "speech", "image", "audio"
+};
+static const int sNumServiceTypes = sizeof(sServiceTypeNames) / sizeof(sServiceTypeNames[0]);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct Selection
+{
+	uint64 from;
+	uint64 to;
+	uint serviceTypes;
+	uint sourceId;
+
+	bool isFiltered() 
+	{ return serviceTypes != EventJournal::AllServiceTypes || sourceId != EventJournal::AnySource; }
+
+	bool matches(const EventJournal::Record& r)
+	{
+		return r.time >= from && r.time <= to &&
+			(EventJournal::getServiceTypeMask(r.serviceType) & serviceTypes) != 0 &&
+			(sourceId == EventJournal::AnySource || r.sourceId == sourceId);
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+String getServiceTypeName(uint serviceType)
+{
+	if(serviceType < (uint)sNumServiceTypes) return sServiceTypeNames[serviceType];
+	return ostr("%1%", %serviceType);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Accepts service type names or numbers.
+bool parseServiceType(const String& name, uint* serviceType)
+{
+	String lname = name;
+	StringUtils::toLowerCase(lname);
+	for(int i = 0; i < sNumServiceTypes; i++)
+	{
+		if(lname == sServiceTypeNames[i])
+		{
+			*serviceType = i;
+			return true;
+		}
+	}
+	char* end;
+	long value = strtol(name.c_str(), &end, 10);
+	if(name.empty() || *end != '\0' || value < 0 || value > 31) return false;
+	*serviceType = (uint)value;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Reads the next record of a raw block. Returns false at the end of the block.
+bool nextRecord(const char* data, uint size, uint* position, EventJournal::Record* record, const char** extraData)
+{
+	if(*position + sizeof(EventJournal::Record) > size) return false;
+	memcpy(record, data + *position, sizeof(EventJournal::Record));
+	*position += sizeof(EventJournal::Record);
+	if(*position + record->extraDataSize > size) return false;
+	*extraData = data + *position;
+	*position += record->extraDataSize;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns the blocks that may hold selected events. The time window is found with a binary search
+// on the block index; blocks holding none of the selected sources are left out using the index 
+// service type masks and source summaries.
+Vector<int> selectBlocks(EventJournalReader& reader, Selection& sel)
+{
+	Vector<int> blocks;
+	for(int i = reader.findBlock(sel.from); i < reader.getBlockCount(); i++)
+	{
+		if(reader.getBlock(i).firstTime > sel.to) break;
+		if(reader.blockMayContain(i, sel.serviceTypes, sel.sourceId)) blocks.push_back(i);
+	}
+	return blocks;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Calls f(record, extraData) for each selected record of the given blocks, in time order.
+template<typename F> void forEachSelected(EventJournalReader& reader, Selection& sel, const Vector<int>& blocks, F f)
+{
+	EventJournal::Record r;
+	const char* extraData;
+	for(int i = 0; i < (int)blocks.size(); i++)
+	{
+		if(!reader.seekBlock(blocks[i])) continue;
+		const char* data = reader.getBlockData();
+		uint size = reader.getBlock(blocks[i]).rawSize;
+		uint position = 0;
+		while(nextRecord(data, size, &position, &r, &extraData))
+		{
+			if(sel.matches(r)) f(r, extraData);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+int info(EventJournalReader& reader, Selection& sel)
+{
+	const EventJournal::FileHeader& header = reader.getFileHeader();
+	uint64 events = 0;
+	uint64 rawSize = 0;
+	uint64 compressedSize = 0;
+	for(int i = 0; i < reader.getBlockCount(); i++)
+	{
+		const EventJournal::IndexEntry& block = reader.getBlock(i);
+		events += block.recordCount;
+		rawSize += block.rawSize;
+		compressedSize += block.compressedSize;
+	}
+	uint64 duration = reader.getBlockCount() > 0 ? reader.getBlock(reader.getBlockCount() - 1).lastTime : 0;
+
+	time_t created = (time_t)header.creationTime;
+	char createdString[64];
+	strftime(createdString, sizeof(createdString), "%Y-%m-%d %H:%M:%S", localtime(&created));
+
+	printf("version      %u%s\n", header.version, reader.isRecovered() ? " (recovered)" : "");
+	printf("created      %s\n", createdString);
+	printf("file size    %llu bytes\n", reader.getFileSize());
+	printf("blocks       %d (%u bytes)\n", reader.getBlockCount(), header.blockSize);
+	printf("events       %llu\n", events);
+	printf("duration     %.3f s\n", duration / 1000000.0);
+	if(compressedSize > 0) printf("compression  %.2fx\n", (double)rawSize / compressedSize);
+
+	printf("\n%-12s %10s %12s %12s %12s %12s\n", "service", "source", "events", "first (s)", "last (s)", "rate (ev/s)");
+	const Vector<EventJournal::SourceSummary>& summaries = reader.getSourceSummaries();
+	for(int i = 0; i < (int)summaries.size(); i++)
+	{
+		const EventJournal::SourceSummary& s = summaries[i];
+		if((EventJournal::getServiceTypeMask(s.serviceType) & sel.serviceTypes) == 0) continue;
+		if(sel.sourceId != EventJournal::AnySource && s.sourceId != sel.sourceId) continue;
+		double span = (s.lastTime - s.firstTime) / 1000000.0;
+		printf("%-12s %10u %12llu %12.3f %12.3f %12.1f\n", 
+			getServiceTypeName(s.serviceType).c_str(), s.sourceId, s.eventCount,
+			s.firstTime / 1000000.0, s.lastTime / 1000000.0, 
+			span > 0 ? (s.eventCount - 1) / span : 0.0);
+	}
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+int dump(EventJournalReader& reader, Selection& sel)
+{
+	Vector<int> blocks = selectBlocks(reader, sel);
+	forEachSelected(reader, sel, blocks, [](const EventJournal::Record& r, const char*)
+	{
+		printf("%.6f %s %u type=%u flags=%x pos=(%g %g %g) rot=(%g %g %g %g) extra=%u/%u\n",
+			r.time / 1000000.0, getServiceTypeName(r.serviceType).c_str(), r.sourceId, 
+			r.type, r.flags, r.position[0], r.position[1], r.position[2], 
+			r.orientation[0], r.orientation[1], r.orientation[2], r.orientation[3],
+			r.extraDataType, r.extraDataItems);
+	});
+	fprintf(stderr, "read %d of %d blocks\n", (int)blocks.size(), reader.getBlockCount());
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Prints the number of selected events in each interval of the time window.
+int rate(EventJournalReader& reader, Selection& sel, double interval)
+{
+	if(interval <= 0) 
+	{
+		fprintf(stderr, "ojournal: the rate interval must be positive\n");
+		return 1;
+	}
+	Vector<int> blocks = selectBlocks(reader, sel);
+	if(blocks.empty()) 
+	{
+		printf("no events selected\n");
+		return 0;
+	}
+
+	// Start the intervals at the first selected event, so the first one is full.
+	uint64 step = (uint64)(interval * 1000000.0);
+	if(step == 0) step = 1;
+	uint64 start = 0;
+	bool started = false;
+	Vector<uint64> counts;
+
+	forEachSelected(reader, sel, blocks, [&](const EventJournal::Record& r, const char*)
+	{
+		if(!started)
+		{
+			start = r.time;
+			started = true;
+		}
+		size_t bucket = (size_t)((r.time - start) / step);
+		if(bucket >= counts.size()) counts.resize(bucket + 1, 0);
+		counts[bucket]++;
+	});
+
+	uint64 total = 0;
+	uint64 minCount = (uint64)-1;
+	uint64 maxCount = 0;
+	printf("%12s %12s %12s\n", "time (s)", "events", "rate (ev/s)");
+	for(size_t i = 0; i < counts.size(); i++)
+	{
+		printf("%12.3f %12llu %12.1f\n", (start + i * step) / 1000000.0, counts[i], counts[i] / interval);
+		total += counts[i];
+		if(counts[i] < minCount) minCount = counts[i];
+		if(counts[i] > maxCount) maxCount = counts[i];
+	}
+	if(!counts.empty())
+	{
+		printf("\nevents %llu, rate min %.1f mean %.1f max %.1f ev/s\n", total, 
+			minCount / interval, total / (counts.size() * interval), maxCount / interval);
+	}
+	fprintf(stderr, "read %d of %d blocks\n", (int)blocks.size(), reader.getBlockCount());
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Writes the selected events to a new journal. Blocks that are entirely selected are copied as 
+// they are, without being recompressed; the others are rebuilt from the selected records.
+int extract(EventJournalReader& reader, Selection& sel, const String& output)
+{
+	const EventJournal::FileHeader& header = reader.getFileHeader();
+	EventJournalWriter writer;
+	if(!writer.create(output, header.blockSize, header.creationTime)) return 1;
+
+	Vector<int> blocks = selectBlocks(reader, sel);
+	int copiedBlocks = 0;
+	EventJournal::Record r;
+	const char* extraData;
+	for(int i = 0; i < (int)blocks.size(); i++)
+	{
+		const EventJournal::IndexEntry& block = reader.getBlock(blocks[i]);
+		const char* payload = reader.getBlockPayload(blocks[i]);
+		if(payload == NULL || !reader.seekBlock(blocks[i])) continue;
+		const char* data = reader.getBlockData();
+
+		if(!sel.isFiltered() && block.firstTime >= sel.from && block.lastTime <= sel.to)
+		{
+			writer.copyBlock(block, payload, data);
+			copiedBlocks++;
+			continue;
+		}
+
+		uint position = 0;
+		while(nextRecord(data, block.rawSize, &position, &r, &extraData))
+		{
+			if(sel.matches(r)) writer.copyRecord(r, extraData);
+		}
+	}
+	writer.close();
+
+	printf("extracted %llu events to %s (%d of %d blocks read, %d copied as they are)\n", 
+		writer.getWrittenEvents(), output.c_str(), (int)blocks.size(), reader.getBlockCount(), copiedBlocks);
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Columnar export. Each selected service type gets a directory of raw little endian column files,
+// one per field, that can be memory mapped as arrays. manifest.json lists the columns with their
+// numpy dtype and shape, e.g. in Python:
+//   m = json.load(open('out/manifest.json'))
+//   c = m['services']['mocap']['columns']['extra_vector3']
+//   joints = numpy.memmap('out/' + c['file'], dtype=c['dtype'], mode='r', shape=tuple(c['shape']))
+// Numeric extra data (i.e. skeleton joints) is stored in fixed width columns as wide as the largest
+// event of the service; missing and invalid items are NaN (0 for integers). Strings and other
+// variable size extra data are stored as a byte column and a column of row offsets into it.
+enum Column
+{
+	ColTime, ColTimestamp, ColSource, ColDeviceTag, ColType, ColFlags, ColPosition, ColOrientation,
+	ColExtraType, ColExtraMask, ColExtraFloat, ColExtraInt, ColExtraVector3, ColExtraOffsets, ColExtraBytes,
+	NumColumns
+};
+
+static const char* sColumnNames[NumColumns] = {
+	"time", "timestamp", "source", "device_tag", "type", "flags", "position", "orientation",
+	"extra_type", "extra_mask", "extra_float", "extra_int", "extra_vector3", "extra_offsets", "extra_bytes"
+};
+
+static const char* sColumnTypes[NumColumns] = {
+	"<u8", "<u4", "<u4", "<u4", "<u2", "<u4", "<f4", "<f4",
+	"<u1", "<u4", "<f4", "<i4", "<f4", "<u8", "<u1"
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct ServiceExport
+{
+	uint64 rows;
+	// Width of the fixed width extra data columns, in items. 0 when the column is not needed.
+	int floatItems;
+	int intItems;
+	int vector3Items;
+	// Size of the variable size extra data column. 
+	uint64 extraBytes;
+	bool hasExtraBytes;
+
+	FILE* files[NumColumns];
+	Vector<float> floatRow;
+	Vector<int> intRow;
+
+	ServiceExport(): rows(0), floatItems(0), intItems(0), vector3Items(0), extraBytes(0), hasExtraBytes(false)
+	{ memset(files, 0, sizeof(files)); }
+
+	bool hasColumn(int column)
+	{
+		switch(column)
+		{
+		case ColExtraFloat: return floatItems > 0;
+		case ColExtraInt: return intItems > 0;
+		case ColExtraVector3: return vector3Items > 0;
+		case ColExtraOffsets:
+		case ColExtraBytes: return hasExtraBytes;
+		default: return true;
+		}
+	}
+
+	String getShape(int column)
+	{
+		switch(column)
+		{
+		case ColPosition: return ostr("[%1%, 3]", %rows);
+		case ColOrientation: return ostr("[%1%, 4]", %rows);
+		case ColExtraFloat: return ostr("[%1%, %2%]", %rows %floatItems);
+		case ColExtraInt: return ostr("[%1%, %2%]", %rows %intItems);
+		case ColExtraVector3: return ostr("[%1%, %2%, 3]", %rows %vector3Items);
+		case ColExtraOffsets: return ostr("[%1%]", %(rows + 1));
+		case ColExtraBytes: return ostr("[%1%]", %extraBytes);
+		default: return ostr("[%1%]", %rows);
+		}
+	}
+
+	void write(int column, const void* data, size_t size) { fwrite(data, size, 1, files[column]); }
+
+	// Writes the items of a fixed width float column, NaN-filling the missing ones.
+	void writeFloats(int column, int width, int components, const EventJournal::Record& r, const char* extraData, bool present)
+	{
+		floatRow.assign(width * components, std::numeric_limits<float>::quiet_NaN());
+		for(int i = 0; present && i < r.extraDataItems && i < width; i++)
+		{
+			if(i < 32 && (r.extraDataMask & (1u << i)) == 0) continue;
+			memcpy(&floatRow[i * components], extraData + i * components * 4, components * 4);
+		}
+		write(column, &floatRow[0], floatRow.size() * sizeof(float));
+	}
+
+	void writeRow(const EventJournal::Record& r, const char* extraData)
+	{
+		unsigned char extraType = r.extraDataType;
+		write(ColTime, &r.time, 8);
+		write(ColTimestamp, &r.timestamp, 4);
+		write(ColSource, &r.sourceId, 4);
+		write(ColDeviceTag, &r.deviceTag, 4);
+		write(ColType, &r.type, 2);
+		write(ColFlags, &r.flags, 4);
+		write(ColPosition, r.position, 12);
+		write(ColOrientation, r.orientation, 16);
+		write(ColExtraType, &extraType, 1);
+		write(ColExtraMask, &r.extraDataMask, 4);
+
+		if(floatItems > 0) writeFloats(ColExtraFloat, floatItems, 1, r, extraData, extraType == Event::ExtraDataFloatArray);
+		if(vector3Items > 0) writeFloats(ColExtraVector3, vector3Items, 3, r, extraData, extraType == Event::ExtraDataVector3Array);
+		if(intItems > 0)
+		{
+			intRow.assign(intItems, 0);
+			if(extraType == Event::ExtraDataIntArray)
+			{
+				int items = r.extraDataItems < intItems ? r.extraDataItems : intItems;
+				memcpy(&intRow[0], extraData, items * 4);
+			}
+			write(ColExtraInt, &intRow[0], intRow.size() * sizeof(int));
+		}
+		if(hasExtraBytes)
+		{
+			write(ColExtraOffsets, &extraBytes, 8);
+			if(isVariableSize(extraType))
+			{
+				write(ColExtraBytes, extraData, r.extraDataSize);
+				extraBytes += r.extraDataSize;
+			}
+		}
+	}
+
+	static bool isVariableSize(uint extraType)
+	{
+		return extraType != Event::ExtraDataNull && extraType != Event::ExtraDataFloatArray &&
+			extraType != Event::ExtraDataIntArray && extraType != Event::ExtraDataVector3Array;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+String jsonEscape(const String& str)
+{
+	String result;
+	for(size_t i = 0; i < str.size(); i++)
+	{
+		if(str[i] == '"' || str[i] == '\\') result += '\\';
+		result += str[i];
+	}
+	return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+int exportColumns(EventJournalReader& reader, Selection& sel, const String& journalFile, const String& output)
+{
+	Vector<int> blocks = selectBlocks(reader, sel);
+	ServiceExport services[32];
+
+	// First pass: count rows and find the width of the extra data columns.
+	forEachSelected(reader, sel, blocks, [&](const EventJournal::Record& r, const char*)
+	{
+		ServiceExport& se = services[r.serviceType & 31];
+		se.rows++;
+		int items = r.extraDataItems;
+		switch(r.extraDataType)
+		{
+		case Event::ExtraDataNull: break;
+		case Event::ExtraDataFloatArray: if(items > se.floatItems) se.floatItems = items; break;
+		case Event::ExtraDataIntArray: if(items > se.intItems) se.intItems = items; break;
+		case Event::ExtraDataVector3Array: if(items > se.vector3Items) se.vector3Items = items; break;
+		default: se.hasExtraBytes = true;
+		}
+	});
+
+	// Open the column files.
+	DataManager::createPath(output);
+	bool ok = true;
+	for(int s = 0; s < 32; s++)
+	{
+		if(services[s].rows == 0) continue;
+		String dir = output + "/" + getServiceTypeName(s);
+		DataManager::createPath(dir);
+		for(int c = 0; c < NumColumns; c++)
+		{
+			if(!services[s].hasColumn(c)) continue;
+			String path = dir + "/" + sColumnNames[c] + ".bin";
+			FILE* f = fopen(path.c_str(), "wb");
+			if(f == NULL)
+			{
+				fprintf(stderr, "ojournal: could not open %s for writing\n", path.c_str());
+				ok = false;
+				continue;
+			}
+			setvbuf(f, NULL, _IOFBF, 1 << 20);
+			services[s].files[c] = f;
+		}
+	}
+
+	// Second pass: write the rows.
+	if(ok)
+	{
+		forEachSelected(reader, sel, blocks, [&](const EventJournal::Record& r, const char* extraData)
+		{
+			services[r.serviceType & 31].writeRow(r, extraData);
+		});
+	}
+
+	// Close the column files and write the manifest.
+	String manifestPath = output + "/manifest.json";
+	FILE* manifest = ok ? fopen(manifestPath.c_str(), "w") : NULL;
+	if(ok && manifest == NULL)
+	{
+		fprintf(stderr, "ojournal: could not open %s for writing\n", manifestPath.c_str());
+		ok = false;
+	}
+	if(manifest != NULL)
+	{
+		fprintf(manifest, "{\n  \"journal\": \"%s\",\n  \"creationTime\": %llu,\n  \"timeUnit\": \"us\",\n  \"services\": {", 
+			jsonEscape(journalFile).c_str(), reader.getFileHeader().creationTime);
+	}
+	bool firstService = true;
+	uint64 rows = 0;
+	int serviceCount = 0;
+	for(int s = 0; s < 32; s++)
+	{
+		ServiceExport& se = services[s];
+		if(se.rows == 0) continue;
+		if(se.hasExtraBytes && se.files[ColExtraOffsets] != NULL)
+		{
+			// Terminate the offsets, so row i spans offsets[i] to offsets[i + 1].
+			se.write(ColExtraOffsets, &se.extraBytes, 8);
+		}
+		String name = getServiceTypeName(s);
+		if(manifest != NULL)
+		{
+			fprintf(manifest, "%s\n    \"%s\": {\n      \"rows\": %llu,\n      \"columns\": {", 
+				firstService ? "" : ",", name.c_str(), se.rows);
+		}
+		bool firstColumn = true;
+		for(int c = 0; c < NumColumns; c++)
+		{
+			if(se.files[c] == NULL) continue;
+			fclose(se.files[c]);
+			se.files[c] = NULL;
+			if(manifest != NULL)
+			{
+				fprintf(manifest, "%s\n        \"%s\": { \"file\": \"%s/%s.bin\", \"dtype\": \"%s\", \"shape\": %s }",
+					firstColumn ? "" : ",", sColumnNames[c], name.c_str(), sColumnNames[c], sColumnTypes[c], 
+					se.getShape(c).c_str());
+			}
+			firstColumn = false;
+		}
+		if(manifest != NULL) fprintf(manifest, "\n      }\n    }");
+		firstService = false;
+		rows += se.rows;
+		serviceCount++;
+	}
+	if(manifest != NULL)
+	{
+		fprintf(manifest, "\n  }\n}\n");
+		fclose(manifest);
+	}
+	if(!ok) return 1;
+
+	printf("exported %llu events of %d service types to %s (%d of %d blocks read)\n", 
+		rows, serviceCount, output.c_str(), (int)blocks.size(), reader.getBlockCount());
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	std::string command;
+	std::string journalFile;
+	std::string outputFile;
+	std::string serviceArg;
+	double from = 0;
+	double to = -1;
+	double interval = 1;
+	int source = -1;
+
+	libconfig::ArgumentHelper ah;
+	ah.setName("ojournal");
+	ah.setDescription("Inspects, slices and exports event journals. Commands:\n"
+		"  info     print the journal layout and per-source event counts and rates\n"
+		"  dump     print the selected events\n"
+		"  rate     print the selected event rate over time\n"
+		"  extract  write the selected events to a new journal (output argument)\n"
+		"  export   write the selected events as column files, one directory per service type,\n"
+		"           to the output directory");
+	ah.newString("command", "info, dump, rate, extract or export", command);
+	ah.newString("journal", "Journal file", journalFile);
+	ah.newOptionalString("output", "Output journal (extract) or directory (export)", outputFile);
+	ah.newNamedDouble('f', "from", "seconds", "Start of the time window (default: journal start)", from);
+	ah.newNamedDouble('t', "to", "seconds", "End of the time window (default: journal end)", to);
+	ah.newNamedString('s', "service", "type", "Select a service type, by name (pointer, mocap, ...) or number", serviceArg);
+	ah.newNamedInt('i', "source", "id", "Select a source id", source);
+	ah.newNamedDouble('r', "interval", "seconds", "Rate interval (default 1)", interval);
+	if(!ah.process(argc, argv)) return 1;
+
+	ologdisable();
+
+	Selection sel;
+	sel.from = from > 0 ? (uint64)(from * 1000000.0) : 0;
+	sel.to = to >= 0 ? (uint64)(to * 1000000.0) : (uint64)-1;
+	sel.serviceTypes = EventJournal::AllServiceTypes;
+	sel.sourceId = source >= 0 ? (uint)source : EventJournal::AnySource;
+	if(!serviceArg.empty())
+	{
+		uint serviceType;
+		if(!parseServiceType(serviceArg, &serviceType))
+		{
+			fprintf(stderr, "ojournal: unknown service type %s\n", serviceArg.c_str());
+			return 1;
+		}
+		sel.serviceTypes = EventJournal::getServiceTypeMask(serviceType);
+	}
+
+	EventJournalReader reader;
+	if(!reader.open(journalFile))
+	{
+		fprintf(stderr, "ojournal: could not open %s\n", journalFile.c_str());
+		return 1;
+	}
+	if(reader.isRecovered()) 
+	{
+		fprintf(stderr, "ojournal: %s was not closed properly, its index has been rebuilt\n", journalFile.c_str());
+	}
+
+	if(command == "info") return info(reader, sel);
+	if(command == "dump") return dump(reader, sel);
+	if(command == "rate") return rate(reader, sel, interval);
+	if(command == "extract")
+	{
+		if(outputFile.empty())
+		{
+			fprintf(stderr, "ojournal: extract needs an output journal\n");
+			return 1;
+		}
+		return extract(reader, sel, outputFile);
+	}
+	if(command == "export")
+	{
+		if(outputFile.empty())
+		{
+			fprintf(stderr, "ojournal: export needs an output directory\n");
+			return 1;
+		}
+		return exportColumns(reader, sel, journalFile, outputFile);
+	}
+	fprintf(stderr, "ojournal: unknown command %s\n", command.c_str());
+	return 1;
+}
@@ -0,0 +1,591 @@
+/**************************************************************************************************
+* THE OMICRON PROJECT
+ *-------------------------------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *-------------------------------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory, University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted 
+ * provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this list of conditions 
+ * and the following disclaimer. Redistributions in binary form must reproduce the above copyright 
+ * notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR 
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND 
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR SERVICES; LOSS OF 
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *************************************************************************************************/
+// oinputbench: end-to-end latency and throughput benchmark for the input server.
+// Each run starts an oinputserver process generating probe events with a LoadGeneratorService
+// (see its probeRate option), and connects N omicron connector clients over loopback, each polled
+// by its own thread. Probe events carry their sequence number and steady clock publish time, so 
+// clients can measure publish-to-receive latency and loss, and count the bytes they receive.
+// The benchmark sweeps connection modes, client counts and event rates, prints a summary table 
+// and optionally writes CSV / JSON results. With -i the input server runs in process instead.
+#include <omicron.h>
+#include "omicron/InputServer.h"
+#include "connector/omicronConnectorClient.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+
+#ifndef OMICRON_OS_WIN
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace omicron;
+
+// Source id used by probe events.
+static const uint ProbeSourceId = 0x0be4c;
+// Configuration written for the server of each run. Configuration files are
+// looked up in the data sources, so it goes to the current directory.
+static const char* ConfigFile = "oinputbench.cfg";
+// Output of the server processes.
+static const char* ServerLogFile = "oinputbench-server.log";
+// Runs sending less than this fraction of the requested rate are flagged.
+static const double MinRateRatio = 0.9;
+
+///////////////////////////////////////////////////////////////////////////////
+static uint64 nowMicros()
+{
+	return (uint64)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! A connector client polled by its own thread. Keeps the latency and sequence
+//! number of the probes published during the measurement window, and counts
+//! the bytes received during the window.
+class BenchClient: public omicronConnector::IOmicronConnectorClientListener, public Thread
+{
+public:
+	BenchClient(): myConnector(this), myRunning(false), myWindowStart(~0ull), myWindowEnd(0),
+		myReceived(0), myBytes(0), myMinSeq(~0u), myMaxSeq(0) {}
+
+	bool connect(const char* server, int port, int dataPort, int mode, int flags, const char* subscription)
+	{
+		myConnector.setClientFlags(flags);
+		myConnector.setSubscription(subscription);
+		if(!myConnector.connect(server, port, dataPort, mode)) return false;
+		myRunning = true;
+		start();
+		return true;
+	}
+
+	void disconnect()
+	{
+		myRunning = false;
+		stop();
+		myConnector.dispose();
+	}
+
+	//! Sets the measurement window, in steady clock microseconds.
+	void setWindow(uint64 start, uint64 end) { myWindowStart = start; myWindowEnd = end; }
+
+	virtual void threadProc()
+	{
+		while(myRunning)
+		{
+			unsigned long long bytes = myConnector.getReceivedBytes();
+			myConnector.poll();
+			bytes = myConnector.getReceivedBytes() - bytes;
+			uint64 now = nowMicros();
+			if(now >= myWindowStart && now < myWindowEnd) myBytes += bytes;
+			if(bytes == 0) osleep(0);
+		}
+	}
+
+	virtual void onEvent(const omicronConnector::EventData& e)
+	{
+		if(e.serviceType != Service::Generic || e.sourceId != ProbeSourceId || e.extraDataItems < 3) return;
+
+		uint64 now = nowMicros();
+		uint seq = (uint)e.getExtraDataInt(0);
+		uint64 sent = (uint)e.getExtraDataInt(1) | ((uint64)(uint)e.getExtraDataInt(2) << 32);
+		if(sent < myWindowStart || sent >= myWindowEnd) return;
+
+		if(seq >= mySeen.size()) mySeen.resize(seq + 1024, false);
+		if(mySeen[seq]) return;
+		mySeen[seq] = true;
+		myLatencies.push_back((float)(now - sent));
+		myMinSeq = std::min(myMinSeq, seq);
+		myMaxSeq = std::max(myMaxSeq, seq);
+		myReceived++;
+	}
+
+	// Only valid after disconnect.
+	uint getReceived() { return myReceived; }
+	uint64 getBytes() { return myBytes; }
+	uint getMinSeq() { return myMinSeq; }
+	uint getMaxSeq() { return myMaxSeq; }
+	const std::vector<float>& getLatencies() { return myLatencies; }
+
+private:
+	omicronConnector::OmicronConnectorClient myConnector;
+	volatile bool myRunning;
+	std::atomic<uint64> myWindowStart;
+	std::atomic<uint64> myWindowEnd;
+	uint myReceived;
+	uint64 myBytes;
+	uint myMinSeq;
+	uint myMaxSeq;
+	std::vector<bool> mySeen;
+	std::vector<float> myLatencies;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! The input server under test, configured by ConfigFile.
+class BenchServer
+{
+public:
+	virtual ~BenchServer() {}
+	virtual bool launch() = 0;
+	//! Returns false if the server exited on its own.
+	virtual bool isRunning() = 0;
+	virtual void shutdown() = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! Runs oinputserver in a child process.
+class ServerProcess: public BenchServer
+{
+public:
+	ServerProcess(const String& executable): myExecutable(executable) 
+	{
+#ifdef OMICRON_OS_WIN
+		memset(&myProcess, 0, sizeof(myProcess));
+#else
+		myPid = -1;
+#endif
+	}
+
+#ifdef OMICRON_OS_WIN
+	virtual bool launch()
+	{
+		STARTUPINFOA si;
+		memset(&si, 0, sizeof(si));
+		si.cb = sizeof(si);
+		String cmd = ostr("\"%1%\" %2%", %myExecutable %ConfigFile);
+		std::vector<char> cmdLine(cmd.begin(), cmd.end());
+		cmdLine.push_back(0);
+		if(!CreateProcessA(NULL, &cmdLine[0], NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &si, &myProcess))
+		{
+			ofwarn("oinputbench: could not start %1%", %myExecutable);
+			return false;
+		}
+		return true;
+	}
+
+	virtual bool isRunning()
+	{
+		return WaitForSingleObject(myProcess.hProcess, 0) == WAIT_TIMEOUT;
+	}
+
+	virtual void shutdown()
+	{
+		TerminateProcess(myProcess.hProcess, 0);
+		WaitForSingleObject(myProcess.hProcess, INFINITE);
+		CloseHandle(myProcess.hThread);
+		CloseHandle(myProcess.hProcess);
+	}
+#else
+	virtual bool launch()
+	{
+		myPid = fork();
+		if(myPid == 0)
+		{
+			int fd = open(ServerLogFile, O_WRONLY | O_CREAT | O_APPEND, 0644);
+			if(fd >= 0)
+			{
+				dup2(fd, STDOUT_FILENO);
+				dup2(fd, STDERR_FILENO);
+				close(fd);
+			}
+			execlp(myExecutable.c_str(), myExecutable.c_str(), ConfigFile, (char*)NULL);
+			_exit(127);
+		}
+		if(myPid < 0)
+		{
+			ofwarn("oinputbench: could not start %1%", %myExecutable);
+			return false;
+		}
+		return true;
+	}
+
+	virtual bool isRunning()
+	{
+		int status;
+		return waitpid(myPid, &status, WNOHANG) == 0;
+	}
+
+	virtual void shutdown()
+	{
+		// oinputserver shuts down cleanly on SIGINT.
+		kill(myPid, SIGINT);
+		int status;
+		waitpid(myPid, &status, 0);
+		myPid = -1;
+	}
+#endif
+
+private:
+	String myExecutable;
+#ifdef OMICRON_OS_WIN
+	PROCESS_INFORMATION myProcess;
+#else
+	pid_t myPid;
+#endif
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//! Runs an InputServer in process, fed by a ServiceManager on its own thread
+//! exactly like the oinputserver main loop.
+class InProcessServer: public BenchServer, public Thread
+{
+public:
+	InProcessServer(): myConfig(NULL), myServiceManager(NULL), myRunning(false) {}
+
+	virtual bool launch()
+	{
+		myConfig = new Config(ConfigFile);
+		if(!myConfig->load()) 
+		{
+			delete myConfig;
+			myConfig = NULL;
+			return false;
+		}
+		myServiceManager = new ServiceManager();
+		myServiceManager->setupAndStart(myConfig);
+		myServer.startConnection(myConfig);
+		myRunning = true;
+		start();
+		return true;
+	}
+
+	virtual bool isRunning() { return myRunning; }
+
+	virtual void shutdown()
+	{
+		if(!myRunning) return;
+		myRunning = false;
+		stop();
+		myServer.dispose();
+		myServiceManager->stop();
+		myServiceManager->dispose();
+		delete myServiceManager;
+		delete myConfig;
+	}
+
+	virtual void threadProc()
+	{
+		while(myRunning)
+		{
+			myServiceManager->poll();
+			myServer.loop();
+			myServer.startListening();
+			myServer.setServiceManager(myServiceManager);
+
+			int av = myServiceManager->getAvailableEvents();
+			if(av != 0)
+			{
+				myServiceManager->lockEvents();
+				for(int evtNum = 0; evtNum < av; evtNum++)
+				{
+					Event* e = myServiceManager->getEvent(evtNum);
+					myServer.handleEvent(*e);
+					e->setProcessed();
+				}
+				myServiceManager->unlockEvents();
+			}
+		}
+	}
+
+private:
+	Config* myConfig;
+	ServiceManager* myServiceManager;
+	InputServer myServer;
+	volatile bool myRunning;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+struct BenchMode
+{
+	const char* name;
+	int mode;
+	int flags;
+	const char* subscription;
+};
+
+static BenchMode sModes[] = {
+	{ "v1", omicronConnector::ModeDataOn, omicronConnector::FlagServiceTypeAll, "" },
+	{ "v2", omicronConnector::ModeV2, omicronConnector::FlagServiceTypeAll, "" },
+	{ "v3", omicronConnector::ModeV3, omicronConnector::FlagServiceTypeAll, "" },
+	{ "v3r", omicronConnector::ModeV3, omicronConnector::FlagServiceTypeAll | omicronConnector::FlagReliableUDP, "" },
+	{ "v4", omicronConnector::ModeV4, omicronConnector::FlagServiceTypeAll, "service=Generic" },
+};
+
+///////////////////////////////////////////////////////////////////////////////
+struct BenchResult
+{
+	String mode;
+	int clients;
+	float rate;
+	float duration;
+	// Probes the server sent during the measurement, and the resulting rate.
+	uint sent;
+	double sentRate;
+	bool rateOk;
+	uint64 received;
+	double loss;
+	double eventsPerSec;
+	double bytesPerSec;
+	double p50;
+	double p99;
+	double p999;
+	double max;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+static void writeConfig(int port, float rate)
+{
+	std::ofstream f(ConfigFile);
+	f << "config:\n{\n"
+		<< "\tserverPort = \"" << port << "\";\n"
+		<< "\tservices:\n\t{\n"
+		<< "\t\tLoadGeneratorService:\n\t\t{\n"
+		<< "\t\t\tprobeRate = " << rate << ";\n"
+		<< "\t\t\tprobeSourceId = " << ProbeSourceId << ";\n"
+		<< "\t\t};\n\t};\n};\n";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static double percentile(std::vector<float>& v, double p)
+{
+	if(v.empty()) return 0;
+	size_t n = (size_t)(p * (v.size() - 1));
+	std::nth_element(v.begin(), v.begin() + n, v.end());
+	return v[n];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static BenchResult run(BenchServer* server, const BenchMode& mode, int numClients, float rate, float duration, int port, int dataPort)
+{
+	BenchResult r;
+	r.mode = mode.name;
+	r.clients = numClients;
+	r.rate = rate;
+	r.duration = duration;
+	r.sent = 0;
+	r.sentRate = 0;
+	r.rateOk = false;
+	r.received = 0;
+	r.loss = 1;
+	r.eventsPerSec = r.bytesPerSec = 0;
+	r.p50 = r.p99 = r.p999 = r.max = 0;
+
+	writeConfig(port, rate);
+	if(!server->launch()) return r;
+
+	// Give the server a few seconds to start listening.
+	std::vector<BenchClient*> clients;
+	for(int i = 0; i < numClients; i++)
+	{
+		BenchClient* c = new BenchClient();
+		bool connected = c->connect("127.0.0.1", port, dataPort + i, mode.mode, mode.flags, mode.subscription);
+		for(int retry = 0; !connected && clients.empty() && retry < 50 && server->isRunning(); retry++)
+		{
+			osleep(100);
+			connected = c->connect("127.0.0.1", port, dataPort + i, mode.mode, mode.flags, mode.subscription);
+		}
+		if(connected)
+		{
+			clients.push_back(c);
+		}
+		else
+		{
+			ofwarn("oinputbench: client %1% could not connect", %i);
+			delete c;
+		}
+		// Let the server accept the connection before the next client connects.
+		osleep(10);
+	}
+
+	// Warm up, then measure. Wait a bit after the measurement before 
+	// disconnecting, so probes still in flight are delivered.
+	uint64 windowStart = nowMicros() + 300000;
+	uint64 windowEnd = windowStart + (uint64)(duration * 1000000);
+	foreach(BenchClient* c, clients) c->setWindow(windowStart, windowEnd);
+	osleep((uint)((windowEnd - nowMicros()) / 1000) + 1000);
+
+	std::vector<float> latencies;
+	uint64 bytes = 0;
+	uint minSeq = ~0u;
+	uint maxSeq = 0;
+	foreach(BenchClient* c, clients)
+	{
+		c->disconnect();
+		r.received += c->getReceived();
+		bytes += c->getBytes();
+		if(c->getReceived() > 0)
+		{
+			minSeq = std::min(minSeq, c->getMinSeq());
+			maxSeq = std::max(maxSeq, c->getMaxSeq());
+		}
+		latencies.insert(latencies.end(), c->getLatencies().begin(), c->getLatencies().end());
+		delete c;
+	}
+	server->shutdown();
+
+	// Probes carry consecutive sequence numbers, so the range received by all 
+	// clients is the number of probes the server sent while recording.
+	r.sent = maxSeq >= minSeq ? maxSeq - minSeq + 1 : 0;
+	r.sentRate = r.sent / duration;
+	r.rateOk = r.sentRate >= rate * MinRateRatio;
+	uint64 expected = (uint64)r.sent * numClients;
+	r.loss = expected > 0 ? 1.0 - (double)r.received / expected : 1;
+	r.eventsPerSec = r.received / duration;
+	r.bytesPerSec = bytes / duration;
+	r.p50 = percentile(latencies, 0.5);
+	r.p99 = percentile(latencies, 0.99);
+	r.p999 = percentile(latencies, 0.999);
+	r.max = latencies.empty() ? 0 : *std::max_element(latencies.begin(), latencies.end());
+
+	return r;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void writeCsv(const String& filename, const std::vector<BenchResult>& results)
+{
+	std::ofstream f(filename.c_str());
+	f << "mode,clients,rate,duration,sent,sent_rate,rate_ok,received,loss,events_per_sec,bytes_per_sec,p50_us,p99_us,p999_us,max_us\n";
+	foreach(const BenchResult& r, results)
+	{
+		f << r.mode << "," << r.clients << "," << r.rate << "," << r.duration << "," 
+			<< r.sent << "," << r.sentRate << "," << (r.rateOk ? 1 : 0) << ","
+			<< r.received << "," << r.loss << "," << r.eventsPerSec << "," 
+			<< r.bytesPerSec << "," << r.p50 << "," << r.p99 << "," << r.p999 << "," << r.max << "\n";
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void writeJson(const String& filename, const std::vector<BenchResult>& results)
+{
+	std::ofstream f(filename.c_str());
+	f << "[\n";
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult& r = results[i];
+		f << "  { \"mode\": \"" << r.mode << "\", \"clients\": " << r.clients 
+			<< ", \"rate\": " << r.rate << ", \"duration\": " << r.duration
+			<< ", \"sent\": " << r.sent << ", \"sent_rate\": " << r.sentRate 
+			<< ", \"rate_ok\": " << (r.rateOk ? "true" : "false") << ", \"received\": " << r.received 
+			<< ", \"loss\": " << r.loss << ", \"events_per_sec\": " << r.eventsPerSec 
+			<< ", \"bytes_per_sec\": " << r.bytesPerSec << ", \"p50_us\": " << r.p50 
+			<< ", \"p99_us\": " << r.p99 << ", \"p999_us\": " << r.p999 << ", \"max_us\": " << r.max 
+			<< " }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	f << "]\n";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	std::string modesArg = "v1,v2,v3,v4";
+	std::string clientsArg = "1,4,16";
+	std::string ratesArg = "1000,10000";
+	std::string csvFile;
+	std::string jsonFile;
+	std::string serverExecutable;
+	bool inProcess = false;
+	double duration = 2.0;
+	int port = 28000;
+	int dataPort = 29000;
+
+	libconfig::ArgumentHelper ah;
+	ah.setName("oinputbench");
+	ah.setDescription("End-to-end latency and throughput benchmark for the omicron input server");
+	ah.newNamedString('m', "modes", "list", "Connection modes: v1, v2, v3, v3r (reliable udp), v4 (default v1,v2,v3,v4)", modesArg);
+	ah.newNamedString('c', "clients", "list", "Client counts (default 1,4,16)", clientsArg);
+	ah.newNamedString('r', "rates", "list", "Event rates in events/s (default 1000,10000)", ratesArg);
+	ah.newNamedDouble('d', "duration", "seconds", "Measurement duration of each run (default 2)", duration);
+	ah.newNamedInt('p', "port", "port", "First server port. Each run uses the next one (default 28000)", port);
+	ah.newNamedInt('u', "data-port", "port", "First client data port (default 29000)", dataPort);
+	ah.newNamedString('s', "server", "file", "oinputserver executable (default: the one next to oinputbench)", serverExecutable);
+	ah.newFlag('i', "in-process", "Run the input server in this process instead of starting oinputserver", inProcess);
+	ah.newNamedString('o', "csv", "file", "Write results to a CSV file", csvFile);
+	ah.newNamedString('j', "json", "file", "Write results to a JSON file", jsonFile);
+	if(!ah.process(argc, argv)) return 1;
+
+	// The in process server finds its configuration here. 
+	DataManager* dm = DataManager::getInstance();
+	dm->addSource(new FilesystemDataSource("./"));
+
+	if(serverExecutable.empty())
+	{
+		String basename, path;
+		StringUtils::splitFilename(argv[0], basename, path);
+		serverExecutable = path + "oinputserver";
+	}
+
+	Vector<String> modes = StringUtils::split(modesArg, ",");
+	Vector<String> clientCounts = StringUtils::split(clientsArg, ",");
+	Vector<String> rates = StringUtils::split(ratesArg, ",");
+
+	std::vector<BenchResult> results;
+	printf("%-5s %7s %9s %10s %10s %10s %8s %12s %13s %9s %9s %9s %9s\n", 
+		"mode", "clients", "rate", "sent/s", "sent", "received", "loss", "events/s", "bytes/s", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+	foreach(const String& modeName, modes)
+	{
+		const BenchMode* mode = NULL;
+		for(size_t i = 0; i < sizeof(sModes) / sizeof(BenchMode); i++)
+		{
+			if(modeName == sModes[i].name) mode = &sModes[i];
+		}
+		if(mode == NULL)
+		{
+			ofwarn("oinputbench: unknown mode %1%", %modeName);
+			continue;
+		}
+
+		foreach(const String& clients, clientCounts)
+		{
+			foreach(const String& rate, rates)
+			{
+				BenchServer* server = inProcess ? 
+					(BenchServer*)new InProcessServer() : (BenchServer*)new ServerProcess(serverExecutable);
+				BenchResult r = run(server, *mode, atoi(clients.c_str()), (float)atof(rate.c_str()), (float)duration, port++, dataPort);
+				delete server;
+
+				printf("%-5s %7d %9.0f %10.0f %10u %10llu %7.3f%% %12.0f %13.0f %9.1f %9.1f %9.1f %9.1f\n", 
+					r.mode.c_str(), r.clients, r.rate, r.sentRate, r.sent, (unsigned long long)r.received, r.loss * 100,
+					r.eventsPerSec, r.bytesPerSec, r.p50, r.p99, r.p999, r.max);
+				if(!r.rateOk)
+				{
+					ofwarn("oinputbench: the server sent %1% events/s, less than the requested %2%", 
+						%(int)r.sentRate %r.rate);
+				}
+				fflush(stdout);
+				results.push_back(r);
+			}
+		}
+	}
+
+	if(!csvFile.empty()) writeCsv(csvFile, results);
+	if(!jsonFile.empty()) writeJson(jsonFile, results);
+	return 0;
+}
@@ -0,0 +1,451 @@
+/**************************************************************************************************
+* THE OMICRON PROJECT
+ *-------------------------------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *-------------------------------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory, University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted 
+ * provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this list of conditions 
+ * and the following disclaimer. Redistributions in binary form must reproduce the above copyright 
+ * notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR 
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND 
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR SERVICES; LOSS OF 
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *************************************************************************************************/
+// omicron_bench: microbenchmarks for the omicron core hot paths.
+// Each benchmark runs its operation in batches until a minimum time has elapsed and reports the
+// average time and the number of heap allocations per operation. Allocations are counted by
+// replacing the global operator new in this executable, so allocations made inside the omicron
+// library are counted too.
+#include <omicron.h>
+#include "omicron/InputServer.h"
+#include "omicron/TouchGestureManager.h"
+#include "connector/omicronConnectorClient.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+using namespace omicron;
+
+static std::atomic<uint64> sAllocations(0);
+
+///////////////////////////////////////////////////////////////////////////////
+void* operator new(size_t size)
+{
+	sAllocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(size != 0 ? size : 1);
+	if(p == NULL) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+
+///////////////////////////////////////////////////////////////////////////////
+struct BenchResult
+{
+	String name;
+	uint64 ops;
+	double nsPerOp;
+	double allocsPerOp;
+};
+
+static std::vector<BenchResult> sResults;
+static double sMinTime = 0.25;
+static String sFilter;
+// Benchmarks accumulate their results here, so the compiler can't drop the
+// benchmarked calls.
+static volatile uint64 sSink;
+
+///////////////////////////////////////////////////////////////////////////////
+static double nowSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static bool isEnabled(const String& name)
+{
+	return sFilter.empty() || name.find(sFilter) != String::npos;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void report(const String& name, uint64 ops, double seconds, uint64 allocations)
+{
+	BenchResult r;
+	r.name = name;
+	r.ops = ops;
+	r.nsPerOp = ops > 0 ? seconds * 1e9 / ops : 0;
+	r.allocsPerOp = ops > 0 ? (double)allocations / ops : 0;
+	printf("%-56s %12llu %12.1f %12.2f\n", r.name.c_str(), (unsigned long long)r.ops, r.nsPerOp, r.allocsPerOp);
+	fflush(stdout);
+	sResults.push_back(r);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Runs op(i) with an increasing i, in doubling batches, until the minimum
+// benchmark time has elapsed.
+template<typename Op> static void bench(const String& name, Op op)
+{
+	if(!isEnabled(name)) return;
+
+	// Warm up caches and any lazily allocated state.
+	for(uint64 i = 0; i < 64; i++) op(i);
+
+	uint64 ops = 0;
+	uint64 batch = 16;
+	uint64 allocations = sAllocations.load();
+	double start = nowSeconds();
+	double elapsed = 0;
+	while(elapsed < sMinTime)
+	{
+		for(uint64 i = 0; i < batch; i++) op(ops + i);
+		ops += batch;
+		elapsed = nowSeconds() - start;
+		if(batch < (1 << 20)) batch *= 2;
+	}
+	report(name, ops, elapsed, sAllocations.load() - allocations);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void initBenchEvent(Event* evt)
+{
+	evt->reset(Event::Update, Service::Mocap, 1);
+	evt->setPosition(1.0f, 1.5f, -2.0f);
+	evt->setOrientation(1.0f, 0.0f, 0.0f, 0.0f);
+	evt->setExtraDataType(Event::ExtraDataFloatArray);
+	for(int i = 0; i < 8; i++) evt->setExtraDataFloat(i, (float)i);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void benchEventSerialization()
+{
+	// EventData embeds a large extra data buffer: keep it off the stack.
+	static omicronConnector::EventData ed;
+	Event evt;
+	initBenchEvent(&evt);
+
+	bench("Event::serialize", [&](uint64) 
+	{
+		sSink += evt.serialize(&ed);
+	});
+
+	evt.serialize(&ed);
+	Event out;
+	bench("Event::deserialize", [&](uint64) 
+	{
+		out.deserialize(&ed);
+		sSink += out.getExtraDataItems();
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void benchPackets()
+{
+	static char packet[DEFAULT_LRGBUFLEN];
+	static omicronConnector::EventData ed;
+	Event evt;
+	initBenchEvent(&evt);
+
+	bench("InputServer::createOmicronPacketFromEvent", [&](uint64) 
+	{
+		char* p = InputServer::createOmicronPacketFromEvent(&evt);
+		sSink += p[0];
+		delete[] p;
+	});
+
+	bench("InputServer::writeOmicronPacketFromEvent", [&](uint64) 
+	{
+		sSink += InputServer::writeOmicronPacketFromEvent(&evt, packet);
+	});
+
+	// The parsing half of parseDGram: the socket read is covered end to end 
+	// by oinputbench.
+	int length = InputServer::writeOmicronPacketFromEvent(&evt, packet);
+	bench("OmicronConnectorClient::parseDGram (parseEventPacket)", [&](uint64) 
+	{
+		omicronConnector::OmicronConnectorClient::parseEventPacket(packet, length, &ed);
+		sSink += ed.extraDataItems;
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//! Writes events to a service manager as fast as possible, the way services
+//! running their own threads do.
+class ProducerThread: public Thread
+{
+public:
+	ProducerThread(ServiceManager* sm): myManager(sm), myRunning(false), myWritten(0) {}
+
+	void begin() { myRunning = true; start(); }
+	void end() { myRunning = false; stop(); }
+	uint64 getWritten() { return myWritten; }
+
+	virtual void threadProc()
+	{
+		while(myRunning)
+		{
+			myManager->lockEvents();
+			Event* evt = myManager->writeHead();
+			evt->reset(Event::Update, Service::Mocap, (uint)myWritten);
+			myManager->unlockEvents();
+			myWritten++;
+		}
+	}
+
+private:
+	ServiceManager* myManager;
+	volatile bool myRunning;
+	volatile uint64 myWritten;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// N producer threads write events while the main thread reads them back. 
+// Time per operation is the run time divided by the number of written events.
+static void benchServiceManager()
+{
+	int producerCounts[] = { 1, 2, 4, 8 };
+	for(int p = 0; p < 4; p++)
+	{
+		int numProducers = producerCounts[p];
+		String name = ostr("ServiceManager::writeHead/readTail (%1% producers)", %numProducers);
+		if(!isEnabled(name)) continue;
+
+		ServiceManager* sm = new ServiceManager();
+		sm->initialize();
+
+		std::vector<ProducerThread*> producers;
+		for(int i = 0; i < numProducers; i++) producers.push_back(new ProducerThread(sm));
+
+		uint64 read = 0;
+		uint64 allocations = sAllocations.load();
+		double start = nowSeconds();
+		foreach(ProducerThread* t, producers) t->begin();
+		while(nowSeconds() - start < sMinTime)
+		{
+			sm->lockEvents();
+			while(sm->readTail() != NULL) read++;
+			sm->unlockEvents();
+		}
+		foreach(ProducerThread* t, producers) t->end();
+		double elapsed = nowSeconds() - start;
+		allocations = sAllocations.load() - allocations;
+
+		uint64 written = 0;
+		foreach(ProducerThread* t, producers)
+		{
+			written += t->getWritten();
+			delete t;
+		}
+		sSink += read;
+		report(name, written, elapsed, allocations);
+
+		sm->dispose();
+		delete sm;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Moves one of N active touches per operation, or all of them as one frame,
+// and polls the resulting groups. The touch group size is kept small, so each
+// touch ends up in its own group.
+static void benchTouchGestures(Config* cfg)
+{
+	Setting& s = cfg->lookup("config/touchGestureManager");
+
+	int touchCounts[] = { 10, 100, 1000 };
+	for(int c = 0; c < 3; c++)
+	{
+		int numTouches = touchCounts[c];
+		String name = ostr("TouchGestureManager::addTouch (%1% touches)", %numTouches);
+		String frameName = ostr("TouchGestureManager::addTouches (%1% touch frame)", %numTouches);
+		String pollName = ostr("TouchGestureManager::poll (%1% groups)", %numTouches);
+		if(!isEnabled(name) && !isEnabled(frameName) && !isEnabled(pollName)) continue;
+
+		ServiceManager* sm = new ServiceManager();
+		sm->initialize();
+		Service* svc = new Service();
+		sm->addService(svc);
+
+		// The gesture manager logs every new touch group.
+		ologdisable();
+
+		TouchGestureManager* tgm = new TouchGestureManager();
+		tgm->setup(s);
+		tgm->registerPQService(svc);
+
+		int side = (int)ceil(sqrt((float)numTouches));
+		std::vector<Touch> touches(numTouches);
+		for(int i = 0; i < numTouches; i++)
+		{
+			Touch& t = touches[i];
+			t.ID = i;
+			t.xPos = (0.5f + i % side) / side;
+			t.yPos = (0.5f + i / side) / side;
+			t.xWidth = 0.001f;
+			t.yWidth = 0.001f;
+			tgm->addTouch(Event::Down, t);
+		}
+
+		if(isEnabled(name))
+		{
+			bench(name, [&](uint64 i) 
+			{
+				Touch t = touches[i % numTouches];
+				t.xPos += (i & 1) ? 0.0005f : -0.0005f;
+				tgm->addTouch(Event::Move, t);
+			});
+		}
+
+		if(isEnabled(frameName))
+		{
+			std::vector<Event::Type> types(numTouches, Event::Move);
+			std::vector<Touch> frame(touches);
+			bench(frameName, [&](uint64 i) 
+			{
+				float dx = (i & 1) ? 0.0005f : -0.0005f;
+				for(int j = 0; j < numTouches; j++) frame[j].xPos = touches[j].xPos + dx;
+				tgm->addTouches(types.data(), frame.data(), numTouches);
+			});
+		}
+
+		if(isEnabled(pollName))
+		{
+			// Freeze time so touches and groups do not expire while polling.
+			IClock* clock = ogetclock();
+			VirtualClock frozen;
+			frozen.setTime(oclocktime());
+			osetclock(&frozen);
+			for(int j = 0; j < numTouches; j++) tgm->addTouch(Event::Move, touches[j]);
+			bench(pollName, [&](uint64 i) 
+			{
+				tgm->poll();
+			});
+			osetclock(clock);
+		}
+
+		ologenable();
+
+		delete tgm;
+		sm->dispose();
+		delete sm;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void benchRayPointMappers(Config* cfg)
+{
+	// Rays from a head position towards random points in front of the viewer.
+	std::vector<Ray> rays(1024);
+	uint seed = 1;
+	for(size_t i = 0; i < rays.size(); i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		float x = ((seed >> 8) & 0xffff) / 65535.0f * 2.0f - 1.0f;
+		seed = seed * 1103515245 + 12345;
+		float y = ((seed >> 8) & 0xffff) / 65535.0f - 0.5f;
+		Vector3f dir(x, y, -1.0f);
+		dir.normalize();
+		rays[i] = Ray(Vector3f(0.0f, 1.5f, 0.0f), dir);
+	}
+
+	const char* mappers[] = { "rectangular", "cylindrical" };
+	for(int m = 0; m < 2; m++)
+	{
+		String name = ostr("RayPointMapper::getPointFromRay (%1%)", %mappers[m]);
+		if(!isEnabled(name)) continue;
+
+		Ref<RayPointMapper> rpm = RayPointMapper::create(cfg->lookup(ostr("config/%1%Mapper", %mappers[m])));
+		bench(name, [&](uint64 i) 
+		{
+			Vector2f pt = rpm->getPointFromRay(rays[i & 1023]);
+			sSink += (uint64)(pt.x() * 1000);
+		});
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void benchStringUtils()
+{
+	String list = "MocapService,TouchService,PQService,KeyboardService,MouseService,ThinkGearService";
+	bench("StringUtils::split (6 items, ',')", [&](uint64) 
+	{
+		Vector<String> items = StringUtils::split(list, ",");
+		sSink += items.size();
+	});
+
+	String line = "touchTimeout 150\ttouchGroupTimeout 250\nidleTimeout 1600";
+	bench("StringUtils::split (6 items, default delimiters)", [&](uint64) 
+	{
+		Vector<String> items = StringUtils::split(line);
+		sSink += items.size();
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void writeCsv(const String& filename)
+{
+	std::ofstream f(filename.c_str());
+	f << "name,ops,ns_per_op,allocs_per_op\n";
+	foreach(const BenchResult& r, sResults)
+	{
+		f << "\"" << r.name << "\"," << r.ops << "," << r.nsPerOp << "," << r.allocsPerOp << "\n";
+	}
+	ofmsg("omicron_bench: results written to %1%", %filename);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	std::string filter;
+	std::string csvFile;
+
+	libconfig::ArgumentHelper ah;
+	ah.setName("omicron_bench");
+	ah.setDescription("Microbenchmarks for the omicron core hot paths");
+	ah.newNamedDouble('t', "time", "seconds", "Minimum run time of each benchmark (default 0.25)", sMinTime);
+	ah.newNamedString('f', "filter", "text", "Only run benchmarks whose name contains this text", filter);
+	ah.newNamedString('o', "csv", "file", "Write results to a CSV file", csvFile);
+	if(!ah.process(argc, argv)) return 1;
+	sFilter = filter;
+
+	Config* cfg = new Config(
+		"@config: {"
+		"	touchGestureManager: { touchGroupInitialSize = 0.005; touchGroupLongRangeDiameter = 0.01; gestureThread = false; };"
+		"	rectangularMapper: { type = \"rectangular\"; "
+		"		topLeft = [-2.0, 2.5, -2.0]; bottomLeft = [-2.0, 0.5, -2.0]; "
+		"		topRight = [2.0, 2.5, -2.0]; bottomRight = [2.0, 0.5, -2.0]; };"
+		"	cylindricalMapper: { type = \"cylindrical\"; radius = 3.0; minY = 0.3; maxY = 2.6; };"
+		"};");
+	cfg->load();
+
+	printf("%-56s %12s %12s %12s\n", "benchmark", "ops", "ns/op", "allocs/op");
+	benchEventSerialization();
+	benchPackets();
+	benchServiceManager();
+	benchTouchGestures(cfg);
+	benchRayPointMappers(cfg);
+	benchStringUtils();
+
+	if(!csvFile.empty()) writeCsv(csvFile);
+
+	delete cfg;
+	return 0;
+}
@@ -0,0 +1,421 @@
+/**************************************************************************************************
+* THE OMICRON PROJECT
+ *-------------------------------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, University of Illinois at Chicago
+ * Authors:										
+ *  Alessandro Febretti		febret@gmail.com
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *-------------------------------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory, University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted 
+ * provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this list of conditions 
+ * and the following disclaimer. Redistributions in binary form must reproduce the above copyright 
+ * notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR 
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND 
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR SERVICES; LOSS OF 
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *************************************************************************************************/
+// touchtrace: replays recorded touch traces through the TouchGestureManager in virtual time.
+// The gesture events emitted for a trace can be written to a golden file, or compared against
+// one to catch changes in gesture recognition. The processing time of each trace frame is
+// measured too, and a synthetic mode measures it at 1, 10, 100 and 1000 simultaneous touches.
+//
+// Traces are recorded by PQService (see the touchTraceFile option) as CSV, one touch per line:
+//     time,type,id,x,y,w,h
+// time is in milliseconds, type is down, move or up and positions and sizes are normalized.
+// Lines sharing the same time form one touch frame. Files ending in .bin are read as binary
+// traces, made of 28 byte little endian records:
+//     uint32 time, uint8 type (0 = down, 1 = move, 2 = up), 3 padding bytes, int32 id,
+//     float x, float y, float w, float h
+//
+// gestures.csv is a short trace with a drag, a tap and two simultaneous drags. The
+// touchtrace_golden test replays it and compares the result with gestures-golden.csv.
+#include <omicron.h>
+#include "omicron/TouchGestureManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace omicron;
+
+///////////////////////////////////////////////////////////////////////////////
+struct TraceRow
+{
+	uint time;
+	Event::Type type;
+	Touch touch;
+};
+
+// Trace times are offset by this amount, so the virtual clock never starts at zero.
+static const uint64 sTimeOrigin = 1000000;
+// After the last frame the trace keeps being polled for this long, so pending
+// touch groups time out and emit their final events.
+static const uint sFlushTime = 2000;
+static const uint sFlushStep = 10;
+
+///////////////////////////////////////////////////////////////////////////////
+static double nowSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static bool parseType(const char* name, Event::Type* type)
+{
+	if(!strcmp(name, "down")) *type = Event::Down;
+	else if(!strcmp(name, "move")) *type = Event::Move;
+	else if(!strcmp(name, "up")) *type = Event::Up;
+	else return false;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void initTouch(Touch& t, int id, float x, float y, float w, float h)
+{
+	t.ID = id;
+	t.xPos = x;
+	t.yPos = y;
+	t.xWidth = w;
+	t.yWidth = h;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static bool loadCsvTrace(const String& filename, std::vector<TraceRow>& rows)
+{
+	std::ifstream f(filename.c_str());
+	if(!f.is_open())
+	{
+		ofwarn("touchtrace: could not open %1%", %filename);
+		return false;
+	}
+
+	std::string line;
+	int lineNum = 0;
+	while(std::getline(f, line))
+	{
+		lineNum++;
+		if(line.empty() || line[0] == '#' || line.compare(0, 4, "time") == 0) continue;
+
+		TraceRow row;
+		char typeName[16];
+		int id;
+		float x, y, w, h;
+		if(sscanf(line.c_str(), "%u,%15[^,],%d,%f,%f,%f,%f", &row.time, typeName, &id, &x, &y, &w, &h) != 7 ||
+			!parseType(typeName, &row.type))
+		{
+			ofwarn("touchtrace: %1%:%2%: malformed trace line", %filename %lineNum);
+			return false;
+		}
+		initTouch(row.touch, id, x, y, w, h);
+		row.touch.timestamp = row.time;
+		rows.push_back(row);
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static bool loadBinaryTrace(const String& filename, std::vector<TraceRow>& rows)
+{
+	FILE* f = fopen(filename.c_str(), "rb");
+	if(f == NULL)
+	{
+		ofwarn("touchtrace: could not open %1%", %filename);
+		return false;
+	}
+
+	static const Event::Type types[] = { Event::Down, Event::Move, Event::Up };
+	byte record[28];
+	while(fread(record, sizeof(record), 1, f) == 1)
+	{
+		TraceRow row;
+		int id;
+		float v[4];
+		memcpy(&row.time, record, 4);
+		memcpy(&id, record + 8, 4);
+		memcpy(v, record + 12, 16);
+		if(record[4] > 2)
+		{
+			ofwarn("touchtrace: %1%: bad touch type %2% in record %3%", %filename %(int)record[4] %rows.size());
+			fclose(f);
+			return false;
+		}
+		row.type = types[record[4]];
+		initTouch(row.touch, id, v[0], v[1], v[2], v[3]);
+		row.touch.timestamp = row.time;
+		rows.push_back(row);
+	}
+	fclose(f);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Generates a trace of numTouches touches on a grid, each moving along a small
+// circle for numFrames frames at 120Hz.
+static void makeSyntheticTrace(int numTouches, int numFrames, std::vector<TraceRow>& rows)
+{
+	int side = (int)ceil(sqrt((float)numTouches));
+	float radius = 0.2f / side;
+	for(int frame = 0; frame < numFrames; frame++)
+	{
+		float angle = frame * 0.1f;
+		for(int i = 0; i < numTouches; i++)
+		{
+			TraceRow row;
+			row.time = frame * 1000 / 120;
+			row.type = frame == 0 ? Event::Down : (frame == numFrames - 1 ? Event::Up : Event::Move);
+			initTouch(row.touch, i,
+				(0.5f + i % side) / side + radius * cos(angle),
+				(0.5f + i / side) / side + radius * sin(angle),
+				0.001f, 0.001f);
+			row.touch.timestamp = row.time;
+			rows.push_back(row);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void readEvents(ServiceManager* sm, Event* events, std::vector<String>& output)
+{
+	int count = sm->getEvents(events, ServiceManager::MaxEvents);
+	for(int i = 0; i < count; i++)
+	{
+		const Event& e = events[i];
+		const Vector3f& pos = e.getPosition();
+		char line[128];
+		sprintf(line, "%u,%d,%u,%u,%.4f,%.4f",
+			e.getTimestamp() - (uint)(sTimeOrigin / 1000), (int)e.getType(), e.getSourceId(), e.getFlags(), pos[0], pos[1]);
+		output.push_back(line);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Feeds the trace through a new gesture manager one frame at a time, with the
+// virtual clock set to each frame time. Returns the emitted gesture events and
+// the processing time of each frame, in microseconds.
+static void replay(const std::vector<TraceRow>& rows, Setting& s, std::vector<String>& output, std::vector<double>& frameTimes)
+{
+	ServiceManager* sm = new ServiceManager();
+	sm->initialize();
+	Service* svc = new Service();
+	sm->addService(svc);
+
+	IClock* realClock = ogetclock();
+	VirtualClock clock(sTimeOrigin);
+	osetclock(&clock);
+
+	// The gesture manager logs every new touch group.
+	ologdisable();
+
+	TouchGestureManager* tgm = new TouchGestureManager();
+	tgm->setup(s);
+	tgm->registerPQService(svc);
+
+	Event* events = new Event[ServiceManager::MaxEvents];
+	std::vector<Event::Type> types;
+	std::vector<Touch> touches;
+
+	size_t i = 0;
+	while(i < rows.size())
+	{
+		uint time = rows[i].time;
+		types.clear();
+		touches.clear();
+		for(; i < rows.size() && rows[i].time == time; i++)
+		{
+			types.push_back(rows[i].type);
+			touches.push_back(rows[i].touch);
+		}
+		clock.setTime(sTimeOrigin + (uint64)time * 1000);
+
+		double start = nowSeconds();
+		tgm->addTouches(types.data(), touches.data(), (int)touches.size());
+		tgm->poll();
+		frameTimes.push_back((nowSeconds() - start) * 1000000);
+
+		readEvents(sm, events, output);
+	}
+
+	for(uint t = 0; t < sFlushTime; t += sFlushStep)
+	{
+		clock.advance(sFlushStep * 1000);
+		tgm->poll();
+		readEvents(sm, events, output);
+	}
+
+	ologenable();
+	osetclock(realClock);
+
+	delete[] events;
+	delete tgm;
+	sm->dispose();
+	delete sm;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void printFrameTimes(const String& name, std::vector<double>& frameTimes)
+{
+	if(frameTimes.empty()) return;
+	std::sort(frameTimes.begin(), frameTimes.end());
+	double total = 0;
+	foreach(double t, frameTimes) total += t;
+	size_t n = frameTimes.size();
+	printf("%-24s %8d %10.2f %10.2f %10.2f %10.2f\n", name.c_str(), (int)n,
+		total / n, frameTimes[n / 2], frameTimes[std::min(n - 1, n * 99 / 100)], frameTimes[n - 1]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static bool writeGolden(const String& filename, const std::vector<String>& output)
+{
+	std::ofstream f(filename.c_str());
+	if(!f.is_open())
+	{
+		ofwarn("touchtrace: could not write %1%", %filename);
+		return false;
+	}
+	f << "time,type,sourceId,flags,x,y\n";
+	foreach(const String& line, output) f << line << "\n";
+	ofmsg("touchtrace: %1% gesture events written to %2%", %output.size() %filename);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static bool compareGolden(const String& filename, const std::vector<String>& output)
+{
+	std::ifstream f(filename.c_str());
+	if(!f.is_open())
+	{
+		ofwarn("touchtrace: could not open %1%", %filename);
+		return false;
+	}
+
+	std::vector<String> golden;
+	std::string line;
+	while(std::getline(f, line))
+	{
+		if(!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+		if(line.empty() || line.compare(0, 4, "time") == 0) continue;
+		golden.push_back(line);
+	}
+
+	int mismatches = 0;
+	size_t n = std::max(golden.size(), output.size());
+	for(size_t i = 0; i < n; i++)
+	{
+		const char* expected = i < golden.size() ? golden[i].c_str() : "<none>";
+		const char* actual = i < output.size() ? output[i].c_str() : "<none>";
+		if(strcmp(expected, actual))
+		{
+			// Only print the first few mismatches, later ones usually follow from them.
+			if(mismatches < 10) printf("event %d: expected %s, got %s\n", (int)i, expected, actual);
+			mismatches++;
+		}
+	}
+
+	if(mismatches == 0)
+	{
+		printf("touchtrace: %d gesture events match %s\n", (int)output.size(), filename.c_str());
+		return true;
+	}
+	printf("touchtrace: %d of %d gesture events differ from %s\n", mismatches, (int)n, filename.c_str());
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	std::string traceFile;
+	std::string goldenFile;
+	std::string outputFile;
+	std::string configFile;
+	bool synthetic = false;
+	int syntheticFrames = 600;
+
+	libconfig::ArgumentHelper ah;
+	ah.setName("touchtrace");
+	ah.setDescription("Replays touch traces through the touch gesture manager");
+	ah.newOptionalString("trace", "Touch trace file (.csv or .bin)", traceFile);
+	ah.newNamedString('g', "golden", "file", "Compare gesture events with a golden file", goldenFile);
+	ah.newNamedString('o', "output", "file", "Write gesture events to a golden file", outputFile);
+	ah.newNamedString('c', "config", "file", "Config file with a config/touchGestureManager section", configFile);
+	ah.newFlag('s', "synthetic", "Time synthetic traces of 1, 10, 100 and 1000 touches", synthetic);
+	ah.newNamedInt('n', "frames", "count", "Number of frames in synthetic traces (default 600)", syntheticFrames);
+	if(!ah.process(argc, argv)) return 1;
+
+	// Touches are kept in their own groups by default, so synthetic traces
+	// produce one touch group per touch.
+	Config* cfg;
+	if(configFile.empty())
+	{
+		cfg = new Config(
+			"@config: {"
+			"	touchGestureManager: { touchGroupInitialSize = 0.005; touchGroupLongRangeDiameter = 0.01; };"
+			"};");
+	}
+	else
+	{
+		DataManager* dm = DataManager::getInstance();
+		dm->addSource(new FilesystemDataSource(""));
+		dm->addSource(new FilesystemDataSource(OMICRON_DATA_PATH));
+		cfg = new Config(configFile);
+	}
+	if(!cfg->load() || !cfg->exists("config/touchGestureManager"))
+	{
+		ofwarn("touchtrace: no config/touchGestureManager section in %1%", %configFile);
+		delete cfg;
+		return 1;
+	}
+
+	// Touches are processed synchronously, so each frame is timed as a whole.
+	Setting& s = cfg->lookup("config/touchGestureManager");
+	if(s.exists("gestureThread")) s["gestureThread"] = false;
+	else s.add("gestureThread", Setting::TypeBoolean) = false;
+
+	bool ok = true;
+	printf("%-24s %8s %10s %10s %10s %10s\n", "trace", "frames", "mean us", "p50 us", "p99 us", "max us");
+	if(!traceFile.empty())
+	{
+		std::vector<TraceRow> rows;
+		String ext = traceFile.size() > 4 ? traceFile.substr(traceFile.size() - 4) : "";
+		ok = ext == ".bin" ? loadBinaryTrace(traceFile, rows) : loadCsvTrace(traceFile, rows);
+		if(ok)
+		{
+			std::vector<String> output;
+			std::vector<double> frameTimes;
+			replay(rows, s, output, frameTimes);
+			printFrameTimes(traceFile, frameTimes);
+
+			if(!outputFile.empty()) ok = writeGolden(outputFile, output);
+			if(!goldenFile.empty()) ok = compareGolden(goldenFile, output) && ok;
+		}
+	}
+
+	if(synthetic)
+	{
+		int touchCounts[] = { 1, 10, 100, 1000 };
+		for(int c = 0; c < 4; c++)
+		{
+			std::vector<TraceRow> rows;
+			makeSyntheticTrace(touchCounts[c], syntheticFrames, rows);
+			std::vector<String> output;
+			std::vector<double> frameTimes;
+			replay(rows, s, output, frameTimes);
+			printFrameTimes(ostr("synthetic %1% touches", %touchCounts[c]), frameTimes);
+		}
+	}
+
+	delete cfg;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A compiled event predicate, used by the input server to implement
+ *  fine-grained client subscriptions.
+ ******************************************************************************/
+#include "omicron/EventFilter.h"
+#include "omicron/StringUtils.h"
+
+#include <algorithm>
+
+using namespace omicron;
+
+///////////////////////////////////////////////////////////////////////////////
+static int serviceTypeFromName(const String& name)
+{
+	static const char* names[] = {
+		"pointer", "mocap", "keyboard", "controller", "ui", "generic",
+		"brain", "wand", "speech", "image", "audio" };
+	for(int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+	{
+		if(name == names[i]) return i;
+	}
+	return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static int eventTypeFromName(const String& name)
+{
+	static const struct { const char* name; int type; } names[] = {
+		{ "select", Event::Select }, { "toggle", Event::Toggle },
+		{ "changevalue", Event::ChangeValue }, { "update", Event::Update },
+		{ "move", Event::Move }, { "down", Event::Down }, { "up", Event::Up },
+		{ "trace", Event::Trace }, { "connect", Event::Connect },
+		{ "untrace", Event::Untrace }, { "disconnect", Event::Disconnect },
+		{ "click", Event::Click }, { "zoom", Event::Zoom },
+		{ "split", Event::Split }, { "rotate", Event::Rotate },
+		{ "null", Event::Null } };
+	for(int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+	{
+		if(name == names[i].name) return names[i].type;
+	}
+	return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const unsigned int EventFilter::IdSet::BitmaskSize;
+
+///////////////////////////////////////////////////////////////////////////////
+void EventFilter::IdSet::clear()
+{
+	all = true;
+	memset(bits, 0, sizeof(bits));
+	ranges.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventFilter::IdSet::add(unsigned int first, unsigned int last)
+{
+	all = false;
+	if(first > last) std::swap(first, last);
+	for(unsigned int v = first; v <= last && v < BitmaskSize; v++)
+	{
+		bits[v >> 5] |= (1u << (v & 31));
+	}
+	if(last >= BitmaskSize)
+	{
+		ranges.push_back(std::make_pair(first < BitmaskSize ? BitmaskSize : first, last));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventFilter::IdSet::compile()
+{
+	// Sort and merge overlapping or adjacent ranges, so lookups can use a
+	// binary search.
+	if(ranges.size() < 2) return;
+	std::sort(ranges.begin(), ranges.end());
+	size_t last = 0;
+	for(size_t i = 1; i < ranges.size(); i++)
+	{
+		if(ranges[i].first <= ranges[last].second + 1)
+		{
+			ranges[last].second = std::max(ranges[last].second, ranges[i].second);
+		}
+		else
+		{
+			ranges[++last] = ranges[i];
+		}
+	}
+	ranges.resize(last + 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+EventFilter::EventFilter()
+{
+	clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventFilter::clear()
+{
+	mySubscription = "";
+	myServiceMask = 0xffffffff;
+	myTypes.clear();
+	mySources.clear();
+	myUsers.clear();
+	myHasRegion = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventFilter::parseIdSet(const String& values, IdSet& set, int (*nameToId)(const String&))
+{
+	Vector<String> items = StringUtils::split(values, ",");
+	foreach(String item, items)
+	{
+		StringUtils::trim(item);
+		if(item.empty()) continue;
+
+		// Symbolic name
+		if(nameToId != NULL && !isdigit(item[0]))
+		{
+			StringUtils::toLowerCase(item);
+			int id = nameToId(item);
+			if(id < 0)
+			{
+				ofwarn("EventFilter: unknown name '%1%'", %item);
+				return false;
+			}
+			set.add(id, id);
+			continue;
+		}
+
+		// Number or range
+		char* end;
+		unsigned long first = strtoul(item.c_str(), &end, 10);
+		unsigned long last = first;
+		if(*end == '-')
+		{
+			last = strtoul(end + 1, &end, 10);
+		}
+		if(*end != '\0')
+		{
+			ofwarn("EventFilter: invalid value '%1%'", %item);
+			return false;
+		}
+		set.add((unsigned int)first, (unsigned int)last);
+	}
+	set.compile();
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventFilter::parse(const String& subscription)
+{
+	clear();
+
+	bool ok = true;
+	Vector<String> clauses = StringUtils::split(subscription, ";");
+	foreach(String clause, clauses)
+	{
+		StringUtils::trim(clause);
+		if(clause.empty()) continue;
+
+		size_t eq = clause.find('=');
+		if(eq == String::npos)
+		{
+			ofwarn("EventFilter: invalid clause '%1%'", %clause);
+			ok = false;
+			break;
+		}
+		String key = clause.substr(0, eq);
+		String values = clause.substr(eq + 1);
+		StringUtils::trim(key);
+		StringUtils::toLowerCase(key);
+
+		if(key == "service")
+		{
+			IdSet services;
+			services.clear();
+			ok = parseIdSet(values, services, serviceTypeFromName);
+			if(!ok) break;
+			myServiceMask = 0;
+			for(uint i = 0; i < 32; i++) if(services.contains(i)) myServiceMask |= (1u << i);
+		}
+		else if(key == "source") ok = parseIdSet(values, mySources, NULL);
+		else if(key == "type") ok = parseIdSet(values, myTypes, eventTypeFromName);
+		else if(key == "user") ok = parseIdSet(values, myUsers, NULL);
+		else if(key == "region")
+		{
+			Vector<String> coords = StringUtils::split(values, ",");
+			if(coords.size() != 6)
+			{
+				ofwarn("EventFilter: region needs 6 values, got '%1%'", %values);
+				ok = false;
+				break;
+			}
+			float v[6];
+			for(int i = 0; i < 6; i++) v[i] = (float)atof(coords[i].c_str());
+			myRegionMin = Vector3f(std::min(v[0], v[3]), std::min(v[1], v[4]), std::min(v[2], v[5]));
+			myRegionMax = Vector3f(std::max(v[0], v[3]), std::max(v[1], v[4]), std::max(v[2], v[5]));
+			myHasRegion = true;
+		}
+		else
+		{
+			ofwarn("EventFilter: unknown key '%1%'", %key);
+			ok = false;
+		}
+		if(!ok) break;
+	}
+
+	if(!ok)
+	{
+		clear();
+		return false;
+	}
+	mySubscription = subscription;
+	return true;
+}
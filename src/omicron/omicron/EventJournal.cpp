@@ -0,0 +1,1043 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A binary, append-only event journal. Events are stored as compact 
+ *  records packed in compressed blocks, followed by a block index.
+ ******************************************************************************/
+#include "omicron/EventJournal.h"
+#include "omicron/StringUtils.h"
+#include "omicron/Trace.h"
+
+#include <time.h>
+#include <algorithm>
+
+#ifdef OMICRON_OS_WIN
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+using namespace omicron;
+
+// Queue entries: a 4-byte length, 4 bytes of padding, then the record.
+static const uint QueueEntryHeaderSize = 8;
+// Length value marking the rest of the queue buffer as unused: the next
+// entry starts at the beginning of the buffer.
+static const uint QueueWrapMarker = 0xffffffff;
+static const uint MaxRecordSize = sizeof(EventJournal::Record) + 0xffff;
+
+// Compressor parameters. See EventJournal::compress.
+static const int LzMinMatch = 4;
+static const int LzHashBits = 12;
+static const int LzMaxOffset = 0xffff;
+// The last bytes of the input are always emitted as literals, so the match
+// finder can read 4 bytes at a time without going past the end.
+static const int LzLastLiterals = 5;
+
+///////////////////////////////////////////////////////////////////////////////
+static inline uint alignEntry(uint size)
+{
+	return (size + 7) & ~7u;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Maps a whole file in memory, read only. Returns NULL if the file can't be 
+// opened or is empty.
+static const char* mapFile(const String& filename, uint64* size)
+{
+	const char* data = NULL;
+#ifdef OMICRON_OS_WIN
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) return NULL;
+	LARGE_INTEGER fileSize;
+	if(GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(mapping != NULL)
+		{
+			// The view keeps the mapping alive after its handle is closed.
+			data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+		*size = (uint64)fileSize.QuadPart;
+	}
+	CloseHandle(file);
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if(fd < 0) return NULL;
+	struct stat st;
+	if(fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void* mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(mapping != MAP_FAILED) data = (const char*)mapping;
+		*size = (uint64)st.st_size;
+	}
+	// The mapping stays valid after the descriptor is closed.
+	::close(fd);
+#endif
+	return data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void unmapFile(const char* data, uint64 size)
+{
+#ifdef OMICRON_OS_WIN
+	UnmapViewOfFile(data);
+#else
+	munmap((void*)data, (size_t)size);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+typedef Dictionary<uint64, EventJournal::SourceSummary> SummaryMap;
+
+///////////////////////////////////////////////////////////////////////////////
+static void updateSummary(SummaryMap& summaries, const EventJournal::Record& record, uint block)
+{
+	uint64 key = ((uint64)record.serviceType << 32) | record.sourceId;
+	SummaryMap::iterator it = summaries.find(key);
+	if(it == summaries.end())
+	{
+		EventJournal::SourceSummary summary;
+		summary.sourceId = record.sourceId;
+		summary.serviceType = record.serviceType;
+		summary.eventCount = 0;
+		summary.firstTime = record.time;
+		summary.firstBlock = block;
+		it = summaries.insert(std::make_pair(key, summary)).first;
+	}
+	EventJournal::SourceSummary& summary = it->second;
+	summary.eventCount++;
+	summary.lastTime = record.time;
+	summary.lastBlock = block;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static bool summaryLess(const EventJournal::SourceSummary& a, const EventJournal::SourceSummary& b)
+{
+	if(a.serviceType != b.serviceType) return a.serviceType < b.serviceType;
+	return a.sourceId < b.sourceId;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void getSortedSummaries(const SummaryMap& summaries, Vector<EventJournal::SourceSummary>* sorted)
+{
+	sorted->clear();
+	for(SummaryMap::const_iterator it = summaries.begin(); it != summaries.end(); ++it)
+	{
+		sorted->push_back(it->second);
+	}
+	std::sort(sorted->begin(), sorted->end(), summaryLess);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventJournal::writeRecord(const Event& evt, uint64 time, Record* r)
+{
+	r->time = time;
+	r->timestamp = evt.getTimestamp();
+	r->sourceId = evt.getSourceId();
+	r->deviceTag = evt.getDeviceTag();
+	r->flags = evt.getFlags();
+	r->type = (unsigned short)evt.getType();
+	r->serviceType = (unsigned char)evt.getServiceType();
+	r->extraDataType = (unsigned char)evt.getExtraDataType();
+	r->extraDataItems = (unsigned short)evt.getExtraDataItems();
+	r->extraDataSize = (unsigned short)evt.getExtraDataSize();
+	r->extraDataMask = evt.getExtraDataMask();
+	const Vector3f& pos = evt.getPosition();
+	r->position[0] = pos[0];
+	r->position[1] = pos[1];
+	r->position[2] = pos[2];
+	const Quaternion& o = evt.getOrientation();
+	r->orientation[0] = o.w();
+	r->orientation[1] = o.x();
+	r->orientation[2] = o.y();
+	r->orientation[3] = o.z();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventJournal::readRecord(const Record& r, const void* extraData, Event* evt)
+{
+	evt->reset((Event::Type)r.type,
+		(Service::ServiceType)r.serviceType,
+		r.sourceId,
+		(r.deviceTag & EventBase::DTServiceIdMask) >> EventBase::DTServiceIdOffset,
+		(r.deviceTag & EventBase::DTUserIdMask) >> EventBase::DTUserIdOffset);
+	evt->setPosition(r.position[0], r.position[1], r.position[2]);
+	evt->setOrientation(r.orientation[0], r.orientation[1], r.orientation[2], r.orientation[3]);
+	evt->setFlags(r.flags);
+	if(r.extraDataType != Event::ExtraDataNull)
+	{
+		evt->setExtraData((Event::ExtraDataType)r.extraDataType, r.extraDataItems, r.extraDataMask, (void*)extraData);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int EventJournal::getMaxCompressedSize(int rawSize)
+{
+	return rawSize + rawSize / 255 + 16;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static inline uint lzHash(const unsigned char* p)
+{
+	uint v;
+	memcpy(&v, p, 4);
+	return (v * 2654435761u) >> (32 - LzHashBits);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Writes a length continuation (the part exceeding 15) as a run of 255s 
+// followed by the remainder.
+static inline unsigned char* lzWriteLength(unsigned char* op, int len)
+{
+	while(len >= 255)
+	{
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (unsigned char)len;
+	return op;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Each sequence is a token (literal length in the high nibble, match length
+// minus 4 in the low nibble), the literal length continuation, the literals,
+// a 2-byte match offset and the match length continuation. The last sequence
+// only has literals.
+int EventJournal::compress(const char* source, int srcSize, char* dest, int dstCapacity)
+{
+	const unsigned char* src = (const unsigned char*)source;
+	unsigned char* dst = (unsigned char*)dest;
+	unsigned char* op = dst;
+	unsigned char* opEnd = dst + dstCapacity;
+
+	int table[1 << LzHashBits];
+	for(int i = 0; i < (1 << LzHashBits); i++) table[i] = -1;
+
+	int ip = 0;
+	int anchor = 0;
+	int matchLimit = srcSize - LzLastLiterals;
+	int searchLimit = matchLimit - LzMinMatch;
+
+	while(ip < searchLimit)
+	{
+		uint h = lzHash(src + ip);
+		int ref = table[h];
+		table[h] = ip;
+
+		if(ref < 0 || ip - ref > LzMaxOffset || memcmp(src + ref, src + ip, LzMinMatch) != 0)
+		{
+			// Skip faster over data that does not compress.
+			ip += 1 + ((ip - anchor) >> 6);
+			continue;
+		}
+
+		int matchLen = LzMinMatch;
+		while(ip + matchLen < matchLimit && src[ref + matchLen] == src[ip + matchLen]) matchLen++;
+
+		int litLen = ip - anchor;
+		// Token, continuations, literals and offset.
+		if(op + 1 + litLen / 255 + 1 + litLen + 2 + matchLen / 255 + 1 > opEnd) return 0;
+
+		unsigned char* token = op++;
+		int ml = matchLen - LzMinMatch;
+		*token = (unsigned char)(((litLen < 15 ? litLen : 15) << 4) | (ml < 15 ? ml : 15));
+		if(litLen >= 15) op = lzWriteLength(op, litLen - 15);
+		memcpy(op, src + anchor, litLen);
+		op += litLen;
+		int offset = ip - ref;
+		*op++ = (unsigned char)(offset & 0xff);
+		*op++ = (unsigned char)(offset >> 8);
+		if(ml >= 15) op = lzWriteLength(op, ml - 15);
+
+		ip += matchLen;
+		anchor = ip;
+	}
+
+	// Last literals
+	int litLen = srcSize - anchor;
+	if(op + 1 + litLen / 255 + 1 + litLen > opEnd) return 0;
+	*op++ = (unsigned char)((litLen < 15 ? litLen : 15) << 4);
+	if(litLen >= 15) op = lzWriteLength(op, litLen - 15);
+	memcpy(op, src + anchor, litLen);
+	op += litLen;
+
+	return (int)(op - dst);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournal::decompress(const char* source, int srcSize, char* dest, int rawSize)
+{
+	const unsigned char* ip = (const unsigned char*)source;
+	const unsigned char* ipEnd = ip + srcSize;
+	unsigned char* dst = (unsigned char*)dest;
+	unsigned char* op = dst;
+	unsigned char* opEnd = dst + rawSize;
+
+	while(ip < ipEnd)
+	{
+		uint token = *ip++;
+
+		int litLen = token >> 4;
+		if(litLen == 15)
+		{
+			uint b;
+			do
+			{
+				if(ip >= ipEnd) return false;
+				b = *ip++;
+				litLen += b;
+			} while(b == 255);
+		}
+		if(litLen > ipEnd - ip || litLen > opEnd - op) return false;
+		memcpy(op, ip, litLen);
+		ip += litLen;
+		op += litLen;
+
+		// The last sequence has no match.
+		if(ip == ipEnd) break;
+
+		if(ipEnd - ip < 2) return false;
+		int offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if(offset == 0 || offset > op - dst) return false;
+
+		int matchLen = token & 15;
+		if(matchLen == 15)
+		{
+			uint b;
+			do
+			{
+				if(ip >= ipEnd) return false;
+				b = *ip++;
+				matchLen += b;
+			} while(b == 255);
+		}
+		matchLen += LzMinMatch;
+		if(matchLen > opEnd - op) return false;
+
+		// Matches can overlap their own output, so copy byte by byte.
+		const unsigned char* ref = op - offset;
+		for(int i = 0; i < matchLen; i++) op[i] = ref[i];
+		op += matchLen;
+	}
+
+	return op == opEnd;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+EventJournalWriter::EventJournalWriter():
+	myFile(NULL),
+	myRunning(false),
+	myQueue(NULL),
+	myQueueSize(0),
+	myHead(0),
+	myTail(0),
+	myBlock(NULL),
+	myCompressedBlock(NULL),
+	myBlockSize(0),
+	myBlockCapacity(0),
+	myBlockUsed(0),
+	myBlockServiceTypes(0),
+	myFileOffset(0),
+	myWrittenEvents(0),
+	myDroppedEvents(0),
+	myWrittenBlocks(0),
+	myBytesWritten(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+EventJournalWriter::~EventJournalWriter()
+{
+	close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalWriter::open(const String& filename, uint queueSize, uint blockSize)
+{
+	if(!openFile(filename, blockSize, (uint64)time(NULL))) return false;
+
+	// The queue must hold at least a few records of the largest size.
+	myQueueSize = alignEntry(queueSize);
+	if(myQueueSize < 4 * MaxRecordSize) myQueueSize = alignEntry(4 * MaxRecordSize);
+	myQueue = new char[myQueueSize];
+
+	myTimer.start();
+	myRunning = true;
+	start();
+
+	ofmsg("EventJournalWriter: journaling events to %1%", %filename);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalWriter::create(const String& filename, uint blockSize, uint64 creationTime)
+{
+	if(creationTime == 0) creationTime = (uint64)time(NULL);
+	return openFile(filename, blockSize, creationTime);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalWriter::openFile(const String& filename, uint blockSize, uint64 creationTime)
+{
+	close();
+
+	myFile = fopen(filename.c_str(), "wb");
+	if(myFile == NULL)
+	{
+		ofwarn("EventJournalWriter: could not open %1% for writing", %filename);
+		return false;
+	}
+	myFilename = filename;
+
+	EventJournal::FileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = EventJournal::FileMagic;
+	header.version = EventJournal::Version;
+	header.blockSize = blockSize;
+	header.creationTime = creationTime;
+	fwrite(&header, sizeof(header), 1, myFile);
+	myFileOffset = sizeof(header);
+
+	myQueueSize = 0;
+	myHead = 0;
+	myTail = 0;
+
+	// A block is flushed as soon as it reaches blockSize, so it never grows
+	// beyond blockSize plus one record.
+	myBlockSize = blockSize;
+	myBlockCapacity = blockSize + MaxRecordSize;
+	myBlock = new char[myBlockCapacity];
+	myCompressedBlock = new char[EventJournal::getMaxCompressedSize(myBlockCapacity)];
+	myBlockUsed = 0;
+	myIndex.clear();
+	mySummaries.clear();
+
+	myWrittenEvents = 0;
+	myDroppedEvents = 0;
+	myWrittenBlocks = 0;
+	myBytesWritten = sizeof(header);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventJournalWriter::close()
+{
+	if(myFile == NULL) return;
+
+	// Stop the writer thread, then write whatever it left in the queue.
+	myRunning = false;
+	stop();
+	drainQueue();
+	flushBlock();
+	writeIndex();
+
+	fclose(myFile);
+	myFile = NULL;
+
+	ofmsg("EventJournalWriter: closed %1%: %2% events, %3% blocks, %4% bytes, %5% dropped", 
+		%myFilename %getWrittenEvents() %getWrittenBlocks() %getBytesWritten() %getDroppedEvents());
+
+	delete[] myQueue;
+	delete[] myBlock;
+	delete[] myCompressedBlock;
+	myQueue = NULL;
+	myBlock = NULL;
+	myCompressedBlock = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalWriter::write(const Event& evt)
+{
+	if(myQueue == NULL) return false;
+
+	uint recordSize = sizeof(EventJournal::Record) + evt.getExtraDataSize();
+	uint entrySize = alignEntry(QueueEntryHeaderSize + recordSize);
+
+	uint64 head = myHead.load(std::memory_order_relaxed);
+	uint64 tail = myTail.load(std::memory_order_acquire);
+	uint offset = (uint)(head % myQueueSize);
+	uint spaceToEnd = myQueueSize - offset;
+
+	// Entries are never split: if this one does not fit before the end of
+	// the buffer, skip to the beginning.
+	uint64 required = entrySize;
+	if(spaceToEnd < entrySize) required += spaceToEnd;
+	if(myQueueSize - (head - tail) < required)
+	{
+		myDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	if(spaceToEnd < entrySize)
+	{
+		memcpy(myQueue + offset, &QueueWrapMarker, sizeof(uint));
+		head += spaceToEnd;
+		offset = 0;
+	}
+
+	char* entry = myQueue + offset;
+	memcpy(entry, &recordSize, sizeof(uint));
+	EventJournal::Record* record = (EventJournal::Record*)(entry + QueueEntryHeaderSize);
+	EventJournal::writeRecord(evt, (uint64)myTimer.getElapsedTimeInMicroSec(), record);
+	memcpy(record + 1, evt.getExtraDataBuffer(), record->extraDataSize);
+
+	myHead.store(head + entrySize, std::memory_order_release);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventJournalWriter::threadProc()
+{
+	Tracer::setThreadName("EventJournalWriter");
+	Timer flushTimer;
+	flushTimer.start();
+	while(myRunning)
+	{
+		if(drainQueue() == 0)
+		{
+			// Make sure a slow event stream still gets to disk regularly.
+			if(myBlockUsed > 0 && flushTimer.getElapsedTimeInMilliSec() >= FlushIntervalMs)
+			{
+				flushBlock();
+				fflush(myFile);
+			}
+			osleep(2);
+		}
+		if(myBlockUsed == 0) flushTimer.start();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int EventJournalWriter::drainQueue()
+{
+	int count = 0;
+	uint64 tail = myTail.load(std::memory_order_relaxed);
+	uint64 head = myHead.load(std::memory_order_acquire);
+	while(tail != head)
+	{
+		uint offset = (uint)(tail % myQueueSize);
+		uint recordSize;
+		memcpy(&recordSize, myQueue + offset, sizeof(uint));
+		if(recordSize == QueueWrapMarker)
+		{
+			tail += myQueueSize - offset;
+			continue;
+		}
+
+		const EventJournal::Record* record = (const EventJournal::Record*)(myQueue + offset + QueueEntryHeaderSize);
+		addRecord(*record, (const char*)(record + 1));
+
+		tail += alignEntry(QueueEntryHeaderSize + recordSize);
+		// Release the space right away, so the producer can reuse it.
+		myTail.store(tail, std::memory_order_release);
+		count++;
+	}
+	myWrittenEvents.fetch_add(count, std::memory_order_relaxed);
+	return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventJournalWriter::addRecord(const EventJournal::Record& record, const char* extraData)
+{
+	if(myBlockUsed == 0)
+	{
+		myBlockHeader.firstTime = record.time;
+		myBlockHeader.recordCount = 0;
+		myBlockServiceTypes = 0;
+	}
+	myBlockHeader.lastTime = record.time;
+	myBlockHeader.recordCount++;
+	myBlockServiceTypes |= EventJournal::getServiceTypeMask(record.serviceType);
+	updateSummary(mySummaries, record, (uint)myIndex.size());
+
+	memcpy(myBlock + myBlockUsed, &record, sizeof(record));
+	memcpy(myBlock + myBlockUsed + sizeof(record), extraData, record.extraDataSize);
+	myBlockUsed += sizeof(record) + record.extraDataSize;
+
+	if(myBlockUsed >= myBlockSize) flushBlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalWriter::copyRecord(const EventJournal::Record& record, const char* extraData)
+{
+	if(myFile == NULL || myQueue != NULL) return false;
+	addRecord(record, extraData);
+	myWrittenEvents.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalWriter::copyBlock(const EventJournal::IndexEntry& block, const char* payload, const char* data)
+{
+	if(myFile == NULL || myQueue != NULL) return false;
+
+	// Keep records in time order: write the partially filled block first.
+	flushBlock();
+
+	uint index = (uint)myIndex.size();
+	uint serviceTypes = 0;
+	uint position = 0;
+	EventJournal::Record record;
+	while(position + sizeof(record) <= block.rawSize)
+	{
+		memcpy(&record, data + position, sizeof(record));
+		serviceTypes |= EventJournal::getServiceTypeMask(record.serviceType);
+		updateSummary(mySummaries, record, index);
+		position += sizeof(record) + record.extraDataSize;
+	}
+
+	EventJournal::BlockHeader header;
+	header.magic = EventJournal::BlockMagic;
+	header.compressedSize = block.compressedSize;
+	header.rawSize = block.rawSize;
+	header.recordCount = block.recordCount;
+	header.firstTime = block.firstTime;
+	header.lastTime = block.lastTime;
+	writeBlock(header, payload, serviceTypes);
+
+	myWrittenEvents.fetch_add(block.recordCount, std::memory_order_relaxed);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventJournalWriter::flushBlock()
+{
+	if(myBlockUsed == 0) return;
+
+	myBlockHeader.magic = EventJournal::BlockMagic;
+	myBlockHeader.rawSize = myBlockUsed;
+
+	int capacity = EventJournal::getMaxCompressedSize(myBlockCapacity);
+	int compressedSize = EventJournal::compress(myBlock, myBlockUsed, myCompressedBlock, capacity);
+	const char* payload = myCompressedBlock;
+	if(compressedSize == 0 || compressedSize >= (int)myBlockUsed)
+	{
+		// Not worth it: store the block uncompressed.
+		compressedSize = myBlockUsed;
+		payload = myBlock;
+	}
+	myBlockHeader.compressedSize = compressedSize;
+
+	writeBlock(myBlockHeader, payload, myBlockServiceTypes);
+	myBlockUsed = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventJournalWriter::writeBlock(const EventJournal::BlockHeader& header, const char* payload, uint serviceTypes)
+{
+	EventJournal::IndexEntry entry;
+	entry.offset = myFileOffset;
+	entry.compressedSize = header.compressedSize;
+	entry.rawSize = header.rawSize;
+	entry.recordCount = header.recordCount;
+	entry.serviceTypes = serviceTypes;
+	entry.firstTime = header.firstTime;
+	entry.lastTime = header.lastTime;
+	myIndex.push_back(entry);
+
+	fwrite(&header, sizeof(header), 1, myFile);
+	fwrite(payload, header.compressedSize, 1, myFile);
+
+	uint64 written = sizeof(header) + header.compressedSize;
+	myFileOffset += written;
+	myBytesWritten.fetch_add(written, std::memory_order_relaxed);
+	myWrittenBlocks.fetch_add(1, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventJournalWriter::writeIndex()
+{
+	EventJournal::Trailer trailer;
+	trailer.indexOffset = myFileOffset;
+	trailer.blockCount = (uint)myIndex.size();
+	trailer.magic = EventJournal::IndexMagic;
+
+	if(!myIndex.empty())
+	{
+		fwrite(&myIndex[0], sizeof(EventJournal::IndexEntry), myIndex.size(), myFile);
+	}
+
+	Vector<EventJournal::SourceSummary> summaries;
+	getSortedSummaries(mySummaries, &summaries);
+	EventJournal::SummaryHeader summaryHeader;
+	summaryHeader.magic = EventJournal::SummaryMagic;
+	summaryHeader.count = (uint)summaries.size();
+	fwrite(&summaryHeader, sizeof(summaryHeader), 1, myFile);
+	if(!summaries.empty())
+	{
+		fwrite(&summaries[0], sizeof(EventJournal::SourceSummary), summaries.size(), myFile);
+	}
+
+	fwrite(&trailer, sizeof(trailer), 1, myFile);
+
+	uint64 written = sizeof(EventJournal::IndexEntry) * myIndex.size() + 
+		sizeof(summaryHeader) + sizeof(EventJournal::SourceSummary) * summaries.size() + 
+		sizeof(trailer);
+	myFileOffset += written;
+	myBytesWritten.fetch_add(written, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+EventJournalReader::EventJournalReader():
+	myData(NULL),
+	mySize(0),
+	myHasSummaries(false),
+	myRecovered(false),
+	myBlock(NULL),
+	myCurrentBlock(-1),
+	myBlockPosition(0),
+	myBlockSize(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+EventJournalReader::~EventJournalReader()
+{
+	close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalReader::open(const String& filename)
+{
+	close();
+
+	myData = mapFile(filename, &mySize);
+	if(myData == NULL)
+	{
+		ofwarn("EventJournalReader: could not open %1%", %filename);
+		return false;
+	}
+
+	if(mySize < sizeof(myHeader) ||
+		(memcpy(&myHeader, myData, sizeof(myHeader)), myHeader.magic != EventJournal::FileMagic))
+	{
+		ofwarn("EventJournalReader: %1% is not an event journal", %filename);
+		close();
+		return false;
+	}
+	if(myHeader.version > EventJournal::Version)
+	{
+		ofwarn("EventJournalReader: %1% has unsupported version %2%", %filename %myHeader.version);
+		close();
+		return false;
+	}
+
+	// Load the block index and source summaries from the end of the file, 
+	// if they are there.
+	EventJournal::Trailer trailer;
+	bool indexValid = false;
+	if(mySize >= sizeof(myHeader) + sizeof(trailer))
+	{
+		memcpy(&trailer, myData + mySize - sizeof(trailer), sizeof(trailer));
+		uint64 indexSize = (uint64)trailer.blockCount * sizeof(EventJournal::IndexEntry);
+		if(trailer.magic == EventJournal::IndexMagic &&
+			trailer.indexOffset >= sizeof(myHeader) &&
+			trailer.indexOffset + indexSize + sizeof(trailer) <= mySize)
+		{
+			myIndex.resize(trailer.blockCount);
+			if(trailer.blockCount > 0) memcpy(&myIndex[0], myData + trailer.indexOffset, indexSize);
+			if(myHeader.version >= 2) indexValid = loadSummaries(trailer.indexOffset + indexSize);
+			else indexValid = trailer.indexOffset + indexSize + sizeof(trailer) == mySize;
+		}
+	}
+
+	if(!indexValid)
+	{
+		ofwarn("EventJournalReader: %1% has no block index (was it closed properly?). Rebuilding it.", %filename);
+		rebuildIndex();
+		myRecovered = true;
+	}
+
+	// Without summaries the block service types are unknown: assume blocks
+	// hold everything until the summaries get rebuilt.
+	if(!myHasSummaries)
+	{
+		for(int i = 0; i < (int)myIndex.size(); i++) myIndex[i].serviceTypes = EventJournal::AllServiceTypes;
+	}
+
+	rewind();
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalReader::loadSummaries(uint64 offset)
+{
+	EventJournal::SummaryHeader header;
+	if(offset + sizeof(header) + sizeof(EventJournal::Trailer) > mySize) return false;
+	memcpy(&header, myData + offset, sizeof(header));
+	uint64 summariesSize = (uint64)header.count * sizeof(EventJournal::SourceSummary);
+	if(header.magic != EventJournal::SummaryMagic ||
+		offset + sizeof(header) + summariesSize + sizeof(EventJournal::Trailer) != mySize)
+	{
+		return false;
+	}
+
+	mySummaries.resize(header.count);
+	if(header.count > 0) memcpy(&mySummaries[0], myData + offset + sizeof(header), summariesSize);
+	myHasSummaries = true;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventJournalReader::rebuildIndex()
+{
+	myIndex.clear();
+	mySummaries.clear();
+	myHasSummaries = false;
+	uint64 offset = sizeof(EventJournal::FileHeader);
+	EventJournal::BlockHeader bh;
+	while(offset + sizeof(bh) <= mySize)
+	{
+		memcpy(&bh, myData + offset, sizeof(bh));
+		if(bh.magic != EventJournal::BlockMagic || 
+			offset + sizeof(bh) + bh.compressedSize > mySize) break;
+
+		EventJournal::IndexEntry entry;
+		entry.offset = offset;
+		entry.compressedSize = bh.compressedSize;
+		entry.rawSize = bh.rawSize;
+		entry.recordCount = bh.recordCount;
+		entry.serviceTypes = EventJournal::AllServiceTypes;
+		entry.firstTime = bh.firstTime;
+		entry.lastTime = bh.lastTime;
+		myIndex.push_back(entry);
+
+		offset += sizeof(bh) + bh.compressedSize;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventJournalReader::rebuildSummaries()
+{
+	int currentBlock = myCurrentBlock;
+	uint blockPosition = myBlockPosition;
+
+	SummaryMap summaries;
+	EventJournal::Record record;
+	for(int i = 0; i < (int)myIndex.size(); i++)
+	{
+		if(!loadBlock(i)) continue;
+		uint serviceTypes = 0;
+		uint position = 0;
+		while(position + sizeof(record) <= myBlockSize)
+		{
+			memcpy(&record, myBlock + position, sizeof(record));
+			serviceTypes |= EventJournal::getServiceTypeMask(record.serviceType);
+			updateSummary(summaries, record, i);
+			position += sizeof(record) + record.extraDataSize;
+		}
+		myIndex[i].serviceTypes = serviceTypes;
+	}
+	getSortedSummaries(summaries, &mySummaries);
+	myHasSummaries = true;
+
+	// Go back to where we were.
+	if(currentBlock >= 0 && currentBlock < (int)myIndex.size() && loadBlock(currentBlock))
+	{
+		myBlockPosition = blockPosition;
+	}
+	else
+	{
+		seekBlock(currentBlock);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventJournalReader::close()
+{
+	if(myData != NULL)
+	{
+		unmapFile(myData, mySize);
+		myData = NULL;
+	}
+	mySize = 0;
+	myIndex.clear();
+	mySummaries.clear();
+	myHasSummaries = false;
+	myRecovered = false;
+	myBlock = NULL;
+	myCurrentBlock = -1;
+	myBlockPosition = 0;
+	myBlockSize = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const Vector<EventJournal::SourceSummary>& EventJournalReader::getSourceSummaries()
+{
+	if(!myHasSummaries && myData != NULL) rebuildSummaries();
+	return mySummaries;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalReader::blockMayContain(int index, uint serviceTypes, uint sourceId)
+{
+	if(index < 0 || index >= (int)myIndex.size()) return false;
+	if(sourceId == EventJournal::AnySource)
+	{
+		// Block service types are only exact when we have summaries, but 
+		// they are never too narrow.
+		return (myIndex[index].serviceTypes & serviceTypes) != 0;
+	}
+
+	const Vector<EventJournal::SourceSummary>& summaries = getSourceSummaries();
+	if((myIndex[index].serviceTypes & serviceTypes) == 0) return false;
+	for(int i = 0; i < (int)summaries.size(); i++)
+	{
+		const EventJournal::SourceSummary& s = summaries[i];
+		if(s.sourceId == sourceId &&
+			(EventJournal::getServiceTypeMask(s.serviceType) & serviceTypes) != 0 &&
+			(uint)index >= s.firstBlock && (uint)index <= s.lastBlock)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+int EventJournalReader::findBlock(uint64 time)
+{
+	int lo = 0;
+	int hi = (int)myIndex.size();
+	while(lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if(myIndex[mid].lastTime < time) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const char* EventJournalReader::getBlockPayload(int index)
+{
+	if(index < 0 || index >= (int)myIndex.size()) return NULL;
+	const EventJournal::IndexEntry& entry = myIndex[index];
+	uint64 offset = entry.offset + sizeof(EventJournal::BlockHeader);
+	if(offset + entry.compressedSize > mySize) return NULL;
+	return myData + offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalReader::loadBlock(int index)
+{
+	const EventJournal::IndexEntry& entry = myIndex[index];
+	const char* payload = getBlockPayload(index);
+
+	bool ok = payload != NULL;
+	if(ok && entry.compressedSize == entry.rawSize)
+	{
+		// Stored uncompressed: read it straight from the mapping.
+		myBlock = payload;
+	}
+	else if(ok)
+	{
+		myBlockBuffer.resize(entry.rawSize);
+		ok = entry.rawSize > 0 &&
+			EventJournal::decompress(payload, entry.compressedSize, &myBlockBuffer[0], entry.rawSize);
+		myBlock = ok ? &myBlockBuffer[0] : NULL;
+	}
+	if(!ok)
+	{
+		ofwarn("EventJournalReader: block %1% is corrupt", %index);
+		return false;
+	}
+
+	myCurrentBlock = index;
+	myBlockPosition = 0;
+	myBlockSize = entry.rawSize;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalReader::seekBlock(int index)
+{
+	myCurrentBlock = index;
+	myBlockPosition = 0;
+	myBlockSize = 0;
+	if(index < 0 || index >= (int)myIndex.size()) return false;
+	return loadBlock(index);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalReader::seekTime(uint64 time)
+{
+	if(!seekBlock(findBlock(time))) return false;
+
+	// Skip the records that come before it in the block.
+	EventJournal::Record record;
+	while(myBlockPosition + sizeof(record) <= myBlockSize)
+	{
+		memcpy(&record, myBlock + myBlockPosition, sizeof(record));
+		if(record.time >= time) break;
+		myBlockPosition += sizeof(record) + record.extraDataSize;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalReader::next(EventJournal::Record* record, const char** extraData)
+{
+	// Move to the next non-empty block when done with the current one.
+	while(myBlockPosition >= myBlockSize)
+	{
+		if(myData == NULL || myCurrentBlock + 1 >= (int)myIndex.size()) return false;
+		if(!loadBlock(myCurrentBlock + 1)) return false;
+	}
+
+	if(myBlockSize - myBlockPosition < sizeof(EventJournal::Record)) return false;
+	memcpy(record, myBlock + myBlockPosition, sizeof(EventJournal::Record));
+	myBlockPosition += sizeof(EventJournal::Record);
+	if(myBlockSize - myBlockPosition < record->extraDataSize) return false;
+	if(extraData != NULL) *extraData = myBlock + myBlockPosition;
+	myBlockPosition += record->extraDataSize;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool EventJournalReader::next(Event* evt, uint64* time)
+{
+	EventJournal::Record record;
+	const char* extraData;
+	if(!next(&record, &extraData)) return false;
+	EventJournal::readRecord(record, extraData, evt);
+	if(time != NULL) *time = record.time;
+	return true;
+}
@@ -31,10 +31,13 @@ using namespace omicron;
 GestureService* GestureService::mysInstance = NULL;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-GestureService::GestureService()
+GestureService::GestureService():
+	lastEventSequence(0)
 {
 	mysInstance = this;
 	mocapManager = new MocapGestureManager(mysInstance);
+	// Poll after the mocap services, so their events of this frame are read.
+	setPollPriority(Service::PollLast);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -55,19 +58,22 @@ void GestureService::poll()
 	mocapManager->poll();
 	ServiceManager* serviceManager = mysInstance->getManager();
 
-	int av = serviceManager->getAvailableEvents();
-	if(av != 0)
+	// Read the events written since the last poll in place. Gestures generated
+	// while the event buffer is locked are published after unlocking it.
+	serviceManager->lockEvents();
+	EventView events = serviceManager->getEventsSince(lastEventSequence);
+	lastEventSequence = serviceManager->getEventSequence();
+	for( int evtNum = 0; evtNum < events.size(); evtNum++ )
 	{
-		/*
-		// TODO: Instead of copying the event list, we can lock the main one.
-		Event evts[OMICRON_MAX_EVENTS];
-		serviceManager->getEvents(evts, OMICRON_MAX_EVENTS);
-		for( int evtNum = 0; evtNum < av; evtNum++ )
+		const Event& e = events[evtNum];
+		if( e.getServiceType() == Service::Mocap && e.getType() == Event::Update )
 		{
-			mocapManager->processEvent(evts[evtNum]);
+			mocapManager->processEvent(e);
 		}
-		*/
 	}
+	serviceManager->unlockEvents();
+
+	mocapManager->flushGestures();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
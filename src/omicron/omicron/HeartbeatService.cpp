@@ -55,8 +55,8 @@ void HeartbeatService::setup(Setting& settings)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void HeartbeatService::poll() 
 {
-	// Get the current system clock time in seconds.
-	float curt = (float)((double)clock() / CLOCKS_PER_SEC);
+	// Get the current clock time in seconds (see osetclock).
+	float curt = (float)otime();
 
 	float interval = 1.0f / myRate;
 
@@ -37,6 +37,7 @@
 #include "omicron/InputServer.h"
 #include "omicron/StringUtils.h"
 #include "omicron/ServiceManager.h"
+#include "omicron/Trace.h"
 #include <vector>
 
 #include <time.h>
@@ -56,23 +57,21 @@ const char* InputServer::omicronStreamInHandshake = "omicron_data_in";
 const char* InputServer::legacyHandshake = "omicron_legacy_data_on";
 const char* InputServer::tactileHandshake = "tactile_data_on";
 const char* InputServer::omicronV3Handshake = "omicronV3_data_on";
+const char* InputServer::omicronV4Handshake = "omicronV4_data_on";
 
 ///////////////////////////////////////////////////////////////////////////////
-// Creates an event packet from an Omicron event. Returns the buffer.
-char* InputServer::createOmicronPacketFromEvent(const Event* evt)
+// Returns the size of the packet encoding the event: 16 header fields followed
+// by the extra data.
+int InputServer::getOmicronPacketSize(const Event* evt)
 {
-	int offset = 0;
-
-	char* eventPacket;
+	return 16 * 4 + evt->getExtraDataSize();
+}
 
-	if (evt->isExtraDataLarge())
-	{
-		eventPacket = new char[DEFAULT_LRGBUFLEN];
-	}
-	else
-	{
-		eventPacket = new char[DEFAULT_BUFLEN];
-	}
+///////////////////////////////////////////////////////////////////////////////
+// Writes an event packet from an Omicron event. Returns the packet length.
+int InputServer::writeOmicronPacketFromEvent(const Event* evt, char* eventPacket)
+{
+	int offset = 0;
 
 	OI_WRITEBUF(unsigned int, eventPacket, offset, evt->getTimestamp());
 	OI_WRITEBUF(unsigned int, eventPacket, offset, evt->getSourceId());
@@ -98,6 +97,25 @@ char* InputServer::createOmicronPacketFromEvent(const Event* evt)
 	}
 	offset += evt->getExtraDataSize();
 
+	return offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates an event packet from an Omicron event. Returns the buffer.
+char* InputServer::createOmicronPacketFromEvent(const Event* evt)
+{
+	char* eventPacket;
+
+	if (evt->isExtraDataLarge())
+	{
+		eventPacket = new char[DEFAULT_LRGBUFLEN];
+	}
+	else
+	{
+		eventPacket = new char[DEFAULT_BUFLEN];
+	}
+
+	writeOmicronPacketFromEvent(evt, eventPacket);
 	return eventPacket;
 }
 
@@ -130,6 +148,304 @@ omicronConnector::EventData InputServer::createOmicronEventDataFromEventPacket(c
 	return ed;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+EventPacketBatch::EventPacketBatch(int initialCapacity):
+	myCapacity(initialCapacity),
+	mySize(0)
+{
+	myBuffer = new char[myCapacity];
+	myPackets.reserve(OMICRON_MAX_EVENTS);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+EventPacketBatch::~EventPacketBatch()
+{
+	delete[] myBuffer;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventPacketBatch::add(const Event* evt)
+{
+	// Keep packets 4-byte aligned, so the encoder writes aligned fields.
+	int offset = (mySize + 3) & ~3;
+	int packetSize = InputServer::getOmicronPacketSize(evt);
+	if (offset + packetSize > myCapacity)
+	{
+		// Grow geometrically, so growth stops once the peak batch size is reached.
+		int newCapacity = myCapacity * 2;
+		while (offset + packetSize > newCapacity) newCapacity *= 2;
+		char* newBuffer = new char[newCapacity];
+		memcpy(newBuffer, myBuffer, mySize);
+		delete[] myBuffer;
+		myBuffer = newBuffer;
+		myCapacity = newCapacity;
+	}
+
+	PacketRef ref;
+	ref.offset = offset;
+	ref.length = InputServer::writeOmicronPacketFromEvent(evt, &myBuffer[offset]);
+	myPackets.push_back(ref);
+	mySize = offset + ref.length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventPacketBatch::send(NetClient* client)
+{
+	for (size_t i = 0; i < myPackets.size(); i++)
+	{
+		client->sendEvent(&myBuffer[myPackets[i].offset], myPackets[i].length);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void EventPacketBatch::clear()
+{
+	mySize = 0;
+	myPackets.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reliable channel timing, in milliseconds.
+static const double ReliableInitialRto = 20.0;
+static const double ReliableMinRto = 2.0;
+static const double ReliableMaxRto = 200.0;
+// Number of acks reporting later packets before a missing packet is resent.
+static const int ReliableFastRetransmitAcks = 2;
+
+///////////////////////////////////////////////////////////////////////////////
+ReliableSender::ReliableSender():
+	myNextSeq(1),
+	myBaseSeq(1),
+	myDroppedCount(0),
+	myHasRtt(false),
+	mySrtt(0),
+	myRttVar(0),
+	myRto(ReliableInitialRto)
+{
+	mySlots = new Slot[omicronConnector::ReliableWindowSize];
+	for (int i = 0; i < omicronConnector::ReliableWindowSize; i++)
+	{
+		mySlots[i].seq = 0;
+		mySlots[i].acked = true;
+		mySlots[i].data = NULL;
+		mySlots[i].length = 0;
+		mySlots[i].capacity = 0;
+	}
+	myScratch = new char[sizeof(omicronConnector::ReliableHeader) + DEFAULT_LRGBUFLEN];
+	myTimer.start();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ReliableSender::~ReliableSender()
+{
+	for (int i = 0; i < omicronConnector::ReliableWindowSize; i++)
+	{
+		delete[] mySlots[i].data;
+	}
+	delete[] mySlots;
+	delete[] myScratch;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ReliableSender::send(SOCKET s, const sockaddr_in& addr, const char* data, int length, bool reliable)
+{
+	omicronConnector::ReliableHeader header;
+	header.magic = omicronConnector::ReliableMagic;
+	header.aux = myBaseSeq;
+	int packetLength = sizeof(header) + length;
+
+	if (!reliable)
+	{
+		if (length > DEFAULT_LRGBUFLEN) return;
+		header.kind = omicronConnector::ReliableKindUnreliable;
+		header.seq = myNextSeq - 1;
+		memcpy(myScratch, &header, sizeof(header));
+		memcpy(myScratch + sizeof(header), data, length);
+		sendto(s, myScratch, packetLength, 0, (const struct sockaddr*)&addr, sizeof(addr));
+		return;
+	}
+
+	// If the window is full, process the acks that arrived since the last poll
+	// first: they usually free the oldest slots.
+	if (getUnackedCount() >= omicronConnector::ReliableWindowSize) readAcks(s, addr);
+
+	// If it is still full the client stopped acknowledging: give up on the 
+	// oldest packet. The client skips it when it sees the new base sequence 
+	// number. Drops are counted (see getDroppedCount) so they show up in the
+	// client metrics.
+	if (getUnackedCount() >= omicronConnector::ReliableWindowSize)
+	{
+		myDroppedCount++;
+		if (myDroppedCount == 1 || myDroppedCount % 1000 == 0)
+		{
+			ofwarn("ReliableSender: retransmission window full, dropping oldest reliable packet (%1% dropped so far)", %myDroppedCount);
+		}
+		mySlots[myBaseSeq % omicronConnector::ReliableWindowSize].acked = true;
+		myBaseSeq++;
+		while (myBaseSeq != myNextSeq && mySlots[myBaseSeq % omicronConnector::ReliableWindowSize].acked) myBaseSeq++;
+		header.aux = myBaseSeq;
+	}
+
+	Slot& slot = mySlots[myNextSeq % omicronConnector::ReliableWindowSize];
+	if (slot.capacity < packetLength)
+	{
+		delete[] slot.data;
+		slot.capacity = packetLength > DEFAULT_BUFLEN ? packetLength : DEFAULT_BUFLEN;
+		slot.data = new char[slot.capacity];
+	}
+
+	header.kind = omicronConnector::ReliableKindReliable;
+	header.seq = myNextSeq;
+	memcpy(slot.data, &header, sizeof(header));
+	memcpy(slot.data + sizeof(header), data, length);
+	slot.length = packetLength;
+	slot.seq = myNextSeq;
+	slot.acked = false;
+	slot.retransmits = 0;
+	slot.nacks = 0;
+	myNextSeq++;
+
+	transmit(s, addr, slot);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ReliableSender::transmit(SOCKET s, const sockaddr_in& addr, Slot& slot)
+{
+	// Refresh the base sequence number: it may have moved since the packet
+	// was first sent.
+	((omicronConnector::ReliableHeader*)slot.data)->aux = myBaseSeq;
+	slot.sendTime = myTimer.getElapsedTimeInMilliSec();
+	sendto(s, slot.data, slot.length, 0, (const struct sockaddr*)&addr, sizeof(addr));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ReliableSender::poll(SOCKET s, const sockaddr_in& addr)
+{
+	readAcks(s, addr);
+
+	// Retransmit packets whose timeout expired. The timeout doubles with
+	// every retransmission of the same packet.
+	double now = myTimer.getElapsedTimeInMilliSec();
+	for (unsigned int seq = myBaseSeq; seq != myNextSeq; seq++)
+	{
+		Slot& slot = mySlots[seq % omicronConnector::ReliableWindowSize];
+		if (slot.acked) continue;
+		int backoff = slot.retransmits < 5 ? slot.retransmits : 5;
+		double rto = myRto * (1 << backoff);
+		if (rto > ReliableMaxRto) rto = ReliableMaxRto;
+		if (now - slot.sendTime >= rto)
+		{
+			slot.retransmits++;
+			slot.nacks = 0;
+			transmit(s, addr, slot);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ReliableSender::readAcks(SOCKET s, const sockaddr_in& addr)
+{
+	// Read all pending acks without blocking
+	omicronConnector::ReliableHeader ack;
+	fd_set readFDs;
+	struct timeval timeout;
+	while (true)
+	{
+		FD_ZERO(&readFDs);
+		FD_SET(s, &readFDs);
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 0;
+		if (select(s + 1, &readFDs, NULL, NULL, &timeout) <= 0) break;
+
+		int result = recvfrom(s, (char*)&ack, sizeof(ack), 0, NULL, NULL);
+		if (result <= 0) break;
+		if (result == sizeof(ack) &&
+			ack.magic == omicronConnector::ReliableMagic &&
+			ack.kind == omicronConnector::ReliableKindAck)
+		{
+			processAck(s, addr, ack.seq, ack.aux);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ReliableSender::processAck(SOCKET s, const sockaddr_in& addr, unsigned int cumulativeAck, unsigned int sackBits)
+{
+	double now = myTimer.getElapsedTimeInMilliSec();
+	// Use the most recent packet acked by this ack that was never
+	// retransmitted as the round trip time sample (Karn's algorithm).
+	double rttSample = -1;
+	unsigned int highestAcked = cumulativeAck;
+
+	// Cumulative part
+	while (isPending(myBaseSeq) && (int)(cumulativeAck - myBaseSeq) >= 0)
+	{
+		Slot& slot = mySlots[myBaseSeq % omicronConnector::ReliableWindowSize];
+		if (!slot.acked)
+		{
+			if (slot.retransmits == 0) rttSample = now - slot.sendTime;
+			slot.acked = true;
+		}
+		myBaseSeq++;
+	}
+
+	// Selective part
+	for (int i = 0; i < 32; i++)
+	{
+		if ((sackBits & (1u << i)) == 0) continue;
+		unsigned int seq = cumulativeAck + 2 + i;
+		if (!isPending(seq)) continue;
+		Slot& slot = mySlots[seq % omicronConnector::ReliableWindowSize];
+		if (!slot.acked && slot.seq == seq)
+		{
+			if (slot.retransmits == 0) rttSample = now - slot.sendTime;
+			slot.acked = true;
+		}
+		highestAcked = seq;
+	}
+
+	// Packets that were selectively acked at the head of the window
+	while (myBaseSeq != myNextSeq && mySlots[myBaseSeq % omicronConnector::ReliableWindowSize].acked) myBaseSeq++;
+
+	if (rttSample >= 0) updateRtt(rttSample);
+
+	// Fast retransmit: packets older than the newest acked one are missing
+	// or reordered. Resend them once enough acks confirm they are missing.
+	for (unsigned int seq = myBaseSeq; (int)(seq - highestAcked) < 0 && seq != myNextSeq; seq++)
+	{
+		Slot& slot = mySlots[seq % omicronConnector::ReliableWindowSize];
+		if (slot.acked) continue;
+		slot.nacks++;
+		if (slot.nacks == ReliableFastRetransmitAcks)
+		{
+			slot.retransmits++;
+			transmit(s, addr, slot);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ReliableSender::updateRtt(double sample)
+{
+	// Standard smoothed round trip time estimator (RFC 6298)
+	if (!myHasRtt)
+	{
+		mySrtt = sample;
+		myRttVar = sample / 2;
+		myHasRtt = true;
+	}
+	else
+	{
+		double delta = mySrtt - sample;
+		if (delta < 0) delta = -delta;
+		myRttVar = 0.75 * myRttVar + 0.25 * delta;
+		mySrtt = 0.875 * mySrtt + 0.125 * sample;
+	}
+	myRto = mySrtt + 4 * myRttVar;
+	if (myRto < ReliableMinRto) myRto = ReliableMinRto;
+	if (myRto > ReliableMaxRto) myRto = ReliableMaxRto;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Sets the ServiceManager for accessing event stream
 void InputServer::setServiceManager(ServiceManager* sm)
@@ -152,9 +468,19 @@ void InputServer::handleEvent(const Event& evt)
     if(evt.isProcessed()) return;
 	//if (!serviceManager && evt.isProcessed()) return;
 
-    timeb tb;
-    ftime( &tb );
-    int timestamp = tb.millitm + (tb.time & 0xfffff) * 1000;
+	TraceScope trace("InputServer::handleEvent", "server");
+
+	if(journal != NULL) journal->write(evt);
+
+    int timestamp = otimestamp();
+
+	eventsMetric->add();
+	if (MetricsRegistry::getInstance()->isEnabled())
+	{
+		// Event timestamps have millisecond resolution.
+		int age = timestamp - (int)evt.getTimestamp();
+		if (age >= 0) eventAgeMetric->observe(age / 1000.0);
+	}
 
 #ifdef OMICRON_USE_VRPN
     vrpnDevice->update(&evt);
@@ -214,6 +540,11 @@ void InputServer::handleEvent(const Event& evt)
 		validTacTileEvent = handleTacTileEvent(evt);
 	}
 
+	if (stateSnapshotEnabled)
+	{
+		stateTable.update(evt, evt.isExtraDataLarge() ? eventPacketLarge : eventPacket, offset);
+	}
+
     if( showStreamSpeed )
     {
         if( (timestamp - lastOutgoingEventTime) >= 1000 )
@@ -237,8 +568,8 @@ void InputServer::handleEvent(const Event& evt)
 	{
 		NetClient* client = itr->second;
 
-		// Only send service types client requested
-		if (client->requestedServiceType(evt.getServiceType()))
+		// Only send service types (V3) or events (V4 subscriptions) client requested
+		if (client->acceptsEvent(evt))
 		{
 
 			if (client->getMode() == data_omicron_legacy)
@@ -252,6 +583,20 @@ void InputServer::handleEvent(const Event& evt)
 					client->sendEvent(tacTilePacket, 512);
 				}
 			}
+			else if (client->isReliable())
+			{
+				// Reliable UDP clients get exact-length packets. Discrete events go
+				// through the reliable channel, so they stay in order with updates.
+				char* packet = evt.isExtraDataLarge() ? eventPacketLarge : eventPacket;
+				if (evt.getType() == Event::Update || evt.getType() == Event::Move)
+				{
+					client->sendEvent(packet, offset);
+				}
+				else
+				{
+					client->sendReliableEvent(packet, offset);
+				}
+			}
 			else
 			{
 				if (evt.getType() == Event::Update || evt.getType() == Event::Move)
@@ -268,7 +613,7 @@ void InputServer::handleEvent(const Event& evt)
 				else
 				{
 					// If client supports dual TCP/UDP (V2+), send single events as TCP
-					if (client->getMode() == data_omicronV2 || client->getMode() == data_omicronV3)
+					if (client->getMode() == data_omicronV2 || client->getMode() == data_omicronV3 || client->getMode() == data_omicronV4)
 					{
 						if (evt.isExtraDataLarge())
 						{
@@ -595,6 +940,59 @@ bool InputServer::handleTacTileEvent(const Event& evt)
 	return false;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void InputServer::dispose()
+{
+	typedef std::pair<char*, NetClient*> ClientItem;
+	foreach(ClientItem item, netClients)
+	{
+		item.second->dispose();
+		delete item.second;
+		delete[] item.first;
+	}
+	netClients.clear();
+
+	if(listenSocket != INVALID_SOCKET)
+	{
+		SOCKET_CLOSE(listenSocket);
+		listenSocket = INVALID_SOCKET;
+	}
+
+	if(metricsServer != NULL)
+	{
+		metricsServer->stopServing();
+		delete metricsServer;
+		metricsServer = NULL;
+	}
+
+	MetricsRegistry* mr = MetricsRegistry::getInstance();
+	mr->remove(eventsMetric);
+	mr->remove(clientsMetric);
+	mr->remove(eventAgeMetric);
+	eventsMetric = NULL;
+	clientsMetric = NULL;
+	eventAgeMetric = NULL;
+
+	if(journal != NULL)
+	{
+		String journalFile = journal->getFilename();
+		journal->close();
+		delete journal;
+		journal = NULL;
+
+		// Make sure the journal trailer made it to disk
+		EventJournalReader reader;
+		if(!reader.open(journalFile) || reader.isRecovered())
+		{
+			ofwarn("InputServer: journal %1% was not closed correctly", %journalFile);
+		}
+		else
+		{
+			ofmsg("InputServer: journal %1% closed (%2% blocks)", %journalFile %reader.getBlockCount());
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void InputServer::startConnection(Config* cfg)
 {
@@ -615,6 +1013,52 @@ void InputServer::startConnection(Config* cfg)
 	showEventMessages = Config::getBoolValue("showEventMessages", sCfg, false);
 	showIncomingStream = Config::getBoolValue("showIncomingStream", sCfg, false);
 	showIncomingMessages = Config::getBoolValue("showIncomingMessages", sCfg, false);
+	stateSnapshotEnabled = Config::getBoolValue("stateSnapshot", sCfg, true);
+
+	// Journal all outgoing events to a file. The journal is written by a 
+	// background thread, so it does not slow down event streaming.
+	journal = NULL;
+	String journalFile = Config::getStringValue("journalFile", sCfg, "");
+	if(journalFile != "")
+	{
+		journal = new EventJournalWriter();
+		if(!journal->open(journalFile))
+		{
+			delete journal;
+			journal = NULL;
+		}
+	}
+
+	MetricsRegistry* mr = MetricsRegistry::getInstance();
+	eventsMetric = mr->addCounter("omicron_server_events_total", "Events sent by the input server.");
+	clientsMetric = mr->addGauge("omicron_server_clients", "Clients connected to the input server.");
+	eventAgeMetric = mr->addHistogram("omicron_server_event_age_seconds", "Time from event creation to the input server sending it.");
+
+	// Serve metrics over HTTP and/or log a metrics summary periodically.
+	metricsServer = NULL;
+	int metricsPort = Config::getIntValue("metricsPort", sCfg, 0);
+	float metricsLogInterval = Config::getFloatValue("metricsLogInterval", sCfg, 0);
+	if(metricsPort != 0 || metricsLogInterval > 0)
+	{
+		metricsServer = new MetricsServer();
+		String metricsIP = Config::getStringValue("metricsListenIP", sCfg, "127.0.0.1");
+		if(!metricsServer->startServing(metricsIP, metricsPort, metricsLogInterval))
+		{
+			delete metricsServer;
+			metricsServer = NULL;
+		}
+	}
+
+	// Record a timeline of service polls, event sends and network writes. The
+	// trace is written to traceFile when the process receives SIGUSR1, and is
+	// also served by the metrics server at /trace.
+	if(Config::getBoolValue("trace", sCfg, false))
+	{
+		Tracer::setBufferSize(Config::getIntValue("traceBufferSize", sCfg, Tracer::DefaultBufferSize));
+		Tracer::setThreadName("InputServer");
+		Tracer::setEnabled(true);
+		Tracer::dumpOnSignal(Config::getStringValue("traceFile", sCfg, "oinputserver-trace.json"));
+	}
 
 	logClientConnectionsToFile = Config::getBoolValue("logClientConnectionsToFile", sCfg, false);
 	clientConnectLogFilePath = strdup(Config::getStringValue("clientLogPath", sCfg, "connectionLog.txt").c_str());
@@ -677,7 +1121,7 @@ void InputServer::startConnection(Config* cfg)
 	fcntl(listenSocket, F_SETFL, O_NONBLOCK);
 #endif
 
-    if (listenSocket == INVALID_SOCKET) 
+    if (listenSocket == INVALID_SOCKET || listenSocket == SOCKET_ERROR) 
     {
         PRINT_SOCKET_ERROR("OInputServer::startConnection");
         freeaddrinfo(result);
@@ -697,6 +1141,7 @@ void InputServer::startConnection(Config* cfg)
         freeaddrinfo(result);
 
         SOCKET_CLOSE(listenSocket);
+        listenSocket = INVALID_SOCKET;
         SOCKET_CLEANUP();
         return;
     }
@@ -712,6 +1157,7 @@ SOCKET InputServer::startListening()
     {
         PRINT_SOCKET_ERROR("OInputServer::startListening: bind failed");
         SOCKET_CLOSE(listenSocket);
+        listenSocket = INVALID_SOCKET;
         SOCKET_CLEANUP();
         return 0;
     } 
@@ -728,7 +1174,9 @@ SOCKET InputServer::startListening()
     // Accept a client socket
     clientSocket = accept(listenSocket, (struct sockaddr *)&clientInfo, (socklen_t*)&addrSize);
 
-    if (clientSocket == INVALID_SOCKET) 
+    // On Linux accept() returns -1 (SOCKET_ERROR) on failure, while
+    // INVALID_SOCKET is defined as 0 there: check both.
+    if (clientSocket == INVALID_SOCKET || clientSocket == SOCKET_ERROR) 
     {
         //printf("NetService: accept failed: %d\n", WSAGetLastError());
         // Commented out: We do not want to close the listen socket
@@ -765,15 +1213,19 @@ SOCKET InputServer::startListening()
             char* inMessage;
             char* portCStr;
 			char* flagsCStr;
-            inMessage = new char[iResult];
-            portCStr = new char[iResult];
-			flagsCStr = new char[iResult];
-
-			int readState = 0; // 0 = message, 1 = dataPort, 2 = clientParameters
+			char* subscriptionCStr;
+            inMessage = new char[iResult + 1];
+            portCStr = new char[iResult + 1];
+			flagsCStr = new char[iResult + 1];
+			subscriptionCStr = new char[iResult + 1];
+			subscriptionCStr[0] = '\0';
+
+			int readState = 0; // 0 = message, 1 = dataPort, 2 = clientParameters, 3 = subscription (V4)
             // Iterate through message string and
             // separate 'data_on,' from the port number
             int portIndex = iResult;
 			int flagIndex = iResult;
+			int subscriptionIndex = iResult;
             for( int i = 0; i < iResult; i++ )
             {
                 if( recvbuf[i] == ',' && readState == 0)
@@ -787,6 +1239,12 @@ SOCKET InputServer::startListening()
 					flagIndex = i + 1;
 					readState = 2;
 				}
+				else if (recvbuf[i] == ',' && readState == 2)
+				{
+					// The subscription is the rest of the message, commas included.
+					subscriptionIndex = i + 1;
+					readState = 3;
+				}
                 else if( i < portIndex )
                 {
                     inMessage[i] = recvbuf[i];
@@ -801,6 +1259,11 @@ SOCKET InputServer::startListening()
 					flagsCStr[i - flagIndex] = recvbuf[i];
 					flagsCStr[i - flagIndex + 1] = '\n';
 				}
+				else if (readState == 3)
+				{
+					subscriptionCStr[i - subscriptionIndex] = recvbuf[i];
+					subscriptionCStr[i - subscriptionIndex + 1] = '\0';
+				}
             }
 
             // Make sure handshake is correct
@@ -864,6 +1327,16 @@ SOCKET InputServer::startListening()
 
 				if (logClientConnectionsToFile) clientLogFile << " ACCEPTED OMICRON V3";
 			}
+			else if (strcmp(inMessage, omicronV4Handshake) == 0)
+			{
+				// Get data port number
+				dataPort = atoi(portCStr);
+				int flags = atoi(flagsCStr);
+				printf("OInputServer: '%s' requests omicron 4.0 (Subscriptions) data to be sent on port '%d' with flag '%d' subscription '%s'\n", clientAddress, dataPort, flags, subscriptionCStr);
+				createClient(clientAddress, dataPort, data_omicronV4, clientSocket, flags, subscriptionCStr);
+
+				if (logClientConnectionsToFile) clientLogFile << " ACCEPTED OMICRON V4";
+			}
 			else if (strcmp(inMessage, omicronStreamInHandshake) == 0)
 			{
 				// Get data port number
@@ -914,8 +1387,10 @@ SOCKET InputServer::startListening()
 			}
 
             gotData = true;
-            delete inMessage;
-            delete portCStr;
+            delete[] inMessage;
+            delete[] portCStr;
+            delete[] flagsCStr;
+            delete[] subscriptionCStr;
         } 
         else if (iResult == 0)
         {
@@ -940,6 +1415,8 @@ SOCKET InputServer::startListening()
 ///////////////////////////////////////////////////////////////////////////////
 void InputServer::loop()
 {
+	Tracer::poll();
+
 #ifdef OMICRON_USE_VRPN
     // VRPN connection
     connection->mainloop();
@@ -951,6 +1428,8 @@ void InputServer::loop()
 		char* clientAddress = p->first;
 		NetClient* client = p->second;
 
+		client->poll();
+
 		if ( client->isReceivingData() )
 		{
 			// Grab data from client
@@ -991,7 +1470,7 @@ void InputServer::loop()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void InputServer::createClient(const char* clientAddress, int dataPort, DataMode mode, SOCKET clientSocket, int flags)
+NetClient* InputServer::createClient(const char* clientAddress, int dataPort, DataMode mode, SOCKET clientSocket, int flags, const char* subscription)
 {
 	if (flags == -1)
 	{
@@ -1013,7 +1492,7 @@ void InputServer::createClient(const char* clientAddress, int dataPort, DataMode
     
     // Iterate through client map. If client name already exists,
     // do not add to list.
-	bool clientExists = false;
+	NetClient* client = NULL;
     std::map<char*, NetClient*>::iterator p;
     for(p = netClients.begin(); p != netClients.end(); p++) 
     {
@@ -1021,9 +1500,10 @@ void InputServer::createClient(const char* clientAddress, int dataPort, DataMode
         if( strcmp(p->first, addr) == 0 )
         {
             printf("OInputServer: NetClient already exists: %s \n", addr );
-			clientExists = true;
+			client = p->second;
 			p->second->updateClientSocket(clientSocket);
 			p->second->updateFlags(flags);
+			p->second->setSubscription(subscription);
 
             // Check dataMode: if different, update client
             if( p->second->getMode() != mode )
@@ -1049,6 +1529,10 @@ void InputServer::createClient(const char* clientAddress, int dataPort, DataMode
 				{
 					printf("OInputServer: NetClient '%s' now requesting omicron 3.0 (Client flags) data \n", addr);
 				}
+				else if (mode == data_omicronV4)
+				{
+					printf("OInputServer: NetClient '%s' now requesting omicron 4.0 (Subscriptions) data \n", addr);
+				}
                 else
                     printf("OInputServer: NetClient %s now requesting to receive omicron data \n", addr );
                 p->second->setMode(mode);
@@ -1056,8 +1540,55 @@ void InputServer::createClient(const char* clientAddress, int dataPort, DataMode
         }
     }
 
-	if (!clientExists)
+	if (client == NULL)
+	{
+		client = new NetClient(clientAddress, dataPort, mode, clientSocket, flags);
+		client->setSubscription(subscription);
+		netClients[addr] = client;
+		clientsMetric->set(netClients.size());
+	}
+	else
+	{
+		delete[] addr;
+	}
+
+	// Bring the client up to date right away, instead of waiting for each
+	// source to send its next update (which may never come for static sources).
+	if (stateSnapshotEnabled &&
+		(mode == data_omicron || mode == data_omicronV2 || mode == data_omicronV3 || mode == data_omicronV4))
+	{
+		sendStateSnapshot(client);
+	}
+	return client;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void InputServer::sendStateSnapshot(NetClient* client)
+{
+	Event header;
+	int sent = 0;
+	for (int i = 0; i < stateTable.getSize(); i++)
+	{
+		stateTable.getEventHeader(i, &header);
+		if (!client->acceptsEvent(header)) continue;
+
+		char* packet = (char*)stateTable.getPacket(i);
+		if (client->isReliable())
+		{
+			client->sendReliableEvent(packet, stateTable.getPacketLength(i));
+		}
+		else if (client->getMode() == data_omicronV2 || client->getMode() == data_omicronV3 || client->getMode() == data_omicronV4)
+		{
+			client->sendMsg(packet, stateTable.getPacketCapacity(i));
+		}
+		else
+		{
+			client->sendEvent(packet, stateTable.getPacketCapacity(i));
+		}
+		sent++;
+	}
+	if (sent > 0)
 	{
-		netClients[addr] = new NetClient(clientAddress, dataPort, mode, clientSocket, flags);
+		ofmsg("OInputServer: Sent state snapshot of %1% source(s)", %sent);
 	}
 }
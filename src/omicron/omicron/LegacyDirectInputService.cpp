@@ -391,7 +391,7 @@ void LegacyDirectInputService::checkForNewControllers()
 void LegacyDirectInputService::poll() 
 {
 	static float lastt;
-	float curt = (float)((double)clock() / CLOCKS_PER_SEC);
+	float curt = (float)otime();
 	if(curt - lastt <= myUpdateInterval)
 	{
 		return;
@@ -294,7 +294,7 @@ void LegacyNetService::poll()
 	// Check touchlist for old touches (haven't been updated recently) and remove them
 	//Event* evt;
 	static float lastt;
-	float curt = (float)((double)clock() / CLOCKS_PER_SEC);
+	float curt = (float)otime();
 			
 	std::map<int, NetTouches>::iterator p;
 	
@@ -577,7 +577,7 @@ void LegacyNetService::parseDGram(int result)
 				touch.yPos = params[3];
 				touch.xWidth = params[4];
 				touch.yWidth = params[5];
-				params[6] = (float)((double)clock() / CLOCKS_PER_SEC); // Set the timestamp
+				params[6] = (float)otime(); // Set the timestamp, compared against otime() in poll
 				touch.timestamp = params[6];
 				
 				//printf("New Time set %d \n", curTime );
@@ -0,0 +1,415 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A service generating synthetic mocap, skeleton, touch and image events, 
+ *  used to load test the event pipeline without tracking hardware.
+ ******************************************************************************/
+#include "omicron/LoadGeneratorService.h"
+#include "omicron/TouchGestureManager.h"
+#include "omicron/StringUtils.h"
+
+#include <chrono>
+
+using namespace omicron;
+
+// If the service falls behind (i.e. a slow poll loop), do not generate more
+// than this number of frames per stream in a single poll.
+static const int MaxFramesPerPoll = 8;
+// Probes are single events, so allow them to catch up further.
+static const int MaxProbesPerPoll = OMICRON_MAX_EVENTS / 4;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+LoadGeneratorService::LoadGeneratorService():
+	myRandomState(1),
+	myProbeSequence(0),
+	myTouchDuration(1.5f),
+	myTouchSpeed(0.2f),
+	myNextTouchId(0),
+	myUseGestureManager(false),
+	myTouchGestureManager(NULL),
+	myImageSize(0),
+	myImageData(NULL),
+	myImageFrame(0),
+	myGeneratedEvents(0),
+	myLastReportedEvents(0),
+	myLastReportTime(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+LoadGeneratorService::~LoadGeneratorService()
+{
+	dispose();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGeneratorService::setup(Setting& settings)
+{
+	myRandomState = Config::getIntValue("seed", settings, 1);
+	if(myRandomState == 0) myRandomState = 1;
+
+	myRigidBodies.count = Config::getIntValue("rigidBodies", settings, 0);
+	myRigidBodies.rate = Config::getFloatValue("rigidBodyRate", settings, 120.0f);
+	myRigidBodies.sourceId = Config::getIntValue("rigidBodySourceId", settings, 0);
+
+	// Rigid bodies and skeletons are both Mocap sources, so their source ids
+	// must not overlap. Skeletons start after the rigid bodies by default.
+	uint rigidBodyEnd = myRigidBodies.sourceId + myRigidBodies.count;
+	mySkeletons.count = Config::getIntValue("skeletons", settings, 0);
+	mySkeletons.rate = Config::getFloatValue("skeletonRate", settings, 30.0f);
+	mySkeletons.sourceId = Config::getIntValue("skeletonSourceId", settings, rigidBodyEnd > 100 ? rigidBodyEnd : 100);
+	uint skeletonEnd = mySkeletons.sourceId + mySkeletons.count;
+	if(myRigidBodies.count > 0 && mySkeletons.count > 0 &&
+		mySkeletons.sourceId < rigidBodyEnd && myRigidBodies.sourceId < skeletonEnd)
+	{
+		ofwarn("LoadGeneratorService: skeleton source ids %1%-%2% overlap rigid body source ids %3%-%4%, skeletons will start at %5%",
+			%mySkeletons.sourceId %(skeletonEnd - 1) %myRigidBodies.sourceId %(rigidBodyEnd - 1) %rigidBodyEnd);
+		mySkeletons.sourceId = rigidBodyEnd;
+	}
+
+	myTouches.count = Config::getIntValue("touches", settings, 0);
+	myTouches.rate = Config::getFloatValue("touchRate", settings, 100.0f);
+	myTouches.sourceId = Config::getIntValue("touchSourceId", settings, 1000);
+	myTouchDuration = Config::getFloatValue("touchDuration", settings, 1.5f);
+	myTouchSpeed = Config::getFloatValue("touchSpeed", settings, 0.2f);
+
+	myImages.count = Config::getIntValue("images", settings, 0);
+	myImages.rate = Config::getFloatValue("imageRate", settings, 10.0f);
+	myImages.sourceId = Config::getIntValue("imageSourceId", settings, 0);
+	myImageSize = Config::getIntValue("imageSize", settings, 32768);
+	if(myImageSize > DEFAULT_LRGBUFLEN)
+	{
+		ofwarn("LoadGeneratorService: imageSize clamped to %1% bytes", %DEFAULT_LRGBUFLEN);
+		myImageSize = DEFAULT_LRGBUFLEN;
+	}
+
+	myProbes.rate = Config::getFloatValue("probeRate", settings, 0);
+	myProbes.count = myProbes.rate > 0 ? 1 : 0;
+	myProbes.sourceId = Config::getIntValue("probeSourceId", settings, 0xbe4c);
+
+	myUseGestureManager = Config::getBoolValue("useGestureManager", settings, false);
+	if(myUseGestureManager)
+	{
+		myTouchGestureManager = new TouchGestureManager();
+		myTouchGestureManager->setup(settings);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGeneratorService::initialize()
+{
+	myTouchPoints.resize(myTouches.count);
+	for(int i = 0; i < myTouches.count; i++)
+	{
+		TouchPoint& tp = myTouchPoints[i];
+		tp.active = false;
+		// Stagger touch starts, so they do not all go down on the same frame.
+		tp.endTime = random() * myTouchDuration;
+	}
+	myNextTouchId = myTouches.sourceId;
+
+	if(myImages.count > 0)
+	{
+		myImageData = new char[myImageSize];
+		for(int i = 0; i < myImageSize; i++) myImageData[i] = (char)(random() * 256);
+	}
+
+	if(myTouchGestureManager != NULL)
+	{
+		myTouchGestureManager->registerPQService(this);
+	}
+
+	myRigidBodies.nextFrameTime = 0;
+	mySkeletons.nextFrameTime = 0;
+	myTouches.nextFrameTime = 0;
+	myImages.nextFrameTime = 0;
+	myProbes.nextFrameTime = 0;
+	myTimer.start();
+
+	float eventRate = 
+		myRigidBodies.count * myRigidBodies.rate + 
+		mySkeletons.count * mySkeletons.rate + 
+		myTouches.count * myTouches.rate + 
+		myImages.count * myImages.rate +
+		myProbes.rate;
+	ofmsg("LoadGeneratorService: %1% rigid bodies, %2% skeletons, %3% touches, %4% images (about %5% events/s)",
+		%myRigidBodies.count %mySkeletons.count %myTouches.count %myImages.count %eventRate);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGeneratorService::dispose()
+{
+	delete[] myImageData;
+	myImageData = NULL;
+	if(myTouchGestureManager != NULL)
+	{
+		myTouchGestureManager->stopThread();
+		delete myTouchGestureManager;
+		myTouchGestureManager = NULL;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+float LoadGeneratorService::random()
+{
+	// xorshift32
+	myRandomState ^= myRandomState << 13;
+	myRandomState ^= myRandomState >> 17;
+	myRandomState ^= myRandomState << 5;
+	return (myRandomState >> 8) / 16777216.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+int LoadGeneratorService::framesDue(Stream& stream, double now, int maxFrames)
+{
+	if(stream.count <= 0 || stream.rate <= 0) return 0;
+
+	double interval = 1.0 / stream.rate;
+	int frames = 0;
+	while(stream.nextFrameTime <= now && frames < maxFrames)
+	{
+		stream.nextFrameTime += interval;
+		frames++;
+	}
+	// Drop the frames we could not catch up with.
+	if(stream.nextFrameTime <= now) stream.nextFrameTime = now + interval;
+	return frames;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGeneratorService::poll()
+{
+	double now = myTimer.getElapsedTimeInSec();
+
+	if(myTouchGestureManager != NULL) myTouchGestureManager->poll();
+
+	generateRigidBodies(now);
+	generateSkeletons(now);
+	generateTouches(now);
+	generateImages(now);
+	generateProbes(now);
+
+	if(isDebugEnabled() && now - myLastReportTime >= 5.0)
+	{
+		ofmsg("LoadGeneratorService: %1% events/s", 
+			%((myGeneratedEvents - myLastReportedEvents) / (now - myLastReportTime)));
+		myLastReportedEvents = myGeneratedEvents;
+		myLastReportTime = now;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGeneratorService::generateRigidBodies(double now)
+{
+	int frames = framesDue(myRigidBodies, now, MaxFramesPerPoll);
+	if(frames == 0) return;
+
+	lockEvents();
+	for(int f = 0; f < frames; f++)
+	{
+		for(int i = 0; i < myRigidBodies.count; i++)
+		{
+			// Each body moves on its own circle, at head height.
+			float t = (float)now + i * 0.7f;
+			float radius = 0.5f + 0.1f * (i % 8);
+			Event* evt = writeHead();
+			evt->reset(Event::Update, Service::Mocap, myRigidBodies.sourceId + i);
+			evt->setPosition(radius * cos(t), 1.6f + 0.05f * sin(t * 3), radius * sin(t));
+			evt->setOrientation(Quaternion(AngleAxis(t, Vector3f::UnitY())));
+		}
+	}
+	unlockEvents();
+	myGeneratedEvents += frames * myRigidBodies.count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGeneratorService::generateSkeletons(double now)
+{
+	int frames = framesDue(mySkeletons, now, MaxFramesPerPoll);
+	if(frames == 0) return;
+
+	lockEvents();
+	for(int f = 0; f < frames; f++)
+	{
+		for(int i = 0; i < mySkeletons.count; i++)
+		{
+			float t = (float)now + i;
+			Vector3f root(i * 0.8f - mySkeletons.count * 0.4f, 1.0f, 2.0f + 0.3f * sin(t * 0.5f));
+
+			Event* evt = writeHead();
+			evt->reset(Event::Update, Service::Mocap, mySkeletons.sourceId + i);
+			evt->setPosition(root + Vector3f(0, 0.7f, 0));
+			evt->setExtraDataType(Event::ExtraDataVector3Array);
+			// Joints swing around a standing pose.
+			for(int j = 0; j < Event::OMICRON_SKEL_COUNT; j++)
+			{
+				float height = 0.8f - 1.6f * j / Event::OMICRON_SKEL_COUNT;
+				float side = (j % 2 == 0) ? -0.2f : 0.2f;
+				Vector3f joint(side + 0.1f * sin(t * 2 + j), height, 0.05f * cos(t * 2 + j));
+				evt->setExtraDataVector3(j, root + joint);
+			}
+		}
+	}
+	unlockEvents();
+	myGeneratedEvents += frames * mySkeletons.count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGeneratorService::generateTouches(double now)
+{
+	int frames = framesDue(myTouches, now, MaxFramesPerPoll);
+	if(frames == 0) return;
+
+	float dt = 1.0f / myTouches.rate;
+	int timestamp = (int)(now * 1000);
+	for(int f = 0; f < frames; f++)
+	{
+		// Build the frame first, then hand it to the gesture manager and the
+		// event buffer in one go, like PQService does.
+		myFrameTouches.clear();
+		myFrameTypes.clear();
+		for(int i = 0; i < myTouches.count; i++)
+		{
+			TouchPoint& tp = myTouchPoints[i];
+			Event::Type type;
+			if(!tp.active)
+			{
+				// Wait for the touch point to come back down.
+				if(now < tp.endTime) continue;
+				tp.active = true;
+				tp.id = myNextTouchId++;
+				tp.x = 0.05f + 0.9f * random();
+				tp.y = 0.05f + 0.9f * random();
+				float angle = random() * 2 * (float)Math::Pi;
+				tp.vx = cos(angle) * myTouchSpeed;
+				tp.vy = sin(angle) * myTouchSpeed;
+				tp.width = 0.005f + 0.01f * random();
+				tp.endTime = now + myTouchDuration * (0.5f + random());
+				type = Event::Down;
+			}
+			else if(now >= tp.endTime)
+			{
+				tp.active = false;
+				tp.endTime = now + myTouchDuration * 0.5f * random();
+				type = Event::Up;
+			}
+			else
+			{
+				tp.x += tp.vx * dt;
+				tp.y += tp.vy * dt;
+				if(tp.x < 0 || tp.x > 1) { tp.vx = -tp.vx; tp.x = tp.x < 0 ? 0 : 1; }
+				if(tp.y < 0 || tp.y > 1) { tp.vy = -tp.vy; tp.y = tp.y < 0 ? 0 : 1; }
+				type = Event::Move;
+			}
+
+			Touch touch;
+			touch.ID = tp.id;
+			touch.groupID = tp.id;
+			touch.xPos = tp.x;
+			touch.yPos = tp.y;
+			touch.xWidth = tp.width;
+			touch.yWidth = tp.width;
+			touch.timestamp = timestamp;
+			myFrameTouches.push_back(touch);
+			myFrameTypes.push_back(type);
+		}
+		if(myFrameTouches.empty()) continue;
+
+		int count = (int)myFrameTouches.size();
+		if(myTouchGestureManager != NULL)
+		{
+			myTouchGestureManager->addTouches(myFrameTypes.data(), myFrameTouches.data(), count);
+		}
+
+		lockEvents();
+		for(int i = 0; i < count; i++)
+		{
+			const Touch& touch = myFrameTouches[i];
+			Event* evt = writeHead();
+			evt->reset(myFrameTypes[i], Service::Pointer, touch.ID);
+			evt->setPosition(touch.xPos, touch.yPos);
+			evt->setExtraDataType(Event::ExtraDataFloatArray);
+			evt->setExtraDataFloat(0, touch.xWidth);
+			evt->setExtraDataFloat(1, touch.yWidth);
+		}
+		unlockEvents();
+		myGeneratedEvents += count;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGeneratorService::generateImages(double now)
+{
+	int frames = framesDue(myImages, now, MaxFramesPerPoll);
+	if(frames == 0) return;
+
+	lockEvents();
+	for(int f = 0; f < frames; f++)
+	{
+		for(int i = 0; i < myImages.count; i++)
+		{
+			// Change a few bytes every frame, so consecutive images differ.
+			myImageData[(myImageFrame * 4099) % myImageSize] ^= 0x5a;
+			myImageFrame++;
+
+			Event* evt = writeHead();
+			evt->reset(Event::Update, Service::Image, myImages.sourceId + i);
+			evt->setExtraData(Event::ExtraDataByte, myImageSize, 1, myImageData);
+		}
+	}
+	unlockEvents();
+	myGeneratedEvents += frames * myImages.count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGeneratorService::generateProbes(double now)
+{
+	int frames = framesDue(myProbes, now, MaxProbesPerPoll);
+	if(frames == 0) return;
+
+	lockEvents();
+	for(int f = 0; f < frames; f++)
+	{
+		// Use the steady clock, not otime(): it is shared by all processes on this machine.
+		uint64 t = (uint64)std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+		Event* evt = writeHead();
+		evt->reset(Event::Update, Service::Generic, myProbes.sourceId);
+		evt->setExtraDataType(Event::ExtraDataIntArray);
+		evt->setExtraDataInt(0, myProbeSequence++);
+		evt->setExtraDataInt(1, (int)(t & 0xffffffff));
+		evt->setExtraDataInt(2, (int)(t >> 32));
+	}
+	unlockEvents();
+	myGeneratedEvents += frames;
+}
@@ -145,7 +145,7 @@ void MSKinectService::initialize()
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void MSKinectService::poll()
 {
-	float curt = (float)((double)clock() / CLOCKS_PER_SEC);
+	float curt = (float)otime();
 	float lastt = lastUpdateTime;
 
 	if (enableKinectBody)
@@ -347,9 +347,7 @@ void MSKinectService::pollColor()
 
 				color_pImageReady = true;
 
-				timeb tb;
-				ftime(&tb);
-				currentFrameTimestamp = tb.millitm + (tb.time & 0xfffff) * 1000;
+				currentFrameTimestamp = otimestamp();
 
 				if (debugInfo)
 				{
@@ -474,9 +472,7 @@ void MSKinectService::pollDepth()
 				int nPackets = 32; // 512 * 424 = 217088 * 4 = 868352 / 32 = 27136 (max imageBuffer size = 41472)
 				int dataPacketSize = pImageSize / nPackets;
 
-				timeb tb;
-				ftime(&tb);
-				int timestamp = tb.millitm + (tb.time & 0xfffff) * 1000;
+				int timestamp = otimestamp();
 
 				for (int i = 0; i < nPackets; i++)
 				{
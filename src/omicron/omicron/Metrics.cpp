@@ -0,0 +1,488 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A registry of counters, gauges and latency histograms describing the 
+ *  live state of the input pipeline, and a server exposing them.
+ ******************************************************************************/
+#include "omicron/Metrics.h"
+#include "omicron/StringUtils.h"
+#include "omicron/Trace.h"
+
+#include <algorithm>
+#include <map>
+
+#ifndef OMICRON_OS_WIN
+#include <sys/select.h>
+#endif
+
+using namespace omicron;
+
+// Upper bounds of the histogram buckets, in seconds.
+static const double sBucketBounds[MetricHistogram::BucketCount] = {
+	1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 
+	1e-3, 2.5e-3, 5e-3, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 
+	1, 2.5, 5, 10 };
+
+MetricsRegistry* MetricsRegistry::mysInstance = NULL;
+
+///////////////////////////////////////////////////////////////////////////////
+double MetricHistogram::getBucketBound(int bucket)
+{
+	return sBucketBounds[bucket];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MetricHistogram::MetricHistogram(const String& name, const String& help, const String& labels):
+	Metric(Histogram, name, help, labels), myCount(0), mySumNanos(0)
+{
+	for(int i = 0; i <= BucketCount; i++) myBuckets[i].store(0, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void MetricHistogram::observe(double seconds)
+{
+	if(seconds < 0) seconds = 0;
+	int bucket = 0;
+	while(bucket < BucketCount && seconds > sBucketBounds[bucket]) bucket++;
+
+	myBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	myCount.fetch_add(1, std::memory_order_relaxed);
+	mySumNanos.fetch_add((uint64)(seconds * 1e9), std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+double MetricHistogram::getQuantileBound(double q)
+{
+	uint64 count = getCount();
+	if(count == 0) return 0;
+
+	uint64 target = (uint64)(q * count);
+	uint64 cumulative = 0;
+	for(int i = 0; i < BucketCount; i++)
+	{
+		cumulative += getBucket(i);
+		if(cumulative >= target) return sBucketBounds[i];
+	}
+	// Above the last bound.
+	return sBucketBounds[BucketCount - 1];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MetricsRegistry* MetricsRegistry::getInstance()
+{
+	if(mysInstance == NULL)
+	{
+		mysInstance = new MetricsRegistry();
+	}
+	return mysInstance;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void MetricsRegistry::cleanup()
+{
+	if(mysInstance != NULL)
+	{
+		foreach(Metric* m, mysInstance->myMetrics) delete m;
+		delete mysInstance;
+		mysInstance = NULL;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MetricsRegistry::MetricsRegistry(): myEnabled(false)
+{
+	mySummaryTimer.start();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+String MetricsRegistry::label(const String& name, const String& value)
+{
+	String escaped;
+	foreach(char c, value)
+	{
+		if(c == '"' || c == '\\') escaped += '\\';
+		if(c == '\n') escaped += "\\n";
+		else escaped += c;
+	}
+	return name + "=\"" + escaped + "\"";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Metric* MetricsRegistry::add(Metric* metric)
+{
+	myLock.lock();
+	foreach(Metric* m, myMetrics)
+	{
+		if(m->myName == metric->myName && m->myLabels == metric->myLabels)
+		{
+			if(m->myType != metric->myType)
+			{
+				ofwarn("MetricsRegistry: metric %1% {%2%} already registered with another type", 
+					%metric->myName %metric->myLabels);
+				break;
+			}
+			m->myRefCount++;
+			myLock.unlock();
+			delete metric;
+			return m;
+		}
+	}
+	myMetrics.push_back(metric);
+	myLock.unlock();
+	return metric;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MetricCounter* MetricsRegistry::addCounter(const String& name, const String& help, const String& labels)
+{
+	return (MetricCounter*)add(new MetricCounter(name, help, labels));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MetricGauge* MetricsRegistry::addGauge(const String& name, const String& help, const String& labels)
+{
+	return (MetricGauge*)add(new MetricGauge(name, help, labels));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MetricHistogram* MetricsRegistry::addHistogram(const String& name, const String& help, const String& labels)
+{
+	return (MetricHistogram*)add(new MetricHistogram(name, help, labels));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void MetricsRegistry::remove(Metric* metric)
+{
+	if(metric == NULL) return;
+
+	myLock.lock();
+	if(--metric->myRefCount > 0)
+	{
+		myLock.unlock();
+		return;
+	}
+	Vector<Metric*>::iterator it = std::find(myMetrics.begin(), myMetrics.end(), metric);
+	if(it != myMetrics.end()) myMetrics.erase(it);
+	myLock.unlock();
+
+	delete metric;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+String MetricsRegistry::getText()
+{
+	// Group metrics by name: the exposition format wants all samples of a
+	// metric family together, after its HELP and TYPE lines.
+	myLock.lock();
+	std::map<String, Vector<Metric*> > families;
+	foreach(Metric* m, myMetrics) families[m->getName()].push_back(m);
+
+	String text;
+	typedef std::map<String, Vector<Metric*> >::value_type Family;
+	foreach(Family& f, families)
+	{
+		Metric* first = f.second[0];
+		const char* type = "counter";
+		if(first->getType() == Metric::Gauge) type = "gauge";
+		else if(first->getType() == Metric::Histogram) type = "histogram";
+
+		text += ostr("# HELP %1% %2%\n# TYPE %1% %3%\n", %f.first %first->getHelp() %type);
+
+		foreach(Metric* m, f.second)
+		{
+			const String& labels = m->getLabels();
+			String braces = labels.empty() ? "" : "{" + labels + "}";
+			if(m->getType() == Metric::Counter)
+			{
+				text += ostr("%1%%2% %3%\n", %f.first %braces %((MetricCounter*)m)->get());
+			}
+			else if(m->getType() == Metric::Gauge)
+			{
+				text += ostr("%1%%2% %3%\n", %f.first %braces %((MetricGauge*)m)->get());
+			}
+			else
+			{
+				MetricHistogram* h = (MetricHistogram*)m;
+				String prefix = labels.empty() ? "" : labels + ",";
+				uint64 cumulative = 0;
+				for(int i = 0; i < MetricHistogram::BucketCount; i++)
+				{
+					cumulative += h->getBucket(i);
+					text += ostr("%1%_bucket{%2%le=\"%3%\"} %4%\n", 
+						%f.first %prefix %MetricHistogram::getBucketBound(i) %cumulative);
+				}
+				cumulative += h->getBucket(MetricHistogram::BucketCount);
+				text += ostr("%1%_bucket{%2%le=\"+Inf\"} %3%\n", %f.first %prefix %cumulative);
+				text += ostr("%1%_sum%2% %3%\n", %f.first %braces %h->getSum());
+				text += ostr("%1%_count%2% %3%\n", %f.first %braces %h->getCount());
+			}
+		}
+	}
+	myLock.unlock();
+	return text;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+String MetricsRegistry::getSummary()
+{
+	double interval = mySummaryTimer.getElapsedTimeInSec();
+	mySummaryTimer.start();
+
+	myLock.lock();
+	// Sum counters and gauges over their label sets, merge histograms.
+	std::map<String, Metric*> firsts;
+	std::map<String, uint64> totals;
+	std::map<String, int64> gauges;
+	foreach(Metric* m, myMetrics)
+	{
+		const String& name = m->getName();
+		if(firsts.find(name) == firsts.end()) firsts[name] = m;
+		if(m->getType() == Metric::Counter) totals[name] += ((MetricCounter*)m)->get();
+		else if(m->getType() == Metric::Gauge) gauges[name] += ((MetricGauge*)m)->get();
+	}
+
+	String summary = "Metrics:";
+	typedef std::map<String, Metric*>::value_type Item;
+	foreach(Item& item, firsts)
+	{
+		const String& name = item.first;
+		// Drop the common prefix, it adds nothing to a log line.
+		String shortName = StringUtils::startsWith(name, "omicron_") ? name.substr(8) : name;
+		Metric::Type type = item.second->getType();
+		if(type == Metric::Counter)
+		{
+			uint64 total = totals[name];
+			uint64 last = myLastTotals.find(name) != myLastTotals.end() ? myLastTotals[name] : 0;
+			myLastTotals[name] = total;
+			double rate = interval > 0 && total >= last ? (total - last) / interval : 0;
+			summary += ostr(" %1%=%2%/s", %shortName %(uint64)rate);
+		}
+		else if(type == Metric::Gauge)
+		{
+			summary += ostr(" %1%=%2%", %shortName %gauges[name]);
+		}
+		else
+		{
+			// Report the histogram with the largest p99 among the label sets:
+			// a single slow service is what the log line should point out.
+			double worstP99 = 0;
+			double sum = 0;
+			uint64 count = 0;
+			foreach(Metric* m, myMetrics)
+			{
+				if(m->getName() != name) continue;
+				MetricHistogram* h = (MetricHistogram*)m;
+				sum += h->getSum();
+				count += h->getCount();
+				worstP99 = std::max(worstP99, h->getQuantileBound(0.99));
+			}
+			double mean = count > 0 ? sum / count : 0;
+			summary += ostr(" %1%(mean=%2%us p99<=%3%us)", %shortName %(int)(mean * 1e6) %(int)(worstP99 * 1e6));
+		}
+	}
+	myLock.unlock();
+	return summary;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MetricsServer::MetricsServer():
+	myRunning(false),
+	myListenSocket(INVALID_SOCKET),
+	myLogInterval(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MetricsServer::~MetricsServer()
+{
+	stopServing();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool MetricsServer::startServing(const String& address, int port, float logInterval)
+{
+	if(myRunning) return false;
+
+	myLogInterval = logInterval;
+	myListenSocket = INVALID_SOCKET;
+
+	if(port != 0)
+	{
+#ifdef OMICRON_OS_WIN
+		WSADATA wsaData;
+#endif
+		SOCKET_INIT();
+
+		SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if(s == INVALID_SOCKET || s == SOCKET_ERROR)
+		{
+			PRINT_SOCKET_ERROR("MetricsServer: socket failed");
+			return false;
+		}
+
+		int reuse = 1;
+		setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = inet_addr(address.c_str());
+
+		if(::bind(s, (const sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR || listen(s, 4) == SOCKET_ERROR)
+		{
+			PRINT_SOCKET_ERROR("MetricsServer: bind failed");
+			SOCKET_CLOSE(s);
+			return false;
+		}
+		myListenSocket = s;
+		ofmsg("MetricsServer: serving metrics on http://%1%:%2%/metrics", %address %port);
+	}
+
+	// The summary line reads the timing metrics, so collect them all the time.
+	if(myLogInterval > 0) MetricsRegistry::getInstance()->setEnabled(true);
+	myRunning = true;
+	start();
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void MetricsServer::stopServing()
+{
+	if(!myRunning) return;
+
+	myRunning = false;
+	stop();
+	MetricsRegistry::getInstance()->setEnabled(false);
+	if(myListenSocket != INVALID_SOCKET)
+	{
+		SOCKET_CLOSE(myListenSocket);
+		myListenSocket = INVALID_SOCKET;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void MetricsServer::threadProc()
+{
+	Tracer::setThreadName("MetricsServer");
+	Timer logTimer;
+	logTimer.start();
+	while(myRunning)
+	{
+		if(myListenSocket != INVALID_SOCKET)
+		{
+			// Wake up periodically to check for shutdown and log lines.
+			fd_set readFDs;
+			FD_ZERO(&readFDs);
+			FD_SET(myListenSocket, &readFDs);
+			timeval timeout;
+			timeout.tv_sec = 0;
+			timeout.tv_usec = 100000;
+			if(select(myListenSocket + 1, &readFDs, NULL, NULL, &timeout) > 0)
+			{
+				SOCKET client = accept(myListenSocket, NULL, NULL);
+				if(client != INVALID_SOCKET && client != SOCKET_ERROR) serveClient(client);
+			}
+		}
+		else
+		{
+			osleep(100);
+		}
+
+		if(myLogInterval > 0 && logTimer.getElapsedTimeInSec() >= myLogInterval)
+		{
+			logTimer.start();
+			omsg(MetricsRegistry::getInstance()->getSummary());
+		}
+		else if(myLogInterval <= 0 && MetricsRegistry::getInstance()->isEnabled() &&
+			myScrapeTimer.getElapsedTimeInSec() >= ScrapeTimeout)
+		{
+			MetricsRegistry::getInstance()->setEnabled(false);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void MetricsServer::serveClient(SOCKET clientSocket)
+{
+	// Read the request. /trace returns the trace recorded by the Tracer, any
+	// other path returns the metrics. Do not wait more than a second for a 
+	// client that does not send anything.
+	char request[1024];
+	fd_set readFDs;
+	FD_ZERO(&readFDs);
+	FD_SET(clientSocket, &readFDs);
+	timeval timeout;
+	timeout.tv_sec = 1;
+	timeout.tv_usec = 0;
+	int length = 0;
+	if(select(clientSocket + 1, &readFDs, NULL, NULL, &timeout) <= 0 ||
+		(length = recv(clientSocket, request, sizeof(request) - 1, 0)) <= 0)
+	{
+		SOCKET_CLOSE(clientSocket);
+		return;
+	}
+	request[length] = '\0';
+
+	String body;
+	const char* contentType;
+	if(strncmp(request, "GET /trace", 10) == 0)
+	{
+		body = Tracer::getJson();
+		contentType = "application/json";
+	}
+	else
+	{
+		// Keep collecting timing metrics while someone scrapes them.
+		myScrapeTimer.start();
+		MetricsRegistry::getInstance()->setEnabled(true);
+		body = MetricsRegistry::getInstance()->getText();
+		contentType = "text/plain; version=0.0.4";
+	}
+	String response = ostr(
+		"HTTP/1.0 200 OK\r\n"
+		"Content-Type: %1%\r\n"
+		"Content-Length: %2%\r\n"
+		"Connection: close\r\n\r\n", %contentType %body.size()) + body;
+
+	const char* data = response.c_str();
+	int remaining = (int)response.size();
+	while(remaining > 0)
+	{
+		int sent = send(clientSocket, data, remaining, 0);
+		if(sent <= 0) break;
+		data += sent;
+		remaining -= sent;
+	}
+	SOCKET_CLOSE(clientSocket);
+}
@@ -31,10 +31,11 @@ class GestureService;
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Mocap Gesture Manager
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-bool MocapGestureManager::handRotateGestureTriggered = false;
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-MocapGestureManager::MocapGestureManager( Service* service )
+MocapGestureManager::MocapGestureManager( Service* service ):
+	numUsers(0),
+	updateCount(0),
+	handRotateGestureSeparationTrigger(0.4f),
+	useRadians(true)
 {
 	gestureService = service;
 	//omsg("MocapGestureManager: MocapGestureManager()");
@@ -50,286 +51,192 @@ void MocapGestureManager::setup(Setting& settings)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void MocapGestureManager::poll()
 {
-	//ofmsg("UserList size: %1%", %userList.size() );
+	//ofmsg("UserList size: %1%", %numUsers );
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-void MocapGestureManager::processEvent( const Event& e )
+int MocapGestureManager::findUser( int userID )
 {
-	if( e.getServiceType() == Service::Mocap && e.getType() == Event::Update ){
-		int userID = e.getSourceId();
-		int ID = 0;
-		Vector3f pos = e.getPosition();
-		Quaternion ori = e.getOrientation();
-		
-		Vector3f lastPos = pos;
-		Quaternion lastOri = ori;
-
-		bool useOpenNI = true;
-
-		if( useOpenNI )
-		{
+	for( int i = 0; i < numUsers; i++ )
+	{
+		if( userIDs[i] == userID ) return i;
+	}
+	return -1;
+}
 
-		// New user
-		if( userList.count(userID) == 0 )
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+int MocapGestureManager::addUser( int userID )
+{
+	int user = numUsers;
+	if( numUsers < MaxUsers )
+	{
+		numUsers++;
+	}
+	else
+	{
+		// All slots taken: replace the user that was updated least recently
+		user = 0;
+		for( int i = 1; i < MaxUsers; i++ )
 		{
-			MocapUser newUser;
-			newUser.userID = userID;
-			
-			if( !e.isExtraDataNull(Event::OMICRON_SKEL_HEAD) )
-				newUser.head.position = e.getExtraDataVector3(Event::OMICRON_SKEL_HEAD);
-			if( !e.isExtraDataNull(Event::OMICRON_SKEL_LEFT_HAND) )
-				newUser.leftHand.position = e.getExtraDataVector3(Event::OMICRON_SKEL_LEFT_HAND);
-			if( !e.isExtraDataNull(Event::OMICRON_SKEL_RIGHT_HAND) )
-				newUser.rightHand.position = e.getExtraDataVector3(Event::OMICRON_SKEL_RIGHT_HAND);
-			if( !e.isExtraDataNull(Event::OMICRON_SKEL_SPINE) )
-				newUser.spine.position = e.getExtraDataVector3(Event::OMICRON_SKEL_SPINE);
-			userList[userID] = newUser;
+			if( userLastUpdate[i] < userLastUpdate[user] ) user = i;
 		}
-		else // Existing user
-		{
-			MocapUser user = userList[userID];
-
-			// --- Get Joint Data -----------------------------------------------------------------------------------------------------
-			user.head.lastPosition = user.head.position;
-			user.leftHand.lastPosition = user.leftHand.position;
-			user.rightHand.lastPosition = user.rightHand.position;
-
-			if( !e.isExtraDataNull(Event::OMICRON_SKEL_HEAD) )
-				user.head.position = e.getExtraDataVector3(Event::OMICRON_SKEL_HEAD);
-			if( !e.isExtraDataNull(Event::OMICRON_SKEL_LEFT_HAND) )
-				user.leftHand.position = e.getExtraDataVector3(Event::OMICRON_SKEL_LEFT_HAND);
-			if( !e.isExtraDataNull(Event::OMICRON_SKEL_RIGHT_HAND) )
-				user.rightHand.position = e.getExtraDataVector3(Event::OMICRON_SKEL_RIGHT_HAND);
-			if( !e.isExtraDataNull(Event::OMICRON_SKEL_SPINE) )
-				user.spine.position = e.getExtraDataVector3(Event::OMICRON_SKEL_SPINE);
-			// ------------------------------------------------------------------------------------------------------------------------
-
-			// --- Calculations for single-handed swipe/click gestures ----------------------------------------------------------------
-			float xDiff = user.rightHand.position[0] - user.rightHand.lastPosition[0];
-			float yDiff = user.rightHand.position[1] - user.rightHand.lastPosition[1];
-			float zDiff = user.rightHand.position[2] - user.rightHand.lastPosition[2];
-			
-			float zDiff2 = user.leftHand.position[2] - user.leftHand.lastPosition[2];
-			
-			float curt = (float)((double)clock() / CLOCKS_PER_SEC);
-
-			float swipeThreshold = 0.08f;
-			float clickThreshold = 0.08f;
-			/*
-			if( -xDiff > swipeThreshold )
-				ofmsg("%1% Swipe left", %curt);
-			else if( xDiff > swipeThreshold )
-				ofmsg("%1% Swipe right", %curt);
-			else if( -yDiff > swipeThreshold )
-				ofmsg("%1% Swipe down", %curt);
-			else if( yDiff > swipeThreshold )
-				ofmsg("%1% Swipe up", %curt);
-			*/
-			// ------------------------------------------------------------------------------------------------------------------------
-
-			// Super crude text formatting
-			//omsg("\n\n\n");
-			//ofmsg("Spine pos (%1% %2% %3%)", %user.spine.position[0] %user.spine.position[1] %user.spine.position[2] );
-			//ofmsg("Left hand pos (%1% %2% %3%)", %user.leftHand.position[0] %user.leftHand.position[1] %user.leftHand.position[2] );
-			//ofmsg("Right hand pos (%1% %2% %3%)", %user.rightHand.position[0] %user.rightHand.position[1] %user.rightHand.position[2] );
-			
-
-			// --- Calculations for two-handed rotation gesture -----------------------------------------------------------------------
-			
-			float handToHandDist = sqrt( pow(user.leftHand.position[0] - user.rightHand.position[0], 2) +
-									pow(user.leftHand.position[1] - user.rightHand.position[1], 2) +
-									pow(user.leftHand.position[2] - user.rightHand.position[2], 2) );
-			Vector3f gestureRotation;
-
-			//ofmsg("Hand-to-hand distance %1% m", %handToHandDist);
-
-			if( handToHandDist <= handRotateGestureSeparationTrigger && user.leftHand.position[1] > user.spine.position[1] && user.rightHand.position[1] > user.spine.position[1] )
-			{
-				if( !handRotateGestureTriggered )
-				{
-					initialRotation[0] = 0;
-					initialRotation[1] = 0;
-					initialRotation[2] = 0;
-				}
-
-				Vector3f handMidpoint;
-				handMidpoint[0] = (user.leftHand.position[0] + user.rightHand.position[0]) / 2;
-				handMidpoint[1] = (user.leftHand.position[1] + user.rightHand.position[1]) / 2;
-				handMidpoint[2] = (user.leftHand.position[2] + user.rightHand.position[2]) / 2;
-
-				float pitch = 0;
-				float yaw = atan2( user.rightHand.position[2] - handMidpoint[2], user.rightHand.position[0] - handMidpoint[0] );
-				float roll = atan2( user.rightHand.position[1] - handMidpoint[1], user.rightHand.position[0] - handMidpoint[0] );
-
-				if( !useRadians )
-				{
-					pitch = pitch * 180 / 3.141597f;
-					yaw = yaw * 180 / 3.141597f;
-					roll = roll * 180 / 3.141597f;
-				}
-
-				gestureRotation[0] = pitch;
-				gestureRotation[1] = yaw;
-				gestureRotation[2] = roll;
-
-				if( !handRotateGestureTriggered )
-					initialRotation = gestureRotation; // NOTE: Current implementation works for only one user at a time! Fix later.
-				handRotateGestureTriggered = true;
-			}
-			else if( user.leftHand.position[1] < user.spine.position[1] && user.rightHand.position[1] < user.spine.position[1] )
-			{
-				handRotateGestureTriggered = false;
-			}
-			// ------------------------------------------------------------------------------------------------------------------------
-
-			// --- Event generation ---------------------------------------------------------------------------------------------------
-			if( handRotateGestureTriggered )
-			{
-				Vector3f handMidpoint;
-				handMidpoint[0] = (user.leftHand.position[0] + user.rightHand.position[0]) / 2;
-				handMidpoint[1] = (user.leftHand.position[1] + user.rightHand.position[1]) / 2;
-				handMidpoint[2] = (user.leftHand.position[2] + user.rightHand.position[2]) / 2;
-
-				//ofmsg("Hand center pos (%1% %2% %3%)", %handMidpoint[0] %handMidpoint[1] %handMidpoint[2] );
-
-				float pitch = 0;
-				float yaw = atan2( user.rightHand.position[2] - handMidpoint[2], user.rightHand.position[0] - handMidpoint[0] );
-				float roll = atan2( user.rightHand.position[1] - handMidpoint[1], user.rightHand.position[0] - handMidpoint[0] );
-
-				if( !useRadians )
-				{
-					pitch = pitch * 180 / 3.141597f;
-					yaw = yaw * 180 / 3.141597f;
-					roll = roll * 180 / 3.141597f;
-				}
-
-				gestureRotation[0] = pitch;
-				gestureRotation[1] = yaw;
-				gestureRotation[2] = roll;
-
-				float yawDiff = yaw - initialRotation[1];
-				float rollDiff = roll - initialRotation[2];
-
-				//ofmsg("Yaw: %1% diff: %2%", %yaw %yawDiff);
-				//ofmsg("Roll: %1% diff: %2%", %roll %rollDiff);
-
-				//omsg("Hand rotation gesture triggered");
-				generateRotateGesture( Event::Rotate, userID, Event::OMICRON_SKEL_LEFT_HAND, user.leftHand.position,
-														Event::OMICRON_SKEL_RIGHT_HAND, user.rightHand.position,
-														gestureRotation, initialRotation
-														);
-			}
-			else
-			{
-				//omsg("");
-			}
-			// ------------------------------------------------------------------------------------------------------------------------
-			//omsg("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
+	}
 
-			//float clickTimeout = 
-			if( -zDiff > clickThreshold && curt - lastClickTime > 0.5f )
-			{
-				lastClickTime = curt;
-				//ofmsg("%1% Right Click", %curt);
+	userIDs[user] = userID;
+	for( int j = 0; j < Event::OMICRON_SKEL_COUNT; j++ )
+	{
+		joints[user][j][0] = 0;
+		joints[user][j][1] = 0;
+		joints[user][j][2] = 0;
+	}
+	lastClickTime[user] = -1.0f;
+	handRotateGestureTriggered[user] = false;
+	initialRotation[user] = Vector3f::Zero();
+	return user;
+}
 
-				generateGesture( Event::Click, userID, Event::OMICRON_SKEL_RIGHT_HAND, user.rightHand.position );
-			}
-			//else if( -zDiff2 > clickThreshold )
-			//	omsg("Left Click");
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void MocapGestureManager::processEvent( const Event& e )
+{
+	if( e.getServiceType() != Service::Mocap || e.getType() != Event::Update ||
+		e.getExtraDataType() != Event::ExtraDataVector3Array ) return;
 
-			//ofmsg("RightHand pos(%1%) xDiff (%2%) ", %user.rightHand.position %xDiff );
+	int userID = e.getSourceId();
+	int user = findUser(userID);
+	bool newUser = user == -1;
+	if( newUser ) user = addUser(userID);
 
-			userList[userID] = user;
-		}
-		
-		}
-		else
-		{
-		// New user
-		if( userList.count(userID) == 0 )
+	for( int j = 0; j < Event::OMICRON_SKEL_COUNT; j++ )
+	{
+		if( !e.isExtraDataNull(j) )
 		{
-			MocapUser newUser;
-			newUser.userID = userID;
-
-			Joint newJoint;
-			newJoint.ID = ID;
-			newJoint.userID = userID;
-			newJoint.position = pos;
-			newJoint.orientation = ori;
-
-			newUser.joints[ID] = newJoint;
-
-			userList[userID] = newUser;
+			Vector3f pos = e.getExtraDataVector3(j);
+			joints[user][j][0] = pos[0];
+			joints[user][j][1] = pos[1];
+			joints[user][j][2] = pos[2];
 		}
-		else // Existing user
-		{
-			MocapUser user = userList[userID];
-
-			// New joint
-			if( user.joints.count(ID) == 0 )
-			{
-				Joint newJoint;
-				newJoint.ID = ID;
-				newJoint.userID = userID;
-				newJoint.position = pos;
-				newJoint.orientation = ori;
+	}
 
-				user.joints[ID] = newJoint;
-			}
-			else // Existing joint
-			{
-				Joint joint;
-			
-				joint.lastPosition = joint.position;
-				joint.lastOrientation = joint.orientation;
+	// Gestures compare a skeleton against the previous one, so they start
+	// with the second update of a user.
+	if( !newUser ) updateGestures(user);
+	lastRightHandZ[user] = joints[user][Event::OMICRON_SKEL_RIGHT_HAND][2];
+	userLastUpdate[user] = ++updateCount;
+}
 
-				joint.position = pos;
-				joint.orientation = ori;
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void MocapGestureManager::updateGestures( int i )
+{
+	const int l = Event::OMICRON_SKEL_LEFT_HAND;
+	const int r = Event::OMICRON_SKEL_RIGHT_HAND;
+	Vector3f leftHand(joints[i][l][0], joints[i][l][1], joints[i][l][2]);
+	Vector3f rightHand(joints[i][r][0], joints[i][r][1], joints[i][r][2]);
+	float spineY = joints[i][Event::OMICRON_SKEL_SPINE][1];
+
+	float curt = (float)otime();
+	float clickThreshold = 0.08f;
+	float maxHandDistance2 = handRotateGestureSeparationTrigger * handRotateGestureSeparationTrigger;
+
+	// --- Two-handed rotation gesture ------------------------------------------------------------------------------------
+	bool handsTogether = (leftHand - rightHand).squaredNorm() <= maxHandDistance2 &&
+		leftHand[1] > spineY && rightHand[1] > spineY;
+	if( handsTogether || handRotateGestureTriggered[i] )
+	{
+		// Rotation of the right hand around the midpoint between the hands
+		Vector3f handMidpoint = (leftHand + rightHand) * 0.5f;
+
+		float pitch = 0;
+		float yaw = atan2( rightHand[2] - handMidpoint[2], rightHand[0] - handMidpoint[0] );
+		float roll = atan2( rightHand[1] - handMidpoint[1], rightHand[0] - handMidpoint[0] );
+
+		if( !useRadians )
+		{
+			pitch = pitch * 180 / 3.141597f;
+			yaw = yaw * 180 / 3.141597f;
+			roll = roll * 180 / 3.141597f;
+		}
 
-				user.joints[ID] = joint;
-				lastPos = joint.lastPosition;
-				lastOri = joint.lastOrientation;
-			}
+		Vector3f gestureRotation(pitch, yaw, roll);
+		if( !handRotateGestureTriggered[i] ) initialRotation[i] = gestureRotation;
+		if( handsTogether ) handRotateGestureTriggered[i] = true;
+		else if( leftHand[1] < spineY && rightHand[1] < spineY ) handRotateGestureTriggered[i] = false;
 
-			userList[userID] = user;
-		}
+		if( handRotateGestureTriggered[i] )
+		{
+			generateRotateGesture( Event::Rotate, userIDs[i], Event::OMICRON_SKEL_LEFT_HAND, leftHand,
+													Event::OMICRON_SKEL_RIGHT_HAND, rightHand,
+													gestureRotation, initialRotation[i]
+													);
 		}
 	}
+	// ------------------------------------------------------------------------------------------------------------------------
+
+	// --- Single-handed click gesture ----------------------------------------------------------------------------------
+	if( lastRightHandZ[i] - rightHand[2] > clickThreshold && curt - lastClickTime[i] > 0.5f )
+	{
+		lastClickTime[i] = curt;
+		generateGesture( Event::Click, userIDs[i], Event::OMICRON_SKEL_RIGHT_HAND, rightHand );
+	}
+	// ------------------------------------------------------------------------------------------------------------------------
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void MocapGestureManager::generateGesture( Event::Type gesture, int userID, int jointID, Vector3f position )
 {
-	Event* evt;
-
-	evt = gestureService->writeHead();
-	evt->reset(gesture, Service::Mocap, userID);
-	evt->setPosition(position);
-	
-	evt->setExtraDataType(Event::ExtraDataIntArray);
-	evt->setExtraDataInt(0, jointID);
-	gestureService->unlockEvents();
+	MocapGesture g;
+	g.type = gesture;
+	g.userID = userID;
+	g.jointID[0] = jointID;
+	g.position[0] = position;
+	g.isRotate = false;
+	pendingGestures.push_back(g);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void MocapGestureManager::generateRotateGesture( Event::Type gesture, int userID, int jointID_0, Vector3f position_0, int jointID_1, Vector3f position_1, Vector3f rotation, Vector3f initRotation )
 {
-	Vector3f handMidpoint;
-	handMidpoint[0] = (position_0[0] + position_1[0]) / 2;
-	handMidpoint[1] = (position_0[1] + position_1[1]) / 2;
-	handMidpoint[2] = (position_0[2] + position_1[2]) / 2;
-
-	Event* evt;
+	MocapGesture g;
+	g.type = gesture;
+	g.userID = userID;
+	g.jointID[0] = jointID_0;
+	g.jointID[1] = jointID_1;
+	g.position[0] = position_0;
+	g.position[1] = position_1;
+	g.rotation = rotation;
+	g.initialRotation = initRotation;
+	g.isRotate = true;
+	pendingGestures.push_back(g);
+}
 
-	evt = gestureService->writeHead();
-	evt->reset(gesture, Service::Mocap, userID);
-	evt->setPosition(handMidpoint);
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void MocapGestureManager::flushGestures()
+{
+	if( pendingGestures.empty() ) return;
+
+	gestureService->lockEvents();
+	foreach( const MocapGesture& g, pendingGestures )
+	{
+		Event* evt = gestureService->writeHead();
+		evt->reset(g.type, Service::Mocap, g.userID);
+		if( g.isRotate )
+		{
+			Vector3f handMidpoint = (g.position[0] + g.position[1]) * 0.5f;
+			evt->setPosition(handMidpoint);
 	
-	evt->setExtraDataType(Event::ExtraDataVector3Array);
-	evt->setExtraDataVector3(0, position_0);
-	evt->setExtraDataVector3(1, position_1);
-	evt->setExtraDataVector3(2, rotation);
-	evt->setExtraDataVector3(3, initRotation);
+			evt->setExtraDataType(Event::ExtraDataVector3Array);
+			evt->setExtraDataVector3(0, g.position[0]);
+			evt->setExtraDataVector3(1, g.position[1]);
+			evt->setExtraDataVector3(2, g.rotation);
+			evt->setExtraDataVector3(3, g.initialRotation);
+		}
+		else
+		{
+			evt->setPosition(g.position[0]);
+	
+			evt->setExtraDataType(Event::ExtraDataIntArray);
+			evt->setExtraDataInt(0, g.jointID[0]);
+		}
+	}
 	gestureService->unlockEvents();
+	pendingGestures.clear();
 }
\ No newline at end of file
@@ -36,6 +36,7 @@ NetService::NetService()
 	mysInstance = this;
 	myClient = new omicronConnector::OmicronConnectorClient(this);
 	connected = false;
+	streamClient = NULL;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -52,13 +53,13 @@ void NetService::setup(Setting& settings)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void NetService::initialize() 
 {
-	init = clock();
+	init = otime();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void NetService::poll()
 {
-	timer = (clock() - init) / (double)CLOCKS_PER_SEC;
+	timer = otime() - init;
 
 	if( !connected )
 	{
@@ -66,7 +67,10 @@ void NetService::poll()
 		if (dataStreamOut)
 		{
 			connected = myClient->connect(serverAddress.c_str(), serverPort, dataPort, 1);
-			streamClient = new NetClient(serverAddress.c_str(), dataPort);
+			if (streamClient == NULL)
+			{
+				streamClient = new NetClient(serverAddress.c_str(), dataPort);
+			}
 		}
 		else
 		{
@@ -86,6 +90,9 @@ void NetService::poll()
 	{
 		ServiceManager* serviceManager = mysInstance->getManager();
 		int eventCount = serviceManager->getAvailableEvents();
+
+		// Encode the events while holding the event list lock, then release
+		// it before sending so services are not blocked by socket writes.
 		serviceManager->lockEvents(); // Lock the main event list
 		for (int evtNum = 0; evtNum < eventCount; evtNum++)
 		{
@@ -100,21 +107,13 @@ void NetService::poll()
 					printf("NetService: Data out: (id, x, y, z) %d %f %f %f\n", e->getSourceId(), e->getPosition().x(), e->getPosition().y(), e->getPosition().z());
 				}
 
-				char* eventPacket = InputServer::createOmicronPacketFromEvent(e);
-
-				if (e->isExtraDataLarge())
-				{
-					streamClient->sendEvent(eventPacket, DEFAULT_LRGBUFLEN);
-				}
-				else
-				{
-					streamClient->sendEvent(eventPacket, DEFAULT_BUFLEN);
-				}
-
-				delete eventPacket;
+				myPacketBatch.add(e);
 			}
 		}
 		serviceManager->unlockEvents();
+
+		myPacketBatch.send(streamClient);
+		myPacketBatch.clear();
 	}
 
 	// Pings
@@ -128,9 +127,11 @@ void NetService::poll()
 			if (dataStreamOut)
 			{
 				streamClient->dispose();
+				delete streamClient;
+				streamClient = NULL;
 			}
 		}
-		init = clock();
+		init = otime();
 	}
 
 	myClient->poll();
@@ -87,6 +87,23 @@ void PQService::setup(Setting& settings)
 		hasCustomRawDataResolution = true;
 		rawDataResolution = Config::getVector2iValue("rawDataResolution", settings, Vector2i(1920,1080) );
 	}
+
+	// Records touch frames for replay with the touchtrace tool
+	touchTraceFile = NULL;
+	String traceFileName = Config::getStringValue("touchTraceFile", settings, "");
+	if(!traceFileName.empty())
+	{
+		touchTraceFile = fopen(traceFileName.c_str(), "w");
+		if(touchTraceFile != NULL)
+		{
+			fprintf(touchTraceFile, "time,type,id,x,y,w,h\n");
+			ofmsg("PQService: Recording touch trace to %1%", %traceFileName);
+		}
+		else
+		{
+			ofwarn("PQService: Could not open touch trace file %1%", %traceFileName);
+		}
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -390,10 +407,7 @@ void PQService::OnReceivePointFrame(int frame_id, int time_stamp, int moving_poi
 	};
 
 	//printf(" frame_id:" << frame_id << " time:"  << time_stamp << " ms" << " moving point count:" << moving_point_count << endl;
-	for(int i = 0; i < moving_point_count; ++ i){
-		TouchPoint tp = moving_point_array[i];
-		pqService->OnTouchPoint(tp);
-	}
+	pqService->OnTouchFrame(moving_point_array, moving_point_count);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -446,95 +460,125 @@ void PQService::OnGetServerResolution(int x, int y, void * call_back_object)
 //	you can do mouse map like "OnTG_Down" etc;
 void PQService::OnTouchPoint(const TouchPoint & tp)
 {
-	timeb tb;
-	ftime( &tb );
-	int timestamp = tb.millitm + (tb.time & 0xfffff) * 1000;
+	OnTouchFrame(&tp, 1);
+}
 
-	int tEvent = tp.point_event;
-	int xWidth = tp.dx;
-	int yWidth = tp.dy;
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Handles a frame of touch points with a single gesture manager update and a
+// single event lock, so the cost of a frame does not depend on lock traffic.
+void PQService::OnTouchFrame(const TouchPoint * points, int count)
+{
+	if(!mysInstance) return;
 
-	
+	int timestamp = otimestamp();
+
+	frameTouches.resize(count);
+	frameEventTypes.resize(count);
+
+	float xScale = 1.0f / serverResolution[0];
+	float yScale = 1.0f / serverResolution[1];
+	float xOffset = (float)touchOffset[0];
+	float yOffset = (float)touchOffset[1];
+
+	// Normalize the frame and assign touch IDs
+	int numTouches = 0;
+	for(int i = 0; i < count; i++)
+	{
+		const TouchPoint& tp = points[i];
+		if(tp.dx > maxBlobSize || tp.dy > maxBlobSize || tp.id >= maxTouches) continue;
+
+		Event::Type type;
+		switch(tp.point_event)
+		{
+			case TP_DOWN: type = Event::Down; break;
+			case TP_MOVE: type = Event::Move; break;
+			case TP_UP: type = Event::Up; break;
+			default: continue;
+		}
 
-	if(mysInstance && xWidth <= maxBlobSize && yWidth <= maxBlobSize)
-	{		
-		Touch touch;
-		
 		// PQService management of IDs
 		// Basically PQ IDs recycle after the ID is done. OmegaLib increments IDs
 		// until max ID is reached.
+		if (type == Event::Down)
+		{
+			touchID[tp.id] = nextID;
+			if (nextID < maxTouches - 100) {
+				nextID++;
+			}
+			else {
+				nextID = 0;
+			}
+		}
+
+		Touch& touch = frameTouches[numTouches];
 		touch.ID = touchID[tp.id];
 		touch.groupID = touch.ID;
+		touch.xPos = (tp.x + xOffset) * xScale;
+		touch.yPos = (tp.y + yOffset) * yScale;
+		touch.xWidth = tp.dx * xScale;
+		touch.yWidth = tp.dy * yScale;
+		touch.timestamp = timestamp;
+		frameEventTypes[numTouches] = type;
+		numTouches++;
+
 		if( debugRawPQInfo )
 		{
 			ofmsg("PQService: Incoming touch point ID: %1% type: %6% at (%2%,%3%) size: (%4%,%5%)", %touch.ID %tp.x %tp.y %tp.dx %tp.dy %tp.point_event);
 		}
+	}
+	if(numTouches == 0) return;
 
-		touch.xPos = (tp.x + touchOffset[0]) / (float)serverResolution[0];
-		touch.yPos = (tp.y + touchOffset[1]) / (float)serverResolution[1];
-		touch.xWidth = tp.dx / (float)serverResolution[0];
-		touch.yWidth = tp.dy / (float)serverResolution[1];
+	if( touchTraceFile != NULL )
+	{
+		for(int i = 0; i < numTouches; i++)
+		{
+			const Touch& touch = frameTouches[i];
+			const char* typeName = frameEventTypes[i] == Event::Down ? "down" : (frameEventTypes[i] == Event::Move ? "move" : "up");
+			fprintf(touchTraceFile, "%d,%s,%d,%f,%f,%f,%f\n", timestamp, typeName, touch.ID, touch.xPos, touch.yPos, touch.xWidth, touch.yWidth);
+		}
+	}
 
-		touch.timestamp = timestamp;
+	// Process touch gestures (this is done outside event creation
+	// for the case touchGestureManager needs to create an event)
+	if( useGestureManager )
+	{
+		touchGestureManager->addTouches(frameEventTypes.data(), frameTouches.data(), numTouches);
+	}
+
+	// Moves smaller than the move threshold still keep the gesture manager
+	// touches alive, but do not generate events.
+	float xThreshold = move_threshold * xScale;
+	float yThreshold = move_threshold * yScale;
+
+	mysInstance->lockEvents();
+	for(int i = 0; i < numTouches; i++)
+	{
+		const Touch& touch = frameTouches[i];
+		Event::Type type = frameEventTypes[i];
 
-		if (tp.point_event == TP_DOWN)
+		if(type == Event::Move)
 		{
-			touch.ID = nextID;
-			touch.groupID = touch.ID;
-			touchID[tp.id] = nextID;
-			if (nextID < maxTouches - 100) {
-				nextID++;
-			}
-			else {
-				nextID = 0;
-			}
+			std::map<int,Touch>::iterator it = touchlist.find(touch.ID);
+			if(it != touchlist.end() &&
+				fabs(touch.xPos - it->second.xPos) < xThreshold &&
+				fabs(touch.yPos - it->second.yPos) < yThreshold) continue;
 		}
 
-		// Process touch gestures (this is done outside event creation
-		// for the case touchGestureManager needs to create an event)
-		if( useGestureManager ){
-			switch(tp.point_event)
-			{
-				case TP_DOWN:
-					touchGestureManager->addTouch( Event::Down, touch );
-					break;
-				case TP_MOVE:
-					touchGestureManager->addTouch( Event::Move, touch );
-					break;
-				case TP_UP:
-					touchGestureManager->addTouch( Event::Up, touch );
-					break;
-			}
-			
+		if(type == Event::Up)
+		{
+			touchlist.erase( touch.ID );
+		}
+		else
+		{
+			touchlist[touch.ID] = touch;
 		}
-		mysInstance->lockEvents();
 
 		Event* evt = mysInstance->writeHead();
-		switch(tp.point_event)
+		evt->reset(type, Service::Pointer, touch.ID);
+		if (isDebugEnabled())
 		{
-			case TP_DOWN:
-				evt->reset(Event::Down, Service::Pointer, touch.ID);
-				if (isDebugEnabled())
-				{
-					ofmsg("PQService: Touch ID: %1% as DOWN event at (%2%,%3%) size: (%4%,%5%)", %touch.ID %touch.xPos %touch.yPos %touch.xWidth %touch.yWidth);
-				}
-				break;
-			case TP_MOVE:
-				evt->reset(Event::Move, Service::Pointer, touch.ID);
-				touchlist[touch.ID] = touch;
-				if (isDebugEnabled())
-				{
-					ofmsg("PQService: Touch ID: %1% as MOVE event at (%2%,%3%) size: (%4%,%5%)", %touch.ID %touch.xPos %touch.yPos %touch.xWidth %touch.yWidth);
-				}
-				break;
-			case TP_UP:
-				evt->reset(Event::Up, Service::Pointer, touch.ID);
-				touchlist.erase( touch.ID );
-				if (isDebugEnabled())
-				{
-					ofmsg("PQService: Touch ID: %1% as UP event at (%2%,%3%) size: (%4%,%5%)", %touch.ID %touch.xPos %touch.yPos %touch.xWidth %touch.yWidth);
-				}
-				break;
+			const char* typeName = type == Event::Down ? "DOWN" : (type == Event::Move ? "MOVE" : "UP");
+			ofmsg("PQService: Touch ID: %1% as %2% event at (%3%,%4%) size: (%5%,%6%)", %touch.ID %typeName %touch.xPos %touch.yPos %touch.xWidth %touch.yWidth);
 		}
 
 		evt->setPosition(touch.xPos, touch.yPos);
@@ -542,16 +586,22 @@ void PQService::OnTouchPoint(const TouchPoint & tp)
 		evt->setExtraDataType(Event::ExtraDataFloatArray);
 		evt->setExtraDataFloat(0, touch.xWidth);
 		evt->setExtraDataFloat(1, touch.yWidth);
-
-		//printf(" Server %d,%d Screen %d, %d\n", serverX, serverY, screenX, screenY );
-		//printf("      at %d,%d\n", tp.x, tp.y);
-		mysInstance->unlockEvents();
 	}
+	mysInstance->unlockEvents();
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void PQService::dispose() 
 {
+	if( useGestureManager )
+	{
+		touchGestureManager->stopThread();
+	}
+	if( touchTraceFile != NULL )
+	{
+		fclose(touchTraceFile);
+		touchTraceFile = NULL;
+	}
 	mysInstance = NULL;
 #ifdef OMICRON_OS_WIN
 	DisconnectServer();
@@ -85,7 +85,7 @@ void PSMoveService::poll()
 {
     static float lastt;
     static float checkControllerLastt;
-    float curt = (float)((double)clock() / CLOCKS_PER_SEC);
+    float curt = (float)otime();
     if(curt - lastt <= myUpdateInterval)
     {
         return;
@@ -0,0 +1,215 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A service that replays events recorded in an event journal.
+ ******************************************************************************/
+#include "omicron/PlaybackService.h"
+#include "omicron/StringUtils.h"
+#include "omicron/DataManager.h"
+
+using namespace omicron;
+
+///////////////////////////////////////////////////////////////////////////////
+PlaybackService::PlaybackService():
+	mySpeed(1.0f),
+	myLoop(false),
+	myStartTime(0),
+	myMaxEventsPerPoll(1024),
+	mySourceIdOffset(0),
+	myTimeOrigin(0),
+	myUseVirtualClock(false),
+	myClockOrigin(0),
+	myHasPending(false),
+	myPendingExtraData(NULL),
+	myFinished(false),
+	myPlayedEvents(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PlaybackService::setup(Setting& settings)
+{
+	myFilename = Config::getStringValue("file", settings, "");
+	mySpeed = Config::getFloatValue("speed", settings, 1.0f);
+	myLoop = Config::getBoolValue("loop", settings, false);
+	myStartTime = (uint64)(Config::getFloatValue("startTime", settings, 0.0f) * 1000000.0);
+	myMaxEventsPerPoll = Config::getIntValue("maxEventsPerPoll", settings, 1024);
+	mySourceIdOffset = Config::getIntValue("sourceIdOffset", settings, 0);
+	myUseVirtualClock = Config::getBoolValue("virtualClock", settings, false);
+
+	mySourceIdMap.clear();
+	if(settings.exists("sourceIdMap"))
+	{
+		Setting& smap = settings["sourceIdMap"];
+		for(int i = 0; i < smap.getLength(); i++)
+		{
+			Setting& pair = smap[i];
+			if(pair.getLength() != 2)
+			{
+				owarn("PlaybackService: sourceIdMap entries must be [from, to] pairs");
+				continue;
+			}
+			mySourceIdMap[(uint)Config::getIntValue(0, pair)] = (uint)Config::getIntValue(1, pair);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PlaybackService::initialize()
+{
+	String path;
+	if(!DataManager::findFile(myFilename, path)) path = myFilename;
+
+	if(!myReader.open(path))
+	{
+		ofwarn("PlaybackService: could not open journal %1%", %myFilename);
+		return;
+	}
+
+	const EventJournal::IndexEntry* last = myReader.getBlockCount() > 0 ? 
+		&myReader.getBlock(myReader.getBlockCount() - 1) : NULL;
+	ofmsg("PlaybackService: playing %1% (%2% blocks, %3% seconds) at speed %4%", 
+		%myFilename %myReader.getBlockCount() %(last != NULL ? last->lastTime / 1000000.0 : 0.0) %mySpeed);
+
+	if(myUseVirtualClock)
+	{
+		// Start the clock at the recording wall clock time.
+		myClock.setTime(myReader.getFileHeader().creationTime * 1000000 + myStartTime);
+		osetclock(&myClock);
+		omsg("PlaybackService: using the journal virtual clock");
+	}
+
+	restart();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PlaybackService::dispose()
+{
+	if(ogetclock() == &myClock) osetclock(NULL);
+	myReader.close();
+	myHasPending = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PlaybackService::setClock(uint64 journalTime)
+{
+	// Never move the clock backwards.
+	uint64 time = myClockOrigin + journalTime;
+	if(time > myClock.getTime()) myClock.setTime(time);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PlaybackService::restart()
+{
+	if(!myReader.isOpen()) return;
+
+	myReader.seekTime(myStartTime);
+	myTimeOrigin = myStartTime;
+	// When looping, keep the clock going forward from where it is.
+	if(myUseVirtualClock) myClockOrigin = myClock.getTime() - myStartTime;
+	myTimer.start();
+	myFinished = false;
+	myHasPending = myReader.next(&myPending, &myPendingExtraData);
+	if(!myHasPending)
+	{
+		owarn("PlaybackService: nothing to play back");
+		myFinished = true;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool PlaybackService::readNext()
+{
+	myHasPending = myReader.next(&myPending, &myPendingExtraData);
+	if(!myHasPending)
+	{
+		if(myLoop)
+		{
+			restart();
+		}
+		else
+		{
+			omsg("PlaybackService: playback finished");
+			myFinished = true;
+		}
+	}
+	return myHasPending;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint PlaybackService::mapSourceId(uint sourceId)
+{
+	Dictionary<uint, uint>::iterator it = mySourceIdMap.find(sourceId);
+	if(it != mySourceIdMap.end()) return it->second;
+	return sourceId + mySourceIdOffset;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PlaybackService::poll()
+{
+	if(myFinished || !myHasPending) return;
+
+	// Journal time we are allowed to play up to.
+	bool unlimited = mySpeed <= 0.0f;
+	uint64 now = myTimeOrigin + (uint64)(myTimer.getElapsedTimeInMicroSec() * mySpeed);
+
+	int count = 0;
+	bool locked = false;
+	while(myHasPending && count < myMaxEventsPerPoll && 
+		(unlimited || myPending.time <= now))
+	{
+		if(!locked)
+		{
+			lockEvents();
+			locked = true;
+		}
+		if(myUseVirtualClock) setClock(myPending.time);
+		Event* evt = writeHead();
+		EventJournal::readRecord(myPending, myPendingExtraData, evt);
+		evt->resetSourceId(mapSourceId(myPending.sourceId));
+		count++;
+
+		// After a loop restart, stop here and let timing start over.
+		uint64 time = myPending.time;
+		if(!readNext() || myPending.time < time) break;
+	}
+	if(locked) unlockEvents();
+	myPlayedEvents += count;
+
+	// Let time pass between events too, so timeouts expire like they did 
+	// during the recording.
+	if(myUseVirtualClock && !unlimited && !myFinished)
+	{
+		setClock(myHasPending && myPending.time < now ? myPending.time : now);
+	}
+}
@@ -0,0 +1,148 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	Pointer position smoothing (One Euro filter) and latency compensation,
+ *  applied by the service manager to the events of a service.
+ ******************************************************************************/
+#include "omicron/PointerFilter.h"
+#include "omicron/Config.h"
+
+using namespace omicron;
+
+const uint PointerFilter::MaxIndexedSources;
+
+///////////////////////////////////////////////////////////////////////////////
+// Smoothing factor of an exponential filter with the given cutoff frequency
+static inline float smoothingFactor(float cutoff, float dt)
+{
+	float tau = 1.0f / (2.0f * (float)Math::Pi * cutoff);
+	return 1.0f / (1.0f + tau / dt);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+PointerFilter::PointerFilter():
+	myMinCutoff(1.0f),
+	myBeta(0.0f),
+	myDerivativeCutoff(1.0f),
+	myPrediction(0.0f)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PointerFilter::setup(const Setting& settings)
+{
+	myMinCutoff = Config::getFloatValue("minCutoff", settings, 1.0f);
+	myBeta = Config::getFloatValue("beta", settings, 0.0f);
+	myDerivativeCutoff = Config::getFloatValue("derivativeCutoff", settings, 1.0f);
+	myPrediction = Config::getFloatValue("prediction", settings, 0.0f);
+
+	if(myMinCutoff <= 0) myMinCutoff = 1.0f;
+	if(myDerivativeCutoff <= 0) myDerivativeCutoff = 1.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PointerFilter::reset()
+{
+	myIndexedSources.clear();
+	myMappedSources.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+PointerFilter::SourceState* PointerFilter::getSourceState(uint sourceId)
+{
+	if(sourceId < MaxIndexedSources)
+	{
+		if(sourceId >= myIndexedSources.size())
+		{
+			SourceState inactive = { false, 0, 0, 0, 0, 0 };
+			myIndexedSources.resize(sourceId + 1, inactive);
+		}
+		return &myIndexedSources[sourceId];
+	}
+
+	Dictionary<uint, SourceState>::iterator it = myMappedSources.find(sourceId);
+	if(it == myMappedSources.end())
+	{
+		SourceState inactive = { false, 0, 0, 0, 0, 0 };
+		it = myMappedSources.insert(std::make_pair(sourceId, inactive)).first;
+	}
+	return &it->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void PointerFilter::filter(Event& evt)
+{
+	Event::Type type = evt.getType();
+	if(type != Event::Down && type != Event::Move && type != Event::Update && type != Event::Up) return;
+	// Gesture events reuse the source id of the touch that started them
+	if(evt.getFlags() >= (uint)EventBase::User) return;
+
+	SourceState* s = getSourceState(evt.getSourceId());
+	const Vector3f& pos = evt.getPosition();
+	float x = pos.x();
+	float y = pos.y();
+	int timestamp = (int)evt.getTimestamp();
+
+	// Timestamps go back when otimestamp() wraps or a playback clock is set:
+	// restart the source then, as it may never send a Down.
+	if(type == Event::Down || !s->active || timestamp < s->timestamp)
+	{
+		// First sample: nothing to smooth or predict yet
+		s->active = true;
+		s->timestamp = timestamp;
+		s->x = x;
+		s->y = y;
+		s->dx = 0;
+		s->dy = 0;
+	}
+	else if(timestamp > s->timestamp)
+	{
+		float dt = (timestamp - s->timestamp) / 1000.0f;
+		s->timestamp = timestamp;
+
+		// Speed, smoothed with a fixed cutoff
+		float ad = smoothingFactor(myDerivativeCutoff, dt);
+		s->dx += ad * ((x - s->x) / dt - s->dx);
+		s->dy += ad * ((y - s->y) / dt - s->dy);
+
+		// Position, smoothed less as the speed grows
+		s->x += smoothingFactor(myMinCutoff + myBeta * fabs(s->dx), dt) * (x - s->x);
+		s->y += smoothingFactor(myMinCutoff + myBeta * fabs(s->dy), dt) * (y - s->y);
+	}
+	// A sample with no time elapsed since the previous one gives no speed
+	// information: it gets the current estimate and leaves the state alone.
+
+	evt.setPosition(s->x + s->dx * myPrediction, s->y + s->dy * myPrediction, pos.z());
+
+	if(type == Event::Up) s->active = false;
+}
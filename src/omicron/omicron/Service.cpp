@@ -36,10 +36,21 @@
  ******************************************************************************/
 #include "omicron/Service.h"
 #include "omicron/ServiceManager.h"
+#include "omicron/Metrics.h"
+#include "omicron/PointerFilter.h"
+#include "omicron/Trace.h"
 #include "omicron/StringUtils.h"
 
 using namespace omicron;
 
+///////////////////////////////////////////////////////////////////////////////
+Service::~Service()
+{
+	MetricsRegistry::getInstance()->remove(myEventsMetric);
+	MetricsRegistry::getInstance()->remove(myPollTimeMetric);
+	delete myPointerFilter;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void Service::doSetup(ServiceManager* mng, Setting& settings)
 {
@@ -61,6 +72,13 @@ void Service::doSetup(ServiceManager* mng, Setting& settings)
 		myDebug = (bool)settings["debug"];
 	}
 
+	// Optional pointer position filter, applied by the service manager.
+	if(settings.exists("pointerFilter"))
+	{
+		if(myPointerFilter == NULL) myPointerFilter = new PointerFilter();
+		myPointerFilter->setup(settings["pointerFilter"]);
+	}
+
 	// call service specific setup method
 	setup(settings);
 }
@@ -72,6 +90,16 @@ void Service::doInitialize(ServiceManager* mng, int serviceId)
 	if(!myInitialized)
 	{
 		myId = serviceId;
+		// Services added programmatically may not have a name.
+		String name = myName.empty() ? ostr("service%1%", %serviceId) : myName;
+		myTraceName = Tracer::intern(name);
+		if(myEventsMetric == NULL)
+		{
+			String label = MetricsRegistry::label("service", name);
+			MetricsRegistry* mr = MetricsRegistry::getInstance();
+			myEventsMetric = mr->addCounter("omicron_service_events_total", "Events produced by the service.", label);
+			myPollTimeMetric = mr->addHistogram("omicron_service_poll_seconds", "Time spent in the service poll method.", label);
+		}
 		initialize();
 	}
 	else
@@ -96,6 +124,7 @@ void Service::unlockEvents()
 Event* Service::writeHead()
 { 
 	Event* evt = myManager->writeHead();
+	if(myEventsMetric != NULL) myEventsMetric->add();
 	
     // By default, set the device tag to the service id. Service code can then
     // change this to a custom service id and/or attach a user id using event::reset.
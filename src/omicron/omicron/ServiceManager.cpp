@@ -35,12 +35,17 @@
  ******************************************************************************/
 #include "omicron/ServiceManager.h"
 #include "omicron/StringUtils.h"
+#include "omicron/Metrics.h"
+#include "omicron/Trace.h"
+#include "omicron/PointerFilter.h"
 
 // Input services
 #include "omicron/HeartbeatService.h"
 #include "omicron/WandService.h"
 #include "omicron/SagePointerService.h"
 #include "omicron/GestureService.h"
+#include "omicron/PlaybackService.h"
+#include "omicron/LoadGeneratorService.h"
 
 // NOTE: OSCService needs to be included before NetService to avoid template
 // errors within osc/udp.h
@@ -104,21 +109,34 @@ const int ServiceManager::MaxEvents = OMICRON_MAX_EVENTS;
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ServiceManager::ServiceManager():
 	myInitialized(false),
+	myServiceIdCounter(0),
 	myEventBuffer(NULL),
 	myEventBufferHead(0),
 	myEventBufferTail(0),
 	myAvailableEvents(0),
 	myDroppedEvents(0),
-	myServiceIdCounter(0)
+	myUnfilteredEvents(0),
+	myEventSequence(0)
 {
 	myEventBufferLock = new Lock();
 	registerDefaultServices();
+
+	MetricsRegistry* mr = MetricsRegistry::getInstance();
+	myRingCapacityMetric = mr->addGauge("omicron_event_ring_capacity", "Size of the service manager event buffer.");
+	myRingOccupancyMetric = mr->addGauge("omicron_event_ring_occupancy", "Events queued in the service manager event buffer.");
+	myDroppedEventsMetric = mr->addCounter("omicron_event_ring_dropped_total", "Events overwritten before being read, because the event buffer was full.");
+	myRingCapacityMetric->set(MaxEvents);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ServiceManager::~ServiceManager()
 {
 	delete myEventBufferLock;
+
+	MetricsRegistry* mr = MetricsRegistry::getInstance();
+	mr->remove(myRingCapacityMetric);
+	mr->remove(myRingOccupancyMetric);
+	mr->remove(myDroppedEventsMetric);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -129,6 +147,8 @@ void ServiceManager::registerDefaultServices()
 	registerService("WandService", (ServiceAllocator)WandService::New);
 	registerService("SagePointerService", (ServiceAllocator)SagePointerService::New);
 	registerService("GestureService", (ServiceAllocator)GestureService::New);
+	registerService("PlaybackService", (ServiceAllocator)PlaybackService::New);
+	registerService("LoadGeneratorService", (ServiceAllocator)LoadGeneratorService::New);
 
 #ifdef OMICRON_USE_DIRECTINPUT
 	registerService("XInputService", (ServiceAllocator)XInputService::New);
@@ -248,6 +268,7 @@ void ServiceManager::initialize()
 		it->doInitialize(this, myServiceIdCounter);
 		myServiceIdCounter++;
 	}
+	updatePointerFilters();
 
 	myInitialized = true;
 }
@@ -261,6 +282,7 @@ void ServiceManager::dispose()
 	}
 
 	myServices.clear();
+	myPointerFilters.clear();
 
 	delete[] myEventBuffer;
 }
@@ -286,15 +308,80 @@ void ServiceManager::stop()
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 void ServiceManager::poll()
 {
+	// Only time services when someone is reading the metrics.
+	bool timed = MetricsRegistry::getInstance()->isEnabled();
 	for(int pollPriority = Service::PollFirst; pollPriority <= Service::PollLast; pollPriority++)
 	{
 		foreach(Service* svc, myServices)
 		{
-			if(svc->getPollPriority() == pollPriority) svc->poll();
+			if(svc->getPollPriority() == pollPriority)
+			{
+				TraceScope trace(svc->myTraceName, "service");
+				if(timed && svc->myPollTimeMetric != NULL)
+				{
+					myPollTimer.start();
+					svc->poll();
+					svc->myPollTimeMetric->observe(myPollTimer.getElapsedTimeInMicroSec() / 1000000.0);
+				}
+				else
+				{
+					svc->poll();
+				}
+			}
+		}
+	}
+
+	if(!myPointerFilters.empty())
+	{
+		lockEvents();
+		filterPointerEvents();
+		unlockEvents();
+	}
+
+	myRingOccupancyMetric->set(myAvailableEvents);
+	myDroppedEventsMetric->set(myDroppedEvents);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void ServiceManager::updatePointerFilters()
+{
+	myPointerFilters.clear();
+	foreach(Service* svc, myServices)
+	{
+		PointerFilter* filter = svc->getPointerFilter();
+		if(filter != NULL)
+		{
+			int id = svc->getServiceId();
+			if(id >= (int)myPointerFilters.size()) myPointerFilters.resize(id + 1, NULL);
+			myPointerFilters[id] = filter;
 		}
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Filters the pointer events written since the last call, in order. Called 
+// with the event lock held.
+void ServiceManager::filterPointerEvents()
+{
+	if(!myPointerFilters.empty())
+	{
+		int index = myEventBufferHead - myUnfilteredEvents;
+		if(index < 0) index += MaxEvents;
+		for(int i = 0; i < myUnfilteredEvents; i++)
+		{
+			Event& evt = myEventBuffer[index];
+			uint serviceId = evt.getServiceId();
+			if(evt.getServiceType() == Service::Pointer && 
+				serviceId < myPointerFilters.size() && myPointerFilters[serviceId] != NULL)
+			{
+				myPointerFilters[serviceId]->filter(evt);
+			}
+			index = incrementBufferIndex(index);
+		}
+	}
+	myUnfilteredEvents = 0;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 void ServiceManager::addService(Service* service)
 {
@@ -303,6 +390,7 @@ void ServiceManager::addService(Service* service)
 	{
 		service->doInitialize(this, myServiceIdCounter++);
 	}
+	updatePointerFilters();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -356,6 +444,7 @@ int ServiceManager::getEvents(Event* ptr, int maxEvents)
 	Event* evt;
 	
 	lockEvents();
+	filterPointerEvents();
 	do
 	{
 		evt = readTail();
@@ -394,6 +483,9 @@ void ServiceManager::unlockEvents()
 Event* ServiceManager::getEvent(int index)
 {
 	oassert(index >= 0 && index < myAvailableEvents);
+	// Services polling on their own threads may have written events since
+	// the last poll. The caller holds the event lock.
+	if(myUnfilteredEvents > 0) filterPointerEvents();
 	return &myEventBuffer[index];
 }
 
@@ -403,6 +495,7 @@ void ServiceManager::clearEvents()
 	myAvailableEvents = 0;
 	myEventBufferHead = 0;
 	myEventBufferTail = 0;
+	myUnfilteredEvents = 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -410,6 +503,8 @@ Event* ServiceManager::writeHead()
 {
 	Event* evt = &myEventBuffer[myEventBufferHead];
 	myEventBufferHead = incrementBufferIndex(myEventBufferHead);
+	if(myUnfilteredEvents < MaxEvents) myUnfilteredEvents++;
+	myEventSequence++;
 
 	// This is not totally exact, we would need an event more to actually start dropping..
 	if(myAvailableEvents == MaxEvents)
@@ -432,11 +527,27 @@ Event* ServiceManager::readHead()
 		Event* evt = &myEventBuffer[myEventBufferHead];
 		myEventBufferHead = decrementBufferIndex(myEventBufferHead);
 		myAvailableEvents--;
+		if(myUnfilteredEvents > 0) myUnfilteredEvents--;
+		myEventSequence--;
 		return evt;
 	}
 	return NULL;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+EventView ServiceManager::getEventsSince(uint64 sequence)
+{
+	if(myUnfilteredEvents > 0) filterPointerEvents();
+	// readHead takes events back, so the sequence can be past the current one.
+	if(sequence > myEventSequence) sequence = myEventSequence;
+	// New events are always the most recent ones, so they end at the buffer head.
+	int count = myAvailableEvents;
+	if(myEventSequence - sequence < (uint64)count) count = (int)(myEventSequence - sequence);
+	int first = myEventBufferHead - count;
+	if(first < 0) first += MaxEvents;
+	return EventView(myEventBuffer, first, count);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 Event* ServiceManager::readTail()
 {
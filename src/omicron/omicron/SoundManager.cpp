@@ -27,6 +27,7 @@
 #include "omicron/SoundManager.h"
 #include "omicron/AssetCacheManager.h"
 #include "omicron/DataManager.h"
+#include "omicron/Trace.h"
 #include <sys/timeb.h>
 
 using namespace omicron;
@@ -305,6 +306,7 @@ void SoundManager::setEnvironment(SoundEnvironment* newEnv)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool SoundManager::sendOSCMessage(Message msg)
 {
+	TraceScope trace("SoundManager::sendOSCMessage", "sound");
 	if(soundServerRunning || startingSoundServer)
 	{
 		PacketWriter pw;
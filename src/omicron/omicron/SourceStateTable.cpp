@@ -0,0 +1,189 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A table of the latest state of each event source, used by the input 
+ *  server to send new clients a snapshot of the current state.
+ ******************************************************************************/
+#include "omicron/SourceStateTable.h"
+
+using namespace omicron;
+
+// Byte offsets of the packet fields used by the table. See
+// InputServer::writeOmicronPacketFromEvent for the full packet layout.
+static const int PacketSourceIdOffset = 4;
+static const int PacketDeviceTagOffset = 8;
+static const int PacketServiceTypeOffset = 12;
+static const int PacketTypeOffset = 16;
+static const int PacketFlagsOffset = 20;
+static const int PacketPositionOffset = 24;
+static const int PacketOrientationOffset = 36;
+
+///////////////////////////////////////////////////////////////////////////////
+static inline uint64 sourceKey(uint serviceType, uint sourceId)
+{
+	return ((uint64)serviceType << 32) | sourceId;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+SourceStateTable::SourceStateTable()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+SourceStateTable::~SourceStateTable()
+{
+	clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool SourceStateTable::isStateEvent(const Event& evt)
+{
+	switch(evt.getServiceType())
+	{
+	// Keys, speech, audio and images are transient: there is no state
+	// a new client could use.
+	case Service::Keyboard:
+	case Service::Speech:
+	case Service::Audio:
+	case Service::Image:
+		return false;
+	default:
+		break;
+	}
+
+	switch(evt.getType())
+	{
+	case Event::Update:
+	case Event::Move:
+	case Event::Down:
+	case Event::Up:
+	case Event::Trace:
+	case Event::Untrace:
+	case Event::Toggle:
+	case Event::ChangeValue:
+		return true;
+	default:
+		// Gestures and clicks describe something that happened, not a state.
+		return false;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SourceStateTable::update(const Event& evt, const char* packet, int length)
+{
+	if(!isStateEvent(evt)) return;
+
+	uint64 key = sourceKey(evt.getServiceType(), evt.getSourceId());
+	if(evt.getType() == Event::Untrace ||
+		(evt.getType() == Event::Up && evt.getServiceType() == Service::Pointer))
+	{
+		remove(key);
+		return;
+	}
+
+	Entry* entry;
+	Dictionary<uint64, int>::iterator it = myIndex.find(key);
+	if(it == myIndex.end())
+	{
+		entry = new Entry();
+		entry->key = key;
+		entry->packet = NULL;
+		entry->capacity = 0;
+		myIndex[key] = (int)myEntries.size();
+		myEntries.push_back(entry);
+	}
+	else
+	{
+		entry = myEntries[it->second];
+	}
+
+	if(entry->capacity < length || entry->capacity < DEFAULT_BUFLEN)
+	{
+		delete[] entry->packet;
+		entry->capacity = length > DEFAULT_BUFLEN ? DEFAULT_LRGBUFLEN : DEFAULT_BUFLEN;
+		entry->packet = new char[entry->capacity];
+		memset(entry->packet, 0, entry->capacity);
+	}
+	memcpy(entry->packet, packet, length);
+	entry->length = length;
+	*((unsigned int*)&entry->packet[PacketTypeOffset]) = Event::Update;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SourceStateTable::remove(uint64 key)
+{
+	Dictionary<uint64, int>::iterator it = myIndex.find(key);
+	if(it == myIndex.end()) return;
+
+	// Swap with the last entry to keep the entry array dense.
+	int index = it->second;
+	Entry* entry = myEntries[index];
+	Entry* last = myEntries.back();
+	myEntries[index] = last;
+	myIndex[last->key] = index;
+	myEntries.pop_back();
+	myIndex.erase(key);
+
+	delete[] entry->packet;
+	delete entry;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SourceStateTable::clear()
+{
+	foreach(Entry* entry, myEntries)
+	{
+		delete[] entry->packet;
+		delete entry;
+	}
+	myEntries.clear();
+	myIndex.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SourceStateTable::getEventHeader(int index, Event* evt)
+{
+	const char* packet = myEntries[index]->packet;
+	uint deviceTag = *((const uint*)&packet[PacketDeviceTagOffset]);
+	const float* pos = (const float*)&packet[PacketPositionOffset];
+	const float* orient = (const float*)&packet[PacketOrientationOffset];
+
+	evt->reset(Event::Update,
+		(Service::ServiceType)*((const uint*)&packet[PacketServiceTypeOffset]),
+		*((const uint*)&packet[PacketSourceIdOffset]),
+		(deviceTag & Event::DTServiceIdMask) >> Event::DTServiceIdOffset,
+		(deviceTag & Event::DTUserIdMask) >> Event::DTUserIdOffset);
+	evt->setPosition(pos[0], pos[1], pos[2]);
+	evt->setOrientation(orient[0], orient[1], orient[2], orient[3]);
+	evt->setFlags(*((const uint*)&packet[PacketFlagsOffset]));
+}
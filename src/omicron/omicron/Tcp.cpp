@@ -34,6 +34,7 @@
  ******************************************************************************/
 #include "omicron/Tcp.h"
 #include "omicron/StringUtils.h"
+#include "omicron/Trace.h"
 
 #include <boost/bind.hpp>
 
@@ -215,6 +216,7 @@ void TcpConnection::waitClose()
 ///////////////////////////////////////////////////////////////////////////////
 void TcpConnection::write(const String& data)
 {
+    TraceScope trace("TcpConnection::write", "network");
     if(mySocket.is_open())
     {
         asio::error_code error;
@@ -230,6 +232,7 @@ void TcpConnection::write(const String& data)
 ///////////////////////////////////////////////////////////////////////////////
 void TcpConnection::write(void* data, size_t size)
 {
+    TraceScope trace("TcpConnection::write", "network");
     if(mySocket.is_open())
     {
         asio::error_code error;
@@ -27,6 +27,7 @@
 
 #include "omicron/TouchGestureManager.h"
 #include "omicron/StringUtils.h"
+#include "omicron/Trace.h"
 #include "connector/omicronConnectorClient.h"
 
 using namespace omicron;
@@ -45,6 +46,7 @@ float touchGroupLongRangeDiameter = 0.6f; // Desktop 0.6, Cyber-Commons = 0.35?
 float minimumZoomDistance = 0.1f; // Minimum distance between two touches to be considered for zoom gesture (differentiates between clicks and zooms)
 float holdToSwipeThreshold = 0.02f; // Minimum distance before a multi-touch hold gesture is considered a swipe
 float clickMaxDistance = 0.02f; // Maximum distance a touch group can be from it's initial point to be considered for a click event
+float bigTouchMinSize = 0.05f; // Minimum width of a single touch to be considered a big touch
 
 float minPreviousPosDistance = 0.002f; // Min distance for touch prevPos to be updated (min distance for idle touch points to become active)
 
@@ -61,12 +63,27 @@ const int GESTURE_SINGLE_CLICK = EventBase::User << 7;
 const int GESTURE_DOUBLE_CLICK = EventBase::User << 8;
 const int GESTURE_MULTI_TOUCH = EventBase::User << 9;
 const int GESTURE_ZOOM = EventBase::User << 10;
+const int GESTURE_STROKE = EventBase::User << 11;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Touch Group
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-TouchGroup::TouchGroup(TouchGestureManager* gm, int ID){
+TouchGroup::TouchGroup(TouchGestureManager* gm, int slot){
 	gestureManager = gm;
+	this->slot = slot;
+
+	touchListLock = new Lock();
+	reset(-1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+TouchGroup::~TouchGroup(){
+	delete touchListLock;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Prepares the group for a new touch ID. Touch lists keep their storage.
+void TouchGroup::reset(int ID){
 	//printf("TouchGroup %d created\n", ID);
 
 	initialDiameter = touchGroupInitialSize;
@@ -77,29 +94,25 @@ TouchGroup::TouchGroup(TouchGestureManager* gm, int ID){
 
 	groupHandedness = NONE;
 
+	centerTouch = Touch();
+	mainTouch = Touch();
 	centerTouch.ID = ID;
 	mainTouch.ID = ID;
 	eventType = Event::Null;
 	gestureFlag = GESTURE_UNPROCESSED;
 	remove = false;
 
-	timeb tb;
-	ftime( &tb );
-	lastUpdated = tb.millitm + (tb.time & 0xfffff) * 1000;
+	lastUpdated = otimestamp();
 
-	touchListLock = new Lock();
+	touchList.clear();
+	longRangeTouchList.clear();
+	idleTouchCount = 0;
+	farthestTouchDistance = 0;
 
-	fiveFingerGestureTriggered = false;
-	threeFingerGestureTriggered = false;
-	zoomGestureTriggered = false;
-	bigTouchGestureTriggered = false;
-	singleClickTriggered = false;
-	doubleClickTriggered = false;
-}
+	moveGesture = 0;
+	pendingMoveGesture = 0;
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-TouchGroup::~TouchGroup(){
-	delete touchListLock;
+	recognizers.reset();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -107,11 +120,55 @@ int TouchGroup::getID(){
 	return ID;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+TouchGestureManager* TouchGroup::getGestureManager(){
+	return gestureManager;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+int TouchGroup::getSlot(){
+	return slot;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns the index of a touch in a list sorted by ID, or -1
+int TouchGroup::findTouch(const Vector<Touch>& list, int touchID){
+	for (size_t i = 0; i < list.size(); i++)
+	{
+		if (list[i].ID == touchID) return (int)i;
+		if (list[i].ID > touchID) break;
+	}
+	return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Adds or replaces a touch, keeping the list sorted by ID
+void TouchGroup::setTouch(Vector<Touch>& list, const Touch& touch){
+	size_t i = 0;
+	while (i < list.size() && list[i].ID < touch.ID) i++;
+
+	if (i < list.size() && list[i].ID == touch.ID)
+	{
+		list[i] = touch;
+	}
+	else
+	{
+		list.insert(list.begin() + i, touch);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns true if the point is inside the radius of the TouchGroup
+bool TouchGroup::containsPoint( float x, float y )
+{
+	return x > centerTouch.xPos - diameter/2 && x < centerTouch.xPos + diameter/2 && y > centerTouch.yPos - diameter/2 && y < centerTouch.yPos + diameter/2;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool TouchGroup::isInsideGroup( Event::Type eventType, float x, float y, int touchID, float w, float h )
 {
 	// Check if touch is inside radius of TouchGroup
-	if( x > centerTouch.xPos - diameter/2 && x < centerTouch.xPos + diameter/2 && y > centerTouch.yPos - diameter/2 && y < centerTouch.yPos + diameter/2 ){
+	if( containsPoint( x, y ) ){
 		addTouch( eventType, x, y, touchID, w, h );
 		return true;
 	} else if( x > centerTouch.xPos - longRangeDiameter/2 && x < centerTouch.xPos + longRangeDiameter/2 && y > centerTouch.yPos - longRangeDiameter/2 && y < centerTouch.yPos + longRangeDiameter/2 ){
@@ -126,13 +183,11 @@ bool TouchGroup::isInsideGroup( Event::Type eventType, float x, float y, int tou
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void TouchGroup::addTouch( Event::Type eventType, float x, float y, int touchID, float w, float h ){
-	timeb tb;
-	ftime( &tb );
-	int curTime = tb.millitm + (tb.time & 0xfffff) * 1000;
+	int curTime = otimestamp();
 
 	// Touch not in list but inside touch (likely from other touchgroup)
 	// Lower ID touch group takes priority
-	if (touchList.count(touchID) == 0 && eventType != Event::Down)
+	if (findTouch(touchList, touchID) == -1 && eventType != Event::Down)
 	{
 		TouchGroup* tg = gestureManager->getTouchGroup(touchID);
 		if (tg != NULL)
@@ -160,19 +215,37 @@ void TouchGroup::addTouch( Event::Type eventType, float x, float y, int touchID,
 
 		lockTouchList();
 
-		if (eventType == Event::Down)
+		// Idle tracking state starts with the touch and is kept across
+		// updates, so gestures do not depend on uninitialized fields.
+		int index = eventType == Event::Down ? -1 : findTouch(touchList, touchID);
+		if (index == -1)
 		{
 			t.initXPos = x;
 			t.initYPos = y;
+			t.lastXPos = x;
+			t.lastYPos = y;
+			t.state = Touch::ACTIVE;
+			t.prevPosResetTime = curTime;
+			t.prevPosTimer = 0;
+			t.idleTime = 0;
+			t.gestureType = 0;
 		}
 		else
 		{
-			t.initXPos = touchList[touchID].initXPos;
-			t.initYPos = touchList[touchID].initYPos;
+			const Touch& prev = touchList[index];
+			t.initXPos = prev.initXPos;
+			t.initYPos = prev.initYPos;
+			t.lastXPos = prev.lastXPos;
+			t.lastYPos = prev.lastYPos;
+			t.state = prev.state;
+			t.prevPosResetTime = prev.prevPosResetTime;
+			t.prevPosTimer = prev.prevPosTimer;
+			t.idleTime = prev.idleTime;
+			t.gestureType = prev.gestureType;
 		}
 		
 
-		touchList[touchID] = t;
+		setTouch(touchList, t);
 
 		unlockTouchList();
 
@@ -182,6 +255,7 @@ void TouchGroup::addTouch( Event::Type eventType, float x, float y, int touchID,
 			{
 				mainTouch = t;
 				centerTouch = t;
+				gestureManager->updateTouchGroupCell(this);
 				gestureManager->generatePQServiceEvent(Event::Down, this, GESTURE_SINGLE_TOUCH);
 			}
 			// ofmsg("TouchGroup %1% added touch ID %2% new size: %3%", %ID %touchID %getTouchCount());
@@ -194,31 +268,12 @@ void TouchGroup::addTouch( Event::Type eventType, float x, float y, int touchID,
 				mainTouch = t;
 			}
 
-			if (getTouchCount() == 1)
-			{
-				// Big touch
-				float bigTouchMinSize = 0.05f;
-				if (mainTouch.xWidth > bigTouchMinSize)
-				{
-					if (!bigTouchGestureTriggered)
-					{
-						ofmsg("TouchGroup ID: %1% BIG touch", %ID);
-						gestureManager->generatePQServiceEvent(Event::Down, this, GESTURE_BIG_TOUCH);
-						bigTouchGestureTriggered = true;
-					}
-					else
-					{
-						gestureManager->generatePQServiceEvent(Event::Move, this, GESTURE_BIG_TOUCH);
-					}
-				}
-				else
-				{
-					gestureManager->generatePQServiceEvent(Event::Move, this, GESTURE_SINGLE_TOUCH);
-				}
-			}
-			else
+			// Recognizers can replace the Move gesture (i.e. big touch)
+			moveGesture = getTouchCount() == 1 ? GESTURE_SINGLE_TOUCH : GESTURE_MULTI_TOUCH;
+			recognizers.touchMoved(*this);
+			if (moveGesture != 0)
 			{
-				gestureManager->generatePQServiceEvent(Event::Move, this, GESTURE_MULTI_TOUCH);
+				generateMoveEvent(moveGesture);
 			}
 		}
 	}
@@ -228,16 +283,51 @@ void TouchGroup::addTouch( Event::Type eventType, float x, float y, int touchID,
 	lastUpdated = curTime;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sends a Move gesture event for the group. While the gesture manager is
+// processing a touch frame, only the last Move of each group is sent, once
+// the whole frame has been added.
+void TouchGroup::generateMoveEvent(int gesture)
+{
+	if (gestureManager->isBatchingTouches())
+	{
+		if (pendingMoveGesture == 0)
+		{
+			gestureManager->queueMoveEvent(this);
+		}
+		pendingMoveGesture = gesture;
+	}
+	else
+	{
+		gestureManager->generatePQServiceEvent(Event::Move, this, gesture);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns and clears the pending Move gesture
+int TouchGroup::takePendingMoveGesture()
+{
+	int gesture = pendingMoveGesture;
+	pendingMoveGesture = 0;
+	return gesture;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void TouchGroup::setMoveGesture(int gesture)
+{
+	moveGesture = gesture;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void TouchGroup::addLongRangeTouch( Event::Type eventType, float x, float y, int ID, float w, float h ){
-	timeb tb;
-	ftime( &tb );
-	lastUpdated = tb.millitm + (tb.time & 0xfffff) * 1000;
+	lastUpdated = otimestamp();
 
 	if( eventType == Event::Up ){ // If up cleanup touch
-		longRangeTouchList.erase( ID );
+		int index = findTouch( longRangeTouchList, ID );
+		if( index != -1 )
+			longRangeTouchList.erase( longRangeTouchList.begin() + index );
 	} else {
-		if( longRangeTouchList.count( ID ) == 1 ){ // Update existing touch
+		if( findTouch( longRangeTouchList, ID ) != -1 ){ // Update existing touch
 			Touch t;
 			t.xPos = x;
 			t.yPos = y;
@@ -246,7 +336,7 @@ void TouchGroup::addLongRangeTouch( Event::Type eventType, float x, float y, int
 			t.ID = ID;
 			t.groupID = this->ID;
 			t.timestamp = lastUpdated;
-			longRangeTouchList[ID] = t;
+			setTouch( longRangeTouchList, t );
 		} else { // Add new touch
 			Touch t;
 			t.xPos = x;
@@ -256,16 +346,14 @@ void TouchGroup::addLongRangeTouch( Event::Type eventType, float x, float y, int
 			t.ID = ID;
 			t.groupID = this->ID;
 			t.timestamp = lastUpdated;
-			touchList[ID] = t;
+			setTouch( touchList, t );
 		}
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Checks the touch group for local gestures
 void TouchGroup::process(){
-	timeb tb;
-	ftime( &tb );
-	int curTime = tb.millitm + (tb.time & 0xfffff) * 1000;
+	int curTime = otimestamp();
 	int timeSinceLastUpdate = curTime-lastUpdated;
 
 	lockTouchList();
@@ -274,14 +362,14 @@ void TouchGroup::process(){
 	float newCenterX = 0;
 	float newCenterY = 0;
 
-	map<int, Touch> activeTouchList;
-	idleTouchList.clear();
+	// Active touches are compacted to the front of the list
+	size_t activeCount = 0;
+	idleTouchCount = 0;
 
 	// Recalculate group center by averaging current touch points
-	map<int, Touch>::iterator it;
-	for (it = touchList.begin(); it != touchList.end(); it++)
+	for (size_t i = 0; i < touchList.size(); i++)
 	{
-		Touch t = (*it).second;
+		Touch t = touchList[i];
 
 		// Check touch update time, if too long remove from list
 		int lastTouchUpdate = curTime - t.timestamp;
@@ -297,7 +385,7 @@ void TouchGroup::process(){
 				if (t.state != t.IDLE)
 					t.idleTime = curTime;
 				t.state = t.IDLE;
-				idleTouchList[t.ID] = t;
+				idleTouchCount++;
 			}
 			else
 			{
@@ -319,12 +407,12 @@ void TouchGroup::process(){
 				//t.lastXPos = t.xPos;
 				//t.lastYPos = t.yPos;
 			}
-			activeTouchList[t.ID] = t;
+			touchList[activeCount++] = t;
 		}
 	}
 
-	// Swap oldlist with active list
-	touchList = activeTouchList;
+	// Drop inactive touches
+	touchList.resize(activeCount);
 
 	newCenterX /= touchList.size();
 	newCenterY /= touchList.size();
@@ -337,15 +425,16 @@ void TouchGroup::process(){
 	{
 		centerTouch.xPos = newCenterX;
 		centerTouch.yPos = newCenterY;
+		gestureManager->updateTouchGroupCell(this);
 	}
 
 	// Determine the farthest point from the group center (thumb?)
 	int farthestTouchID = -1;
 	farthestTouchDistance = 0;
 
-	for (it = touchList.begin(); it != touchList.end(); it++)
+	for (size_t i = 0; i < touchList.size(); i++)
 	{
-		Touch t = (*it).second;
+		const Touch& t = touchList[i];
 
 		float curDistance = sqrt(abs(centerTouch.xPos - t.xPos) * abs(centerTouch.xPos - t.xPos) + abs(centerTouch.yPos - t.yPos) * abs(centerTouch.yPos - t.yPos));
 		if (curDistance > farthestTouchDistance) {
@@ -361,177 +450,147 @@ void TouchGroup::process(){
 // Gesture Tracking
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void TouchGroup::generateGestures(){
-	timeb tb;
-	ftime( &tb );
-	int curTime = tb.millitm + (tb.time & 0xfffff) * 1000;
+	// Gestures are detected by the recognizers in TouchGroupRecognizers
+	recognizers.update(*this);
+}
 
-	// Basic 2-touch zoom
-	if (touchList.size() == 2 && idleTouchList.size() <= 1 && !zoomGestureTriggered) {
-		zoomGestureTriggered = true;
 
-		initialZoomDistance = farthestTouchDistance;
-		zoomDistance = farthestTouchDistance;
-		zoomLastDistance = initialZoomDistance;
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Big Touch Recognizer
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void BigTouchRecognizer::reset(){
+	triggered = false;
+}
 
-		gestureManager->generateZoomEvent(Event::Down, this, 0);
-		ofmsg("TouchGroup ID: %1% zoom start", %ID);
-	}
-	else if (touchList.size() < 2 && zoomGestureTriggered) {
-		zoomGestureTriggered = false;
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void BigTouchRecognizer::touchMoved(TouchGroup& tg){
+	if (tg.getTouchCount() != 1 || tg.getMainTouch().xWidth <= bigTouchMinSize) return;
 
-		gestureManager->generateZoomEvent(Event::Up, this, 0);
-		ofmsg("TouchGroup ID: %1% zoom end", %ID);
+	if (!triggered)
+	{
+		ofmsg("TouchGroup ID: %1% BIG touch", %tg.getID());
+		tg.getGestureManager()->generatePQServiceEvent(Event::Down, &tg, GESTURE_BIG_TOUCH);
+		tg.setMoveGesture(0);
+		triggered = true;
 	}
-
-	if (zoomGestureTriggered)
+	else
 	{
-		zoomLastDistance = zoomDistance;
-		zoomDistance = farthestTouchDistance;
+		tg.setMoveGesture(GESTURE_BIG_TOUCH);
+	}
+}
 
-		float zoomDelta = (zoomDistance - zoomLastDistance) * zoomGestureMultiplier;
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Click Recognizer
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ClickRecognizer::reset(){
+	singleClick = false;
+	doubleClick = false;
+}
 
-		if (zoomDelta != 0)
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// If the group is released within clickMaxDistance of its initial position, trigger a click
+void ClickRecognizer::touchesReleased(TouchGroup& tg){
+	Touch mainTouch = tg.getMainTouch();
+	float dx = mainTouch.initXPos - mainTouch.xPos;
+	float dy = mainTouch.initYPos - mainTouch.yPos;
+	if (sqrt(dx * dx + dy * dy) <= clickMaxDistance)
+	{
+		if (!singleClick)
 		{
-			gestureManager->generateZoomEvent(Event::Move, this, zoomDelta);
-			//ofmsg("TouchGroup ID: %1% zoom delta: %2%", %ID %zoomDelta);
+			singleClick = true;
 		}
-	}
-
-	/*
-	// Single finger gestures
-	if( touchList.size() == 1 )
-    {
-		
-		Touch t = touchList[ID];
-		mainTouch.xWidth = t.xWidth;
-		mainTouch.yWidth = t.yWidth;
-
-		// Big touch
-		float bigTouchMinSize = 0.05f;
-		if( t.xWidth + t.yWidth > 0 )
+		else
 		{
-			if( t.xWidth > bigTouchMinSize )
-			{
-				
-				gestureFlag =  GESTURE_BIG_TOUCH;
-
-				if( !bigTouchGestureTriggered )
-				{
-					ofmsg("TouchGroup ID: %1% BIG touch", %ID);
-					gestureManager->generatePQServiceEvent( Event::Down, mainTouch, touchList, gestureFlag );
-					bigTouchGestureTriggered = true;
-				}
-				else
-				{
-					gestureManager->generatePQServiceEvent( Event::Move, mainTouch, touchList, gestureFlag );
-				}
-			}
-			else
-			{
-				//ofmsg("TouchGroup ID: %1% single touch (idle count: %2% time: %3%)", %ID %idleTouchList.size() %(curTime-t.idleTime) );
-				gestureFlag = GESTURE_SINGLE_TOUCH;
-			}
-			//ofmsg("   size: %1%, %2%", %t.xWidth %t.yWidth);
+			doubleClick = true;
 		}
 	}
-	else if( touchList.size() > 1 )
-	{
-		gestureFlag = GESTURE_MULTI_TOUCH;
-	}
-
-	// Basic 2-touch zoom
-	if( touchList.size() == 2 && idleTouchList.size() <= 1 && !zoomGestureTriggered){
-      zoomGestureTriggered = true;
-      
-      initialZoomDistance = farthestTouchDistance;
-      zoomDistance = farthestTouchDistance;
-      zoomLastDistance = initialZoomDistance;
-      
-	  gestureManager->generateZoomEvent(Event::Down, mainTouch, touchList, 0);
-	  ofmsg("TouchGroup ID: %1% zoom start", %ID);
-    } else if( touchList.size() < 2 && zoomGestureTriggered ){
-      zoomGestureTriggered = false;
-      
-	  gestureManager->generateZoomEvent(Event::Up, mainTouch, touchList, 0);
-	   ofmsg("TouchGroup ID: %1% zoom end", %ID);
-    }
-
-	if( zoomGestureTriggered )
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ClickRecognizer::groupRemoved(TouchGroup& tg){
+	TouchGestureManager* gestureManager = tg.getGestureManager();
+	if (doubleClick)
 	{
-		zoomLastDistance = zoomDistance;
-		zoomDistance = farthestTouchDistance;
-      
-		float zoomDelta = (zoomDistance - zoomLastDistance) * zoomGestureMultiplier;
-		
-		if( zoomDelta != 0 )
-		{
-			gestureManager->generateZoomEvent(Event::Move, mainTouch, touchList, zoomDelta);
-			// ofmsg("TouchGroup ID: %1% zoom delta: %2%", %ID %zoomDelta);
-		}
+		ofmsg("TouchGestureManager: TouchGroup %1% double click", %tg.getID());
+		gestureManager->generatePQServiceEvent(Event::Down, &tg, GESTURE_DOUBLE_CLICK);
 	}
-	else
+	else if (singleClick)
 	{
+		ofmsg("TouchGestureManager: TouchGroup %1% single click", %tg.getID());
+		gestureManager->generatePQServiceEvent(Event::Down, &tg, GESTURE_SINGLE_CLICK);
+	}
+}
 
-		// 5-finger gesture
-		if (touchList.size() == 5 && idleTouchList.size() > 3 && !fiveFingerGestureTriggered)
-		{
-			gestureManager->generatePQServiceEvent(Event::Down, mainTouch, touchList, GESTURE_FIVE_FINGER_HOLD);
-			fiveFingerGestureTriggered = true;
-
-			ofmsg("TouchGroup ID: %1% 5-finger gesture triggered", %ID);
-			if (groupHandedness == LEFT)
-				omsg("   - Left-hand detected");
-			else if (groupHandedness == RIGHT)
-				omsg("   - Right-hand detected");
-		}
-		else if (touchList.size() == 5 && idleTouchList.size() > 3 && fiveFingerGestureTriggered)
-		{
-			gestureManager->generatePQServiceEvent(Event::Move, mainTouch, touchList, GESTURE_FIVE_FINGER_HOLD);
-			//ofmsg("TouchGroup ID: %1% 5-finger gesture hold", %ID);
-		}
-		else if (touchList.size() != 5 && fiveFingerGestureTriggered)
-		{
-			gestureManager->generatePQServiceEvent(Event::Up, mainTouch, touchList, GESTURE_FIVE_FINGER_HOLD);
-			fiveFingerGestureTriggered = false;
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Zoom Recognizer
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void ZoomRecognizer::reset(){
+	triggered = false;
+	initialDistance = 0;
+	distance = 0;
+	lastDistance = 0;
+}
 
-			ofmsg("TouchGroup ID: %1% 5-finger gesture ended", %ID);
-		}
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Basic 2-touch zoom
+void ZoomRecognizer::update(TouchGroup& tg){
+	TouchGestureManager* gestureManager = tg.getGestureManager();
+	int touchCount = tg.getTouchCount();
 
-		// 3-finger gesture
-		if (touchList.size() == 3 && idleTouchList.size() > 2 && !threeFingerGestureTriggered)
-		{
-			gestureManager->generatePQServiceEvent(Event::Down, mainTouch, touchList, GESTURE_THREE_FINGER_HOLD);
-			threeFingerGestureTriggered = true;
-
-			ofmsg("TouchGroup ID: %1% 3-finger gesture triggered", %ID);
-			if (groupHandedness == LEFT)
-				omsg("   - Left-hand detected");
-			else if (groupHandedness == RIGHT)
-				omsg("   - Right-hand detected");
-		}
-		else if (touchList.size() == 3 && idleTouchList.size() > 2 && threeFingerGestureTriggered)
-		{
-			gestureManager->generatePQServiceEvent(Event::Move, mainTouch, touchList, GESTURE_THREE_FINGER_HOLD);
-			//ofmsg("TouchGroup ID: %1% 5-finger gesture hold", %ID);
-		}
-		else if (touchList.size() != 3 && threeFingerGestureTriggered)
-		{
-			gestureManager->generatePQServiceEvent(Event::Up, mainTouch, touchList, GESTURE_THREE_FINGER_HOLD);
-			threeFingerGestureTriggered = false;
+	if (touchCount == 2 && tg.getIdleTouchCount() <= 1 && !triggered) {
+		triggered = true;
+
+		initialDistance = tg.getFarthestTouchDistance();
+		distance = initialDistance;
+		lastDistance = initialDistance;
+
+		gestureManager->generateZoomEvent(Event::Down, &tg, 0);
+		ofmsg("TouchGroup ID: %1% zoom start", %tg.getID());
+	}
+	else if (touchCount < 2 && triggered) {
+		triggered = false;
+
+		gestureManager->generateZoomEvent(Event::Up, &tg, 0);
+		ofmsg("TouchGroup ID: %1% zoom end", %tg.getID());
+	}
+
+	if (triggered)
+	{
+		lastDistance = distance;
+		distance = tg.getFarthestTouchDistance();
+
+		float zoomDelta = (distance - lastDistance) * zoomGestureMultiplier;
 
-			ofmsg("TouchGroup ID: %1% 3-finger gesture ended", %ID);
+		if (zoomDelta != 0)
+		{
+			gestureManager->generateZoomEvent(Event::Move, &tg, zoomDelta);
+			//ofmsg("TouchGroup ID: %1% zoom delta: %2%", %tg.getID() %zoomDelta);
 		}
 	}
-	*/
 }
 
-
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Returns the number of touches in the group
 int TouchGroup::getTouchCount(){
 	return (int)touchList.size();
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+int TouchGroup::getIdleTouchCount(){
+	return idleTouchCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Distance of the touch farthest from the group center, as of the last process()
+float TouchGroup::getFarthestTouchDistance(){
+	return farthestTouchDistance;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+TouchGroupRecognizers& TouchGroup::getRecognizers(){
+	return recognizers;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Returns the center of the touch group
 Touch TouchGroup::getCenterTouch(){
@@ -553,9 +612,7 @@ int TouchGroup::getGestureFlag(){
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Returns the remove flag
 bool TouchGroup::isRemovable(){
-	timeb tb;
-	ftime(&tb);
-	int curTime = tb.millitm + (tb.time & 0xfffff) * 1000;
+	int curTime = otimestamp();
 	int timeSinceLastUpdate = curTime - lastUpdated;
 
 	// Allow a small delay between when the group was marked for removed (due to touch group size 0)
@@ -577,8 +634,9 @@ void TouchGroup::setRemove(){
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-map<int,Touch> TouchGroup::getTouchList() {
-	return touchList;
+// Returns a touch of the group (call with the touch list locked)
+const Touch& TouchGroup::getTouch(int index) {
+	return touchList[index];
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -595,7 +653,7 @@ void TouchGroup::unlockTouchList() {
 // Gets the zoom delta distance
 float TouchGroup::getZoomDelta(){
 	if( gestureFlag == Event::Zoom )
-		return zoomDistance - zoomLastDistance;
+		return recognizers.get<ZoomRecognizer>().getDelta();
 	else
 		return 0;
 }
@@ -610,50 +668,27 @@ float TouchGroup::getLongRangeDiameter() {
 	return longRangeDiameter;
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-bool TouchGroup::isSingleClickTriggered() {
-	return singleClickTriggered;
-}
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-bool TouchGroup::isDoubleClickTriggered() {
-	return doubleClickTriggered;
-}
-
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void TouchGroup::removeTouch(int id) {
 	touchListLock->lock();
-	touchList.erase(id);
+	int index = findTouch(touchList, id);
+	if (index != -1)
+	{
+		touchList.erase(touchList.begin() + index);
+	}
 
 	// ofmsg("TouchGroup %1% removed touch ID %2%", %ID %id);
-	if (id == mainID)
+	if (id == mainID && !touchList.empty())
 	{
 		// Main ID (controlling group) has been removed
 		// Set next available touch to take over group
-		map<int, Touch>::iterator it;
-		for (it = touchList.begin(); it != touchList.end(); it++)
-		{
-			Touch t = (*it).second;
-			mainID = t.ID;
-		}
+		mainID = touchList.back().ID;
 	}
 	touchListLock->unlock();
 
 	if (getTouchCount() == 0)
 	{
-		// If touch group size and zero and inital position < clickMaxDistance, trigger click gesture
-		float distFromInitPos = sqrt(abs(mainTouch.initXPos - mainTouch.xPos) * abs(mainTouch.initXPos - mainTouch.xPos) + abs(mainTouch.initYPos - mainTouch.yPos) * abs(mainTouch.initYPos - mainTouch.yPos));
-		if (distFromInitPos <= clickMaxDistance)
-		{
-			if (!singleClickTriggered)
-			{
-				singleClickTriggered = true;
-			}
-			else
-			{
-				doubleClickTriggered = true;
-			}
-		}
+		recognizers.touchesReleased(*this);
 		setRemove();
 	}
 }
@@ -675,6 +710,33 @@ TouchGestureManager::TouchGestureManager()
 	touchListLock = new Lock();
 	touchGroupListLock = new Lock();
 	runGestureThread = true;
+	gestureThreadRunning = false;
+	touchQueueSize = 4096;
+	touchQueueHead = 0;
+	touchQueueTail = 0;
+	droppedTouches = 0;
+	pqsInstance = NULL;
+	batchingTouches = false;
+	gridCellSize = touchGroupInitialSize;
+	regionIndex = -1;
+	regionColumns = 1;
+	regionRows = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+TouchGestureManager::~TouchGestureManager()
+{
+	stopThread();
+	for (size_t i = 0; i < regionManagers.size(); i++)
+	{
+		delete regionManagers[i];
+	}
+	for (size_t i = 0; i < touchGroupPool.size(); i++)
+	{
+		delete touchGroupPool[i];
+	}
+	delete touchListLock;
+	delete touchGroupListLock;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -696,55 +758,257 @@ void TouchGestureManager::setup( Setting& settings )
 	minPreviousPosDistance = Config::getFloatValue("minPreviousPosDistance", settings, 0.002f); // Min distance for touch prevPos to be updated (min distance for idle touch points to become active)
 
 	zoomGestureMultiplier = Config::getFloatValue("zoomGestureMultiplier", settings, 10);
+
+	StrokeRecognizer::setup(settings);
+
+	runGestureThread = Config::getBoolValue("gestureThread", settings, true); // Run gesture recognition on its own thread
+	touchQueueSize = Config::getIntValue("gestureQueueSize", settings, 4096); // Touch updates queued for the gesture thread
+
+	// Groups never contain a point when the diameter is not positive, so any
+	// cell size works then.
+	gridCellSize = touchGroupInitialSize > 0 ? touchGroupInitialSize : 1.0f;
+
+	// Screen regions, each with its own gesture manager
+	regionColumns = Config::getIntValue("gestureRegionColumns", settings, 1);
+	regionRows = Config::getIntValue("gestureRegionRows", settings, 1);
+	if (regionColumns < 1) regionColumns = 1;
+	if (regionRows < 1) regionRows = 1;
+	if (regionIndex < 0 && regionColumns * regionRows > 1 && regionManagers.empty())
+	{
+		createRegions(settings);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void TouchGestureManager::createRegions( Setting& settings )
+{
+	int count = regionColumns * regionRows;
+	for (int i = 0; i < count; i++)
+	{
+		TouchGestureManager* rm = new TouchGestureManager();
+		rm->regionIndex = i;
+		rm->setup(settings);
+		regionManagers.push_back(rm);
+	}
+	regionTouches.resize(count);
+	regionEventTypes.resize(count);
+
+	ofmsg("TouchGestureManager: %1%x%2% gesture regions", %regionColumns %regionRows);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+int TouchGestureManager::getRegionCount()
+{
+	return regionManagers.empty() ? 1 : (int)regionManagers.size();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void TouchGestureManager::registerPQService( Service* service )
 {
 	pqsInstance = service;
+
+	// Region managers send their gesture events to the same service
+	if (!regionManagers.empty())
+	{
+		for (size_t i = 0; i < regionManagers.size(); i++)
+		{
+			regionManagers[i]->registerPQService(service);
+		}
+		return;
+	}
+
 	omsg("TouchGestureManager: Registered with " + service->getName());
+
+	if (runGestureThread)
+	{
+		startThread();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void TouchGestureManager::startThread()
+{
+	if (!regionManagers.empty())
+	{
+		for (size_t i = 0; i < regionManagers.size(); i++)
+		{
+			regionManagers[i]->startThread();
+		}
+		return;
+	}
+
+	if (gestureThreadRunning) return;
+
+	if ((int)touchQueue.size() != touchQueueSize)
+	{
+		touchQueue.resize(touchQueueSize > 0 ? touchQueueSize : 1);
+		queuedTouches.resize(touchQueue.size());
+		queuedEventTypes.resize(touchQueue.size());
+	}
+	touchQueueHead = 0;
+	touchQueueTail = 0;
+
+	gestureThreadRunning = true;
+	start();
+	omsg("TouchGestureManager: Gesture thread started");
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Stops the gesture thread and processes the touches still queued.
+void TouchGestureManager::stopThread()
+{
+	for (size_t i = 0; i < regionManagers.size(); i++)
+	{
+		regionManagers[i]->stopThread();
+	}
+
+	if (!gestureThreadRunning) return;
+
+	gestureThreadRunning = false;
+	stop();
+	drainTouchQueue();
+
+	if (droppedTouches > 0)
+	{
+		ofwarn("TouchGestureManager: %1% touch updates were dropped because the gesture queue was full", %droppedTouches.load());
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool TouchGestureManager::isThreadRunning()
+{
+	if (!regionManagers.empty())
+	{
+		return regionManagers[0]->isThreadRunning();
+	}
+	return gestureThreadRunning;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+uint64 TouchGestureManager::getDroppedTouches()
+{
+	uint64 dropped = droppedTouches;
+	for (size_t i = 0; i < regionManagers.size(); i++)
+	{
+		dropped += regionManagers[i]->getDroppedTouches();
+	}
+	return dropped;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void TouchGestureManager::threadProc()
+{
+	if (regionIndex >= 0)
+	{
+		Tracer::setThreadName(ostr("TouchGestureManager region %1%", %regionIndex));
+	}
+	else
+	{
+		Tracer::setThreadName("TouchGestureManager");
+	}
+	while (gestureThreadRunning)
+	{
+		int count = drainTouchQueue();
+
+		// Groups still need updates without new touches, to time out
+		if (count > 0 || !activeTouchGroups.empty())
+		{
+			update();
+		}
+		if (count == 0)
+		{
+			osleep(1);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Producer side. Returns false if the queue is full and the touch is dropped.
+bool TouchGestureManager::queueTouch(Event::Type eventType, const Touch& touch)
+{
+	uint64 head = touchQueueHead.load(std::memory_order_relaxed);
+	uint64 tail = touchQueueTail.load(std::memory_order_acquire);
+	if (head - tail >= touchQueue.size())
+	{
+		droppedTouches++;
+		return false;
+	}
+
+	TouchUpdate& update = touchQueue[head % touchQueue.size()];
+	update.touch = touch;
+	update.eventType = eventType;
+
+	touchQueueHead.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Consumer side: processes every queued touch as one batch. Returns the
+// number of touches dequeued.
+int TouchGestureManager::drainTouchQueue()
+{
+	uint64 tail = touchQueueTail.load(std::memory_order_relaxed);
+	uint64 head = touchQueueHead.load(std::memory_order_acquire);
+	int count = (int)(head - tail);
+	if (count == 0) return 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		const TouchUpdate& update = touchQueue[(tail + i) % touchQueue.size()];
+		queuedTouches[i] = update.touch;
+		queuedEventTypes[i] = update.eventType;
+	}
+	touchQueueTail.store(head, std::memory_order_release);
+
+	processTouches(queuedEventTypes.data(), queuedTouches.data(), count);
+	return count;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void TouchGestureManager::poll()
 {
-	touchGroupListLock->lock();
+	for (size_t i = 0; i < regionManagers.size(); i++)
+	{
+		regionManagers[i]->poll();
+	}
+
+	// The gesture thread updates the groups itself
+	if (gestureThreadRunning) return;
 
-	map<int,TouchGroup*> newTouchGroupList;
+	update();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void TouchGestureManager::update()
+{
+	TraceScope trace("TouchGestureManager::update", "gestures");
+	touchGroupListLock->lock();
 
-	// Check for empty TouchGroups
-	map<int,TouchGroup*>::iterator it;
-	for ( it = touchGroupList.begin() ; it != touchGroupList.end(); it++ ){
-		TouchGroup* tg = (*it).second;
+	// Check for empty TouchGroups. Groups that stay active are compacted
+	// to the front of the list in place.
+	size_t activeCount = 0;
+	for ( size_t i = 0; i < activeTouchGroups.size(); i++ ){
+		TouchGroup* tg = touchGroupPool[activeTouchGroups[i]];
 		tg->process();
 
-		// Add non-empty groups to the list (ignoring empty groups)
+		// Keep non-empty groups in the list (ignoring empty groups)
 		if( !tg->isRemovable() )
 		{
-			newTouchGroupList[tg->getID()] = tg;
+			activeTouchGroups[activeCount++] = tg->getSlot();
 		}
 		else
 		{
-			Touch mainTouch = tg->getMainTouch();
-
-			if (tg->isDoubleClickTriggered())
-			{
-				ofmsg("TouchGestureManager: TouchGroup %1% double click", %tg->getID());
-				generatePQServiceEvent(Event::Down, tg, GESTURE_DOUBLE_CLICK);
-			}
-			else if (tg->isSingleClickTriggered())
-			{
-				ofmsg("TouchGestureManager: TouchGroup %1% single click", %tg->getID());
-				generatePQServiceEvent(Event::Down, tg, GESTURE_SINGLE_CLICK);
-			}
+			// Recognizers send their last gestures (i.e. clicks) before the group Up
+			tg->getRecognizers().groupRemoved(*tg);
 
 			ofmsg("TouchGestureManager: TouchGroup %1% empty. Removed.", %tg->getID());
 			generatePQServiceEvent( Event::Up, tg, tg->getGestureFlag() );
+			releaseTouchGroup(tg);
 		}
 	}
 
 	// Update the list
-	touchGroupList = newTouchGroupList;
+	activeTouchGroups.resize(activeCount);
 
 	touchGroupListLock->unlock();
 	
@@ -755,9 +1019,7 @@ void TouchGestureManager::poll()
 // This also serves to error correct touch data: invalid ranges, missing events, etc.
 bool TouchGestureManager::addTouch(Event::Type eventType, Touch touch)
 {
-	timeb tb;
-	ftime( &tb );
-	int curTime = tb.millitm + (tb.time & 0xfffff) * 1000;
+	int curTime = otimestamp();
 
 	float x = touch.xPos;
 	float y = touch.yPos;
@@ -765,17 +1027,125 @@ bool TouchGestureManager::addTouch(Event::Type eventType, Touch touch)
 	float w = touch.xWidth;
 	float h = touch.yWidth;
 
+	if (!regionManagers.empty())
+	{
+		int region = routeTouch(eventType, touch);
+		return regionManagers[region]->addTouch(eventType, touch);
+	}
+
+	if (gestureThreadRunning)
+	{
+		return queueTouch(eventType, touch);
+	}
+
 	// Let the touch groups determine if the touch is new or an update
+	touchGroupListLock->lock();
 	addTouchGroup(eventType, x, y, ID, w, h );
+	touchGroupListLock->unlock();
 	return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Adds a whole frame of touches. Queued for the gesture thread if it runs.
+void TouchGestureManager::addTouches(const Event::Type* eventTypes, const Touch* touches, int count)
+{
+	// Split the frame by region, keeping the touch order within each region
+	if (!regionManagers.empty())
+	{
+		for (size_t r = 0; r < regionManagers.size(); r++)
+		{
+			regionTouches[r].clear();
+			regionEventTypes[r].clear();
+		}
+		for (int i = 0; i < count; i++)
+		{
+			int region = routeTouch(eventTypes[i], touches[i]);
+			regionTouches[region].push_back(touches[i]);
+			regionEventTypes[region].push_back(eventTypes[i]);
+		}
+		for (size_t r = 0; r < regionManagers.size(); r++)
+		{
+			if (!regionTouches[r].empty())
+			{
+				regionManagers[r]->addTouches(regionEventTypes[r].data(), regionTouches[r].data(), (int)regionTouches[r].size());
+			}
+		}
+		return;
+	}
+
+	if (gestureThreadRunning)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			queueTouch(eventTypes[i], touches[i]);
+		}
+		return;
+	}
+
+	processTouches(eventTypes, touches, count);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Processes a batch of touches under a single lock. Group Move gestures are
+// coalesced, so each group sends at most one Move event per batch, written
+// under a single event lock.
+void TouchGestureManager::processTouches(const Event::Type* eventTypes, const Touch* touches, int count)
+{
+	TraceScope trace("TouchGestureManager::processTouches", "gestures");
+	touchGroupListLock->lock();
+
+	batchingTouches = true;
+	for (int i = 0; i < count; i++)
+	{
+		const Touch& t = touches[i];
+		addTouchGroup(eventTypes[i], t.xPos, t.yPos, t.ID, t.xWidth, t.yWidth);
+	}
+	batchingTouches = false;
+
+	if (!pendingMoveGroups.empty())
+	{
+		if (pqsInstance)
+		{
+			pqsInstance->lockEvents();
+			for (size_t i = 0; i < pendingMoveGroups.size(); i++)
+			{
+				TouchGroup* tg = pendingMoveGroups[i];
+				writePQServiceEvent(Event::Move, tg, tg->takePendingMoveGesture());
+			}
+			pqsInstance->unlockEvents();
+		}
+		else
+		{
+			printf("TouchGestureManager: No PQService Registered\n");
+			for (size_t i = 0; i < pendingMoveGroups.size(); i++)
+			{
+				pendingMoveGroups[i]->takePendingMoveGesture();
+			}
+		}
+		pendingMoveGroups.clear();
+	}
+
+	touchGroupListLock->unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool TouchGestureManager::isBatchingTouches()
+{
+	return batchingTouches;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void TouchGestureManager::queueMoveEvent(TouchGroup* touchGroup)
+{
+	pendingMoveGroups.push_back(touchGroup);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 TouchGroup* TouchGestureManager::getTouchGroup(int ID)
 {
-	if (touchGroupList.count(ID) > 0)
+	if (ID >= 0 && ID < (int)touchGroupSlots.size() && touchGroupSlots[ID] >= 0)
 	{
-		return touchGroupList[ID];
+		return touchGroupPool[touchGroupSlots[ID]];
 	}
 	else
 	{
@@ -784,38 +1154,254 @@ TouchGroup* TouchGestureManager::getTouchGroup(int ID)
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-bool TouchGestureManager::addTouchGroup( Event::Type eventType, float xPos, float yPos, int ID, float xWidth, float yWidth )
+int TouchGestureManager::getTouchGroupCount()
 {
-	touchGroupListLock->lock();
+	int count = (int)activeTouchGroups.size();
+	for (size_t i = 0; i < regionManagers.size(); i++)
+	{
+		count += regionManagers[i]->getTouchGroupCount();
+	}
+	return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Region containing a normalized screen position. Positions off the screen
+// go to the nearest region.
+int TouchGestureManager::getRegion(float x, float y)
+{
+	int column = x >= 1 ? regionColumns - 1 : (x > 0 ? (int)(x * regionColumns) : 0);
+	int row = y >= 1 ? regionRows - 1 : (y > 0 ? (int)(y * regionRows) : 0);
+	return row * regionColumns + column;
+}
 
-	// Check if new touch is inside an existing TouchGroup
-	map<int,TouchGroup*>::iterator it;
-	for ( it = touchGroupList.begin() ; it != touchGroupList.end(); it++ ){
-		TouchGroup* tg = (*it).second;
-		int groupID = (*it).first;
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Picks the region manager for a touch. A touch keeps the region it went down
+// in, so its group is never split between managers. A new touch joins the
+// region of the closest touch that could share its group, even across a
+// region boundary, and otherwise the region under it. Touches stay candidates
+// until their group could have timed out, which keeps double clicks together.
+int TouchGestureManager::routeTouch(Event::Type eventType, const Touch& touch)
+{
+	int curTime = otimestamp();
 
-		if( tg->isInsideGroup( eventType, xPos, yPos, ID, xWidth, yWidth ) )
+	TouchRoute* route = NULL;
+	if (touch.ID >= 0)
+	{
+		if (touch.ID >= (int)touchRoutes.size())
 		{
-			touchGroupListLock->unlock();
-			return true;
+			TouchRoute unseen = { -1, 0, 0, 0, false };
+			touchRoutes.resize(touch.ID + 1, unseen);
 		}
+		route = &touchRoutes[touch.ID];
+	}
+
+	int region;
+	if (route != NULL && route->region >= 0 && eventType != Event::Down)
+	{
+		region = route->region;
+	}
+	else
+	{
+		// Touches of one group are at most a group diameter apart
+		float reach = touchGroupInitialSize;
+		float closest = -1;
+		region = getRegion(touch.xPos, touch.yPos);
+		for (size_t i = 0; i < routedTouches.size(); )
+		{
+			TouchRoute& other = touchRoutes[routedTouches[i]];
+			if (curTime - other.lastUpdated > touchTimeout + touchGroupTimeout)
+			{
+				other.tracked = false;
+				routedTouches[i] = routedTouches.back();
+				routedTouches.pop_back();
+				continue;
+			}
+
+			float dx = fabs(other.xPos - touch.xPos);
+			float dy = fabs(other.yPos - touch.yPos);
+			if (dx < reach && dy < reach && (closest < 0 || dx * dx + dy * dy < closest))
+			{
+				closest = dx * dx + dy * dy;
+				region = other.region;
+			}
+			i++;
+		}
+	}
+
+	if (route != NULL)
+	{
+		route->region = region;
+		route->xPos = touch.xPos;
+		route->yPos = touch.yPos;
+		route->lastUpdated = curTime;
+		if (!route->tracked)
+		{
+			route->tracked = true;
+			routedTouches.push_back(touch.ID);
+		}
+	}
+	return region;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Takes a group from the pool. The pool only grows when every slot is in use.
+TouchGroup* TouchGestureManager::createTouchGroup(int ID)
+{
+	TouchGroup* tg;
+	if (!freeTouchGroupSlots.empty())
+	{
+		tg = touchGroupPool[freeTouchGroupSlots.back()];
+		freeTouchGroupSlots.pop_back();
+		tg->reset(ID);
+	}
+	else
+	{
+		int slot = (int)touchGroupPool.size();
+		tg = new TouchGroup(this, slot);
+		tg->reset(ID);
+		touchGroupPool.push_back(tg);
+		groupCenterX.push_back(0);
+		groupCenterY.push_back(0);
+		groupRadius.push_back(0);
+		groupCells.push_back(0);
+		groupInGrid.push_back(false);
+	}
+	activeTouchGroups.push_back(tg->getSlot());
+	return tg;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns a removed group to the pool. Does not touch activeTouchGroups.
+void TouchGestureManager::releaseTouchGroup(TouchGroup* touchGroup)
+{
+	removeTouchGroupCell(touchGroup);
+
+	int ID = touchGroup->getID();
+	if (ID >= 0 && ID < (int)touchGroupSlots.size() && touchGroupSlots[ID] == touchGroup->getSlot())
+	{
+		touchGroupSlots[ID] = ExpiredTouchGroup;
+	}
+	freeTouchGroupSlots.push_back(touchGroup->getSlot());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Moves a touch group to the grid cell of its current center.
+// Called with touchGroupListLock held.
+void TouchGestureManager::updateTouchGroupCell(TouchGroup* touchGroup)
+{
+	int slot = touchGroup->getSlot();
+	Touch center = touchGroup->getCenterTouch();
+	groupCenterX[slot] = center.xPos;
+	groupCenterY[slot] = center.yPos;
+	groupRadius[slot] = touchGroup->getDiameter() / 2;
+
+	uint64 key = getGridCell(getGridCoordinate(center.xPos), getGridCoordinate(center.yPos));
+	if (groupInGrid[slot])
+	{
+		if (groupCells[slot] == key) return;
+		removeTouchGroupCell(touchGroup);
+	}
+
+	groupCells[slot] = key;
+	groupInGrid[slot] = true;
+	touchGroupGrid[key].push_back(slot);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void TouchGestureManager::removeTouchGroupCell(TouchGroup* touchGroup)
+{
+	int slot = touchGroup->getSlot();
+	if (!groupInGrid[slot]) return;
+
+	Dictionary<uint64, Vector<int> >::iterator cell = touchGroupGrid.find(groupCells[slot]);
+	if (cell != touchGroupGrid.end())
+	{
+		Vector<int>& slots = cell->second;
+		for (size_t i = 0; i < slots.size(); i++)
+		{
+			if (slots[i] == slot)
+			{
+				slots[i] = slots.back();
+				slots.pop_back();
+				break;
+			}
+		}
+	}
+	groupInGrid[slot] = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+uint64 TouchGestureManager::getGridCell(int cellX, int cellY)
+{
+	return ((uint64)(uint)cellX << 32) | (uint)cellY;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Clamped so that invalid or huge positions still map to a valid cell.
+int TouchGestureManager::getGridCoordinate(float pos)
+{
+	double cell = floor((double)pos / gridCellSize);
+	if (cell != cell) return 0;
+	if (cell < -1e9) return -1000000000;
+	if (cell > 1e9) return 1000000000;
+	return (int)cell;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Called with touchGroupListLock held.
+bool TouchGestureManager::addTouchGroup( Event::Type eventType, float xPos, float yPos, int ID, float xWidth, float yWidth )
+{
+	// Check if new touch is inside an existing TouchGroup. Only groups in the
+	// neighbouring grid cells can contain it. When several groups do, the
+	// lowest group ID takes priority.
+	int cellX = getGridCoordinate(xPos);
+	int cellY = getGridCoordinate(yPos);
+	TouchGroup* insideGroup = NULL;
+	for( int dy = -1; dy <= 1; dy++ ){
+		for( int dx = -1; dx <= 1; dx++ ){
+			Dictionary<uint64, Vector<int> >::iterator cell = touchGroupGrid.find(getGridCell(cellX + dx, cellY + dy));
+			if( cell == touchGroupGrid.end() ) continue;
+
+			Vector<int>& slots = cell->second;
+			for( size_t i = 0; i < slots.size(); i++ ){
+				// Same test as TouchGroup::containsPoint
+				int s = slots[i];
+				float r = groupRadius[s];
+				if( xPos > groupCenterX[s] - r && xPos < groupCenterX[s] + r && yPos > groupCenterY[s] - r && yPos < groupCenterY[s] + r )
+				{
+					TouchGroup* tg = touchGroupPool[s];
+					if( insideGroup == NULL || tg->getID() < insideGroup->getID() )
+					{
+						insideGroup = tg;
+					}
+				}
+			}
+		}
+	}
+
+	if( insideGroup != NULL )
+	{
+		insideGroup->addTouch( eventType, xPos, yPos, ID, xWidth, yWidth );
+		return true;
 	}
 
 	// If touch is not part of existing group, create new
-	// TouchGroup using that touch ID
-	if( groupedIDs.count(ID) == 0 ){
+	// TouchGroup using that touch ID. A Down can reuse the ID of an expired
+	// group, since touch IDs are recycled by the touch services.
+	if( ID < 0 ) return false;
+	if( ID >= (int)touchGroupSlots.size() ) touchGroupSlots.resize(ID + 1, NoTouchGroup);
+
+	int groupSlot = touchGroupSlots[ID];
+	if( groupSlot == NoTouchGroup || (groupSlot == ExpiredTouchGroup && eventType == Event::Down) ){
 		ofmsg("TouchID %1% creating new TouchGroup %2%", %ID %ID);
-		TouchGroup* newGroup = new TouchGroup(this, ID);
+		TouchGroup* newGroup = createTouchGroup(ID);
 		newGroup->addTouch( eventType, xPos, yPos, ID, xWidth, yWidth );
+		updateTouchGroupCell(newGroup);
 
-		touchGroupList[ID] = newGroup;
-		
-		groupedIDs.insert(ID);
-		touchGroupListLock->unlock();
+		touchGroupSlots[ID] = newGroup->getSlot();
 		
 		return true;
 	}
-	touchGroupListLock->unlock();
 	return false;
 }
 
@@ -968,6 +1554,69 @@ void TouchGestureManager::generateZoomEvent( Event::Type eventType, Touch touch,
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void TouchGestureManager::generatePQServiceEvent(Event::Type eventType, TouchGroup* touchGroup, int gesture)
+{
+	if (pqsInstance) {
+		pqsInstance->lockEvents();
+		writePQServiceEvent(eventType, touchGroup, gesture);
+		pqsInstance->unlockEvents();
+	}
+	else {
+		printf("TouchGestureManager: No PQService Registered\n");
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Called with the PQService event lock held.
+void TouchGestureManager::writePQServiceEvent(Event::Type eventType, TouchGroup* touchGroup, int gesture)
+{
+	Event* evt = pqsInstance->writeHead();
+
+	Touch touch = touchGroup->getMainTouch();
+	Touch centerTouch = touchGroup->getCenterTouch();
+
+	switch (eventType)
+	{
+	case Event::Down:
+		evt->reset(Event::Down, Service::Pointer, touchGroup->getID());
+		break;
+	case Event::Move:
+		evt->reset(Event::Move, Service::Pointer, touchGroup->getID());
+		break;
+	case Event::Up:
+		evt->reset(Event::Up, Service::Pointer, touchGroup->getID());
+		break;
+	}
+	evt->setPosition(Vector3f(touch.xPos, touch.yPos, 0));
+	evt->setOrientation(centerTouch.xPos, centerTouch.yPos, touchGroup->getDiameter(), touchGroup->getLongRangeDiameter());
+	evt->setFlags(gesture);
+
+	evt->setExtraDataType(Event::ExtraDataFloatArray);
+	evt->setExtraDataFloat(0, touch.xWidth);
+	evt->setExtraDataFloat(1, touch.yWidth);
+	evt->setExtraDataFloat(2, touch.initXPos);
+	evt->setExtraDataFloat(3, touch.initYPos);
+	evt->setExtraDataFloat(4, -1); // Secondary event flag (used for zoom)
+
+	int extraDataIndex = 6;
+
+	touchGroup->lockTouchList();
+	int touchCount = touchGroup->getTouchCount();
+	evt->setExtraDataFloat(5, touchCount); // Includes self in count
+
+	// Only as many touches as fit in the extra data are listed
+	for (int i = 0; i < touchCount && extraDataIndex + 3 <= Event::MaxExtraDataItems; i++)
+	{
+		const Touch& t = touchGroup->getTouch(i);
+
+		evt->setExtraDataFloat(extraDataIndex++, t.ID);
+		evt->setExtraDataFloat(extraDataIndex++, t.xPos);
+		evt->setExtraDataFloat(extraDataIndex++, t.yPos);
+	}
+	touchGroup->unlockTouchList();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void TouchGestureManager::generateZoomEvent(Event::Type eventType, TouchGroup* touchGroup, float zoomDelta)
 {
 	if (pqsInstance) {
 		pqsInstance->lockEvents();
@@ -976,46 +1625,26 @@ void TouchGestureManager::generatePQServiceEvent(Event::Type eventType, TouchGro
 
 		Touch touch = touchGroup->getMainTouch();
 		Touch centerTouch = touchGroup->getCenterTouch();
-		map<int, Touch> groupTouchList = touchGroup->getTouchList();
 
-		switch (eventType)
-		{
-		case Event::Down:
-			evt->reset(Event::Down, Service::Pointer, touchGroup->getID());
-			break;
-		case Event::Move:
-			evt->reset(Event::Move, Service::Pointer, touchGroup->getID());
-			break;
-		case Event::Up:
-			evt->reset(Event::Up, Service::Pointer, touchGroup->getID());
-			break;
-		}
+		evt->reset(Event::Zoom, Service::Pointer, touchGroup->getID());
 		evt->setPosition(Vector3f(touch.xPos, touch.yPos, 0));
 		evt->setOrientation(centerTouch.xPos, centerTouch.yPos, touchGroup->getDiameter(), touchGroup->getLongRangeDiameter());
-		evt->setFlags(gesture);
+		evt->setFlags(GESTURE_ZOOM);
 
 		evt->setExtraDataType(Event::ExtraDataFloatArray);
 		evt->setExtraDataFloat(0, touch.xWidth);
 		evt->setExtraDataFloat(1, touch.yWidth);
 		evt->setExtraDataFloat(2, touch.initXPos);
 		evt->setExtraDataFloat(3, touch.initYPos);
-		evt->setExtraDataFloat(4, -1); // Secondary event flag (used for zoom)
-		evt->setExtraDataFloat(5, groupTouchList.size()); // Includes self in count
-
-		map<int, Touch>::iterator it;
-		int extraDataIndex = 6;
-
-		touchGroup->lockTouchList();
-		for (it = groupTouchList.begin(); it != groupTouchList.end(); it++)
+		
+		switch (eventType)
 		{
-			Touch t = (*it).second;
-
-			evt->setExtraDataFloat(extraDataIndex++, t.ID);
-			evt->setExtraDataFloat(extraDataIndex++, t.xPos);
-			evt->setExtraDataFloat(extraDataIndex++, t.yPos);
+		case(Event::Down): evt->setExtraDataFloat(4, 1); break;
+		case(Event::Move): evt->setExtraDataFloat(4, 2); break;
+		case(Event::Up): evt->setExtraDataFloat(4, 3); break;
 		}
-		touchGroup->unlockTouchList();
 
+		evt->setExtraDataFloat(5, zoomDelta);
 
 		pqsInstance->unlockEvents();
 
@@ -1024,9 +1653,9 @@ void TouchGestureManager::generatePQServiceEvent(Event::Type eventType, TouchGro
 		printf("TouchGestureManager: No PQService Registered\n");
 	}
 }
-
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-void TouchGestureManager::generateZoomEvent(Event::Type eventType, TouchGroup* touchGroup, float zoomDelta)
+// Sends a recognized stroke as a Down event, positioned at the main touch.
+void TouchGestureManager::generateStrokeEvent(TouchGroup* touchGroup, int strokeTemplate, float score)
 {
 	if (pqsInstance) {
 		pqsInstance->lockEvents();
@@ -1035,32 +1664,23 @@ void TouchGestureManager::generateZoomEvent(Event::Type eventType, TouchGroup* t
 
 		Touch touch = touchGroup->getMainTouch();
 		Touch centerTouch = touchGroup->getCenterTouch();
-		map<int, Touch> groupTouchList = touchGroup->getTouchList();
 
-		evt->reset(Event::Zoom, Service::Pointer, touchGroup->getID());
+		evt->reset(Event::Down, Service::Pointer, touchGroup->getID());
 		evt->setPosition(Vector3f(touch.xPos, touch.yPos, 0));
 		evt->setOrientation(centerTouch.xPos, centerTouch.yPos, touchGroup->getDiameter(), touchGroup->getLongRangeDiameter());
-		evt->setFlags(GESTURE_ZOOM);
+		evt->setFlags(GESTURE_STROKE);
 
 		evt->setExtraDataType(Event::ExtraDataFloatArray);
 		evt->setExtraDataFloat(0, touch.xWidth);
 		evt->setExtraDataFloat(1, touch.yWidth);
 		evt->setExtraDataFloat(2, touch.initXPos);
 		evt->setExtraDataFloat(3, touch.initYPos);
-		
-		switch (eventType)
-		{
-		case(Event::Down): evt->setExtraDataFloat(4, 1); break;
-		case(Event::Move): evt->setExtraDataFloat(4, 2); break;
-		case(Event::Up): evt->setExtraDataFloat(4, 3); break;
-		}
-
-		evt->setExtraDataFloat(5, zoomDelta);
+		evt->setExtraDataFloat(4, strokeTemplate); // See StrokeRecognizer::getTemplateName
+		evt->setExtraDataFloat(5, score);
 
 		pqsInstance->unlockEvents();
-
 	}
 	else {
 		printf("TouchGestureManager: No PQService Registered\n");
 	}
-}
\ No newline at end of file
+}
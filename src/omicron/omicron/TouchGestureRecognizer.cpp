@@ -0,0 +1,418 @@
+/**************************************************************************************************
+ * THE OMICRON PROJECT
+ *-------------------------------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *-------------------------------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory, University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted 
+ * provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this list of conditions 
+ * and the following disclaimer. Redistributions in binary form must reproduce the above copyright 
+ * notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR 
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND 
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR SERVICES; LOSS OF 
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *************************************************************************************************/
+
+#include "omicron/TouchGestureManager.h"
+#include "omicron/TouchGestureRecognizer.h"
+#include "omicron/StringUtils.h"
+
+#include <cfloat>
+
+using namespace omicron;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Stroke Recognizer
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+float StrokeRecognizer::minScore = 0.8f;
+float StrokeRecognizer::minLength = 0.05f;
+
+// Strokes are normalized to a square of this size
+static const float StrokeSquareSize = 1.0f;
+static const float StrokeHalfDiagonal = 0.5f * sqrt(2.0f * StrokeSquareSize * StrokeSquareSize);
+
+// Rotation search range and precision (radians)
+static const float StrokeAngleRange = 0.785398f; // 45 degrees
+static const float StrokeAnglePrecision = 0.034907f; // 2 degrees
+static const float StrokePhi = 0.5f * (-1.0f + sqrt(5.0f));
+
+// Templates farther than this multiple of the acceptance distance at the
+// indicative angle are not searched.
+static const float StrokeRejectMargin = 1.5f;
+
+// Strokes below this ratio of width to height (or the inverse) are treated as
+// one dimensional and scaled uniformly.
+static const float StrokeOneDimensionalRatio = 0.3f;
+
+// Minimum recorded points and minimum distance between them
+static const int StrokeMinPoints = 8;
+static const float StrokeMinPointDistance = 0.001f;
+
+struct StrokeTemplate
+{
+	const char* name;
+	float x[StrokeRecognizer::ResampledPoints];
+	float y[StrokeRecognizer::ResampledPoints];
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Resamples a path to n equally spaced points. Returns false if the path has no length.
+static bool resampleStroke(const float* x, const float* y, int count, float* outX, float* outY, int n, float* length)
+{
+	float pathLength = 0;
+	for (int i = 1; i < count; i++)
+	{
+		pathLength += sqrt((x[i] - x[i - 1]) * (x[i] - x[i - 1]) + (y[i] - y[i - 1]) * (y[i] - y[i - 1]));
+	}
+	*length = pathLength;
+	if (count < 2 || pathLength <= 0) return false;
+
+	float interval = pathLength / (n - 1);
+	float accumulated = 0;
+	float prevX = x[0];
+	float prevY = y[0];
+	outX[0] = prevX;
+	outY[0] = prevY;
+	int k = 1;
+	for (int i = 1; i < count && k < n; i++)
+	{
+		float d = sqrt((x[i] - prevX) * (x[i] - prevX) + (y[i] - prevY) * (y[i] - prevY));
+		while (accumulated + d >= interval && d > 0 && k < n)
+		{
+			float t = (interval - accumulated) / d;
+			prevX += t * (x[i] - prevX);
+			prevY += t * (y[i] - prevY);
+			outX[k] = prevX;
+			outY[k] = prevY;
+			k++;
+			d = sqrt((x[i] - prevX) * (x[i] - prevX) + (y[i] - prevY) * (y[i] - prevY));
+			accumulated = 0;
+		}
+		accumulated += d;
+		prevX = x[i];
+		prevY = y[i];
+	}
+	// Rounding can leave the last points out
+	for (; k < n; k++)
+	{
+		outX[k] = x[count - 1];
+		outY[k] = y[count - 1];
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rotates a resampled stroke so that its indicative angle (centroid to first
+// point) is zero, scales it to the reference square and moves its centroid to
+// the origin.
+static void normalizeStroke(float* x, float* y, int n)
+{
+	float cx = 0;
+	float cy = 0;
+	for (int i = 0; i < n; i++)
+	{
+		cx += x[i];
+		cy += y[i];
+	}
+	cx /= n;
+	cy /= n;
+
+	float angle = atan2(cy - y[0], cx - x[0]);
+	float c = cos(-angle);
+	float s = sin(-angle);
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (int i = 0; i < n; i++)
+	{
+		float dx = x[i] - cx;
+		float dy = y[i] - cy;
+		x[i] = dx * c - dy * s;
+		y[i] = dx * s + dy * c;
+		minX = min(minX, x[i]);
+		maxX = max(maxX, x[i]);
+		minY = min(minY, y[i]);
+		maxY = max(maxY, y[i]);
+	}
+
+	float width = maxX - minX;
+	float height = maxY - minY;
+	float scaleX;
+	float scaleY;
+	if (min(width, height) < StrokeOneDimensionalRatio * max(width, height))
+	{
+		scaleX = scaleY = StrokeSquareSize / max(max(width, height), FLT_EPSILON);
+	}
+	else
+	{
+		scaleX = StrokeSquareSize / width;
+		scaleY = StrokeSquareSize / height;
+	}
+
+	cx = 0;
+	cy = 0;
+	for (int i = 0; i < n; i++)
+	{
+		x[i] *= scaleX;
+		y[i] *= scaleY;
+		cx += x[i];
+		cy += y[i];
+	}
+	cx /= n;
+	cy /= n;
+	for (int i = 0; i < n; i++)
+	{
+		x[i] -= cx;
+		y[i] -= cy;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Average point distance between the stroke, rotated around the origin, and a
+// template. Stops early, returning at least bound, once the distance can no
+// longer be below bound.
+static float strokeDistanceAtAngle(const float* x, const float* y, const StrokeTemplate& t, float angle, float bound)
+{
+	const int n = StrokeRecognizer::ResampledPoints;
+	float c = cos(angle);
+	float s = sin(angle);
+	float maxSum = bound * n;
+	float sum = 0;
+	for (int i = 0; i < n; i++)
+	{
+		float dx = x[i] * c - y[i] * s - t.x[i];
+		float dy = x[i] * s + y[i] * c - t.y[i];
+		sum += sqrt(dx * dx + dy * dy);
+		if (sum >= maxSum) return bound;
+	}
+	return sum / n;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Golden section search for the rotation with the smallest distance.
+static float strokeDistanceAtBestAngle(const float* x, const float* y, const StrokeTemplate& t)
+{
+	float a = -StrokeAngleRange;
+	float b = StrokeAngleRange;
+	float x1 = StrokePhi * a + (1 - StrokePhi) * b;
+	float f1 = strokeDistanceAtAngle(x, y, t, x1, FLT_MAX);
+	float x2 = (1 - StrokePhi) * a + StrokePhi * b;
+	float f2 = strokeDistanceAtAngle(x, y, t, x2, FLT_MAX);
+	while (fabs(b - a) > StrokeAnglePrecision)
+	{
+		if (f1 < f2)
+		{
+			b = x2;
+			x2 = x1;
+			f2 = f1;
+			x1 = StrokePhi * a + (1 - StrokePhi) * b;
+			f1 = strokeDistanceAtAngle(x, y, t, x1, FLT_MAX);
+		}
+		else
+		{
+			a = x1;
+			x1 = x2;
+			f1 = f2;
+			x2 = (1 - StrokePhi) * a + StrokePhi * b;
+			f2 = strokeDistanceAtAngle(x, y, t, x2, FLT_MAX);
+		}
+	}
+	return min(f1, f2);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void addStrokeTemplate(Vector<StrokeTemplate>& templates, const char* name, const float* points, int count)
+{
+	float x[StrokeRecognizer::MaxPathPoints];
+	float y[StrokeRecognizer::MaxPathPoints];
+	for (int i = 0; i < count; i++)
+	{
+		x[i] = points[i * 2];
+		y[i] = points[i * 2 + 1];
+	}
+
+	StrokeTemplate t;
+	t.name = name;
+	float length;
+	resampleStroke(x, y, count, t.x, t.y, StrokeRecognizer::ResampledPoints, &length);
+	normalizeStroke(t.x, t.y, StrokeRecognizer::ResampledPoints);
+	templates.push_back(t);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Built in stroke templates, in screen coordinates (y down). Built by
+// StrokeRecognizer::setup, before any gesture thread runs, and only read
+// afterwards.
+static Vector<StrokeTemplate> sStrokeTemplates;
+
+static const Vector<StrokeTemplate>& getStrokeTemplates()
+{
+	Vector<StrokeTemplate>& templates = sStrokeTemplates;
+	if (templates.empty())
+	{
+		float circle[33 * 2];
+		for (int i = 0; i <= 32; i++)
+		{
+			float angle = (float)Math::TwoPi * i / 32 - (float)Math::HalfPi;
+			circle[i * 2] = cos(angle);
+			circle[i * 2 + 1] = sin(angle);
+		}
+		const float triangle[] = { 0.5f, 0, 1, 1, 0, 1, 0.5f, 0 };
+		const float rectangle[] = { 0, 0, 0, 1, 1, 1, 1, 0, 0, 0 };
+		const float check[] = { 0, 0.6f, 0.3f, 1, 1, 0 };
+		const float caret[] = { 0, 1, 0.5f, 0, 1, 1 };
+		const float v[] = { 0, 0, 0.5f, 1, 1, 0 };
+		const float zigzag[] = { 0, 0, 0.33f, 1, 0.66f, 0, 1, 1 };
+		const float star[] = { 0.5f, 0, 0.8f, 1, 0, 0.38f, 1, 0.38f, 0.2f, 1, 0.5f, 0 };
+
+		addStrokeTemplate(templates, "circle", circle, 33);
+		addStrokeTemplate(templates, "triangle", triangle, 4);
+		addStrokeTemplate(templates, "rectangle", rectangle, 5);
+		addStrokeTemplate(templates, "check", check, 3);
+		addStrokeTemplate(templates, "caret", caret, 3);
+		addStrokeTemplate(templates, "v", v, 3);
+		addStrokeTemplate(templates, "zigzag", zigzag, 4);
+		addStrokeTemplate(templates, "star", star, 6);
+	}
+	return templates;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void StrokeRecognizer::setup(Setting& settings)
+{
+	minScore = Config::getFloatValue("strokeMinScore", settings, 0.8f); // Minimum score (0-1) for a stroke to be recognized
+	minLength = Config::getFloatValue("strokeMinLength", settings, 0.05f); // Minimum stroke length (ratio of screen size)
+
+	getStrokeTemplates();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+int StrokeRecognizer::getTemplateCount()
+{
+	return (int)getStrokeTemplates().size();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+const char* StrokeRecognizer::getTemplateName(int index)
+{
+	const Vector<StrokeTemplate>& templates = getStrokeTemplates();
+	if (index < 0 || index >= (int)templates.size()) return "";
+	return templates[index].name;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+int StrokeRecognizer::recognize(const float* x, const float* y, int count, float* score)
+{
+	float rx[ResampledPoints];
+	float ry[ResampledPoints];
+	float length;
+	*score = 0;
+	if (!resampleStroke(x, y, count, rx, ry, ResampledPoints, &length) || length < minLength) return -1;
+	normalizeStroke(rx, ry, ResampledPoints);
+
+	const Vector<StrokeTemplate>& templates = getStrokeTemplates();
+	float acceptDistance = (1 - minScore) * StrokeHalfDiagonal;
+	float bestDistance = acceptDistance;
+	int best = -1;
+	for (size_t i = 0; i < templates.size(); i++)
+	{
+		// Early rejection at the indicative angle
+		float bound = bestDistance * StrokeRejectMargin;
+		if (strokeDistanceAtAngle(rx, ry, templates[i], 0, bound) >= bound) continue;
+
+		float d = strokeDistanceAtBestAngle(rx, ry, templates[i]);
+		if (d < bestDistance)
+		{
+			bestDistance = d;
+			best = (int)i;
+		}
+	}
+
+	if (best >= 0) *score = 1 - bestDistance / StrokeHalfDiagonal;
+	return best;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void StrokeRecognizer::reset()
+{
+	touching = false;
+	multiTouch = false;
+	pathCount = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Records the path while the group has a single touch, and matches it when
+// the touch is released.
+void StrokeRecognizer::update(TouchGroup& tg)
+{
+	int touchCount = tg.getTouchCount();
+	if (touchCount > 0)
+	{
+		if (!touching)
+		{
+			touching = true;
+			multiTouch = false;
+			pathCount = 0;
+		}
+		if (touchCount > 1)
+		{
+			multiTouch = true;
+		}
+		else if (!multiTouch)
+		{
+			tg.lockTouchList();
+			Touch t = tg.getTouch(0);
+			tg.unlockTouchList();
+			addPoint(t.xPos, t.yPos);
+		}
+	}
+	else if (touching)
+	{
+		touching = false;
+		if (!multiTouch && pathCount >= StrokeMinPoints)
+		{
+			float score;
+			int index = recognize(pathX, pathY, pathCount, &score);
+			if (index >= 0)
+			{
+				ofmsg("TouchGroup ID: %1% stroke %2% (score %3%)", %tg.getID() %getTemplateName(index) %score);
+				tg.getGestureManager()->generateStrokeEvent(&tg, index, score);
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// When the path is full, every other point is dropped, which keeps its shape.
+void StrokeRecognizer::addPoint(float x, float y)
+{
+	if (pathCount > 0)
+	{
+		float dx = x - pathX[pathCount - 1];
+		float dy = y - pathY[pathCount - 1];
+		if (dx * dx + dy * dy < StrokeMinPointDistance * StrokeMinPointDistance) return;
+	}
+
+	if (pathCount == MaxPathPoints)
+	{
+		for (int i = 0; i < MaxPathPoints / 2; i++)
+		{
+			pathX[i] = pathX[i * 2];
+			pathY[i] = pathY[i * 2];
+		}
+		pathCount = MaxPathPoints / 2;
+	}
+	pathX[pathCount] = x;
+	pathY[pathCount] = y;
+	pathCount++;
+}
@@ -0,0 +1,317 @@
+/******************************************************************************
+ * THE OMICRON SDK
+ *-----------------------------------------------------------------------------
+ * Copyright 2010-2019		Electronic Visualization Laboratory, 
+ *							University of Illinois at Chicago
+ * Authors:										
+ *  Arthur Nishimoto		anishimoto42@gmail.com
+ *  Alessandro Febretti		febret@gmail.com
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2010-2019, Electronic Visualization Laboratory,  
+ * University of Illinois at Chicago
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer. Redistributions in binary 
+ * form must reproduce the above copyright notice, this list of conditions and 
+ * the following disclaimer in the documentation and/or other materials provided 
+ * with the distribution. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *-----------------------------------------------------------------------------
+ * What's in this file:
+ *	A low overhead tracer recording timed spans in per-thread ring buffers,
+ *  that can be dumped in the Chrome trace event format.
+ ******************************************************************************/
+#include "omicron/Trace.h"
+#include "omicron/StringUtils.h"
+#include "omicron/Thread.h"
+
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <set>
+
+#ifndef OMICRON_OS_WIN
+#include <unistd.h>
+#endif
+
+using namespace omicron;
+
+std::atomic<bool> Tracer::sEnabled(false);
+
+namespace {
+	struct Span
+	{
+		const char* name;
+		const char* category;
+		uint64 begin;
+		uint64 duration;
+	};
+
+	// A ring buffer slot, protected by a sequence lock: the owner thread sets
+	// seq to 2 * index + 1 while it writes span number index to the slot, and
+	// to 2 * index + 2 once the span is complete. Readers copy a span only if
+	// seq holds its committed value before and after the copy.
+	struct SpanSlot
+	{
+		std::atomic<uint64> seq;
+		std::atomic<const char*> name;
+		std::atomic<const char*> category;
+		std::atomic<uint64> begin;
+		std::atomic<uint64> duration;
+	};
+
+	// Spans recorded by a single thread. The span ring is allocated by the
+	// first recorded span. When a thread exits its buffer is kept, so its 
+	// spans still show up in dumps, until a new thread takes it over.
+	struct ThreadBuffer
+	{
+		int id;
+		String name;
+		// Written by the owner thread before the first count store, so 
+		// readers see them once count is not zero.
+		SpanSlot* spans;
+		uint64 capacity;
+		// Total number of spans recorded. Only written by the owner thread.
+		std::atomic<uint64> count;
+	};
+
+	Lock sLock;
+	Vector<ThreadBuffer*> sBuffers;
+	// Buffers of threads that exited
+	Vector<ThreadBuffer*> sFreeBuffers;
+	std::set<String> sStrings;
+	int sBufferSize = Tracer::DefaultBufferSize;
+
+	// Gives the buffer of a thread back when the thread exits.
+	struct ThreadBufferOwner
+	{
+		ThreadBuffer* buffer;
+		~ThreadBufferOwner()
+		{
+			if(buffer == NULL) return;
+			sLock.lock();
+			sFreeBuffers.push_back(buffer);
+			sLock.unlock();
+		}
+	};
+
+	thread_local ThreadBufferOwner sThreadBuffer = { NULL };
+
+	volatile sig_atomic_t sDumpRequested = 0;
+	String sDumpFile;
+
+	///////////////////////////////////////////////////////////////////////////
+	ThreadBuffer* getThreadBuffer()
+	{
+		if(sThreadBuffer.buffer == NULL)
+		{
+			ThreadBuffer* b = NULL;
+			sLock.lock();
+			if(!sFreeBuffers.empty())
+			{
+				// Reuse the buffer of a thread that exited, dropping its spans.
+				// Sequence numbers restart too, so a dump still copying the
+				// old spans skips the slots rewritten from now on.
+				b = sFreeBuffers.back();
+				sFreeBuffers.pop_back();
+				b->count.store(0, std::memory_order_release);
+			}
+			else
+			{
+				b = new ThreadBuffer();
+				b->id = (int)sBuffers.size() + 1;
+				b->spans = NULL;
+				b->capacity = 0;
+				b->count.store(0, std::memory_order_relaxed);
+				sBuffers.push_back(b);
+			}
+			b->name = ostr("Thread %1%", %b->id);
+			sLock.unlock();
+			sThreadBuffer.buffer = b;
+		}
+		return sThreadBuffer.buffer;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	String escape(const char* str)
+	{
+		String res;
+		for(; *str != '\0'; str++)
+		{
+			if(*str == '"' || *str == '\\') res += '\\';
+			if((unsigned char)*str >= 0x20) res += *str;
+		}
+		return res;
+	}
+
+#ifndef OMICRON_OS_WIN
+	///////////////////////////////////////////////////////////////////////////
+	void onDumpSignal(int)
+	{
+		sDumpRequested = 1;
+	}
+#endif
+};
+
+///////////////////////////////////////////////////////////////////////////////
+void Tracer::setBufferSize(int spans)
+{
+	sLock.lock();
+	sBufferSize = spans > 16 ? spans : 16;
+	sLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint64 Tracer::now()
+{
+	return (uint64)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Tracer::record(const char* name, const char* category, uint64 begin, uint64 end)
+{
+	ThreadBuffer* b = getThreadBuffer();
+	if(b->spans == NULL)
+	{
+		sLock.lock();
+		b->capacity = sBufferSize;
+		sLock.unlock();
+		b->spans = new SpanSlot[b->capacity];
+		for(uint64 i = 0; i < b->capacity; i++) b->spans[i].seq.store(0, std::memory_order_relaxed);
+	}
+	uint64 i = b->count.load(std::memory_order_relaxed);
+	SpanSlot& s = b->spans[i % b->capacity];
+	s.seq.store(2 * i + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	s.name.store(name, std::memory_order_relaxed);
+	s.category.store(category, std::memory_order_relaxed);
+	s.begin.store(begin, std::memory_order_relaxed);
+	s.duration.store(end - begin, std::memory_order_relaxed);
+	s.seq.store(2 * i + 2, std::memory_order_release);
+	b->count.store(i + 1, std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Tracer::setThreadName(const String& name)
+{
+	ThreadBuffer* b = getThreadBuffer();
+	sLock.lock();
+	b->name = name;
+	sLock.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const char* Tracer::intern(const String& str)
+{
+	sLock.lock();
+	const char* res = sStrings.insert(str).first->c_str();
+	sLock.unlock();
+	return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+String Tracer::getJson()
+{
+	sLock.lock();
+	Vector<ThreadBuffer*> buffers = sBuffers;
+	sLock.unlock();
+
+	// Copy the spans first, then find the earliest one: timestamps are 
+	// written relative to it, to keep them readable.
+	Vector< std::pair<int, Span> > spans;
+	uint64 start = 0;
+	foreach(ThreadBuffer* b, buffers)
+	{
+		uint64 count = b->count.load(std::memory_order_acquire);
+		uint64 first = count > b->capacity ? count - b->capacity : 0;
+		for(uint64 i = first; i < count; i++)
+		{
+			// The owner thread keeps writing while we read: skip the spans
+			// it overwrote during the copy.
+			SpanSlot& slot = b->spans[i % b->capacity];
+			uint64 seq = slot.seq.load(std::memory_order_acquire);
+			if(seq != 2 * i + 2) continue;
+			Span s;
+			s.name = slot.name.load(std::memory_order_relaxed);
+			s.category = slot.category.load(std::memory_order_relaxed);
+			s.begin = slot.begin.load(std::memory_order_relaxed);
+			s.duration = slot.duration.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(slot.seq.load(std::memory_order_relaxed) != seq) continue;
+
+			if(start == 0 || s.begin < start) start = s.begin;
+			spans.push_back(std::make_pair(b->id, s));
+		}
+	}
+
+	String json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	sLock.lock();
+	foreach(ThreadBuffer* b, buffers)
+	{
+		json += ostr("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%1%,\"args\":{\"name\":\"%2%\"}},\n",
+			%b->id %escape(b->name.c_str()));
+	}
+	sLock.unlock();
+
+	for(size_t i = 0; i < spans.size(); i++)
+	{
+		const Span& s = spans[i].second;
+		json += ostr("{\"name\":\"%1%\",\"cat\":\"%2%\",\"ph\":\"X\",\"ts\":%3%,\"dur\":%4%,\"pid\":1,\"tid\":%5%}%6%\n",
+			%escape(s.name) %escape(s.category) %(s.begin - start) %s.duration %spans[i].first
+			%(i + 1 < spans.size() ? "," : ""));
+	}
+	// Strip the separator after the last thread name if there are no spans.
+	if(spans.empty() && json[json.size() - 2] == ',') json.erase(json.size() - 2, 1);
+	json += "]}\n";
+	return json;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool Tracer::dump(const String& filename)
+{
+	std::ofstream f(filename.c_str(), std::ios::binary);
+	if(!f.is_open())
+	{
+		ofwarn("Tracer::dump: could not open %1%", %filename);
+		return false;
+	}
+	f << getJson();
+	ofmsg("Tracer: trace written to %1%", %filename);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Tracer::dumpOnSignal(const String& filename)
+{
+#ifdef OMICRON_OS_WIN
+	owarn("Tracer::dumpOnSignal: signals not supported on this platform");
+#else
+	sDumpFile = filename;
+	signal(SIGUSR1, onDumpSignal);
+	ofmsg("Tracer: send SIGUSR1 to process %1% to write a trace to %2%", %getpid() %filename);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Tracer::poll()
+{
+	if(sDumpRequested)
+	{
+		sDumpRequested = 0;
+		dump(sDumpFile);
+	}
+}
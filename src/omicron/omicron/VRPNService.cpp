@@ -262,7 +262,7 @@ void VRPNService::generateTrackerEvent(vrpn_TRACKERCB t, int id, unsigned short
 	TrackerInfo trackerInfo = trackerNames[id];
 	float lastt = trackerInfo.lastUpdateTime;
 
-    float curt = (float)((double)clock() / CLOCKS_PER_SEC);
+    float curt = (float)otime();
     if(curt - lastt > mysInstance->myUpdateInterval)
     {
 		if (isDebugEnabled())
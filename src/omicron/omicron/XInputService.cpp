@@ -106,7 +106,7 @@ void XInputService::poll()
 {
 	static float lastt;
 	static float checkControllerLastt;
-	float curt = (float)((double)clock() / CLOCKS_PER_SEC);
+	float curt = (float)otime();
 	if(curt - lastt <= myUpdateInterval)
 	{
 		return;
@@ -29,6 +29,10 @@
 #include "omicron/FilesystemDataSource.h"
 #include "omicron/StringUtils.h"
 #include "omicron/Thread.h"
+#include "omicron/Trace.h"
+
+#include <chrono>
+#include <limits>
 
 #ifdef WIN32
 #include <windows.h> // needed for Sleep 
@@ -48,6 +52,24 @@ namespace omicron
 	bool sDebugAlloc = false;
     bool sAutocolor = true;
 
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	class SystemClock: public IClock
+	{
+	public:
+		virtual uint64 getTime()
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count();
+		}
+	};
+	SystemClock sSystemClock;
+	std::atomic<IClock*> sClock(&sSystemClock);
+	// Added to the clock time to get the otime() value, in microseconds. Set on the first call,
+	// and updated when the clock is set so otime() continues from its current value: services 
+	// store absolute otime() values, that must stay in the past across clock changes.
+	const int64 NoClockOffset = std::numeric_limits<int64>::min();
+	std::atomic<int64> sClockOffset(NoClockOffset);
+
 	//////////////////////////////////////////////////////////////////////////////////////////////////
 	void odebugalloc(bool value) { sDebugAlloc = value; }
 
@@ -96,6 +118,7 @@ namespace omicron
 	//////////////////////////////////////////////////////////////////////////////////////////////////
 	void omsg(const String& str)
 	{
+		TraceScope trace("omsg", "log");
 		if(sLogEnabled)
 		{
             const char* fmt = sAppendNewline? "%s\n" : "%s";
@@ -138,6 +161,7 @@ namespace omicron
 	//////////////////////////////////////////////////////////////////////////////////////////////////
 	void owarn(const String& str)
 	{
+		TraceScope trace("owarn", "log");
 		if(sLogEnabled)
 		{
 			const char* fmt = sAppendNewline? "!!! %s\n" : "!!! %s";
@@ -161,6 +185,7 @@ namespace omicron
 	//////////////////////////////////////////////////////////////////////////////////////////////////
 	void oerror(const String& str)
 	{
+		TraceScope trace("oerror", "log");
 		if(sLogEnabled)
 		{
 			const char* fmt = sAppendNewline? "*** %s\n" : "*** %s";
@@ -297,4 +322,45 @@ namespace omicron
 		}
 #endif
 	}
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	void osetclock(IClock* clock)
+	{
+		if(clock == NULL) clock = &sSystemClock;
+		int64 elapsed = (int64)(otime() * 1000000.0);
+		sClockOffset.store(elapsed - (int64)clock->getTime(), std::memory_order_relaxed);
+		sClock.store(clock, std::memory_order_release);
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	IClock* ogetclock()
+	{
+		return sClock.load(std::memory_order_acquire);
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	uint64 oclocktime()
+	{
+		return sClock.load(std::memory_order_acquire)->getTime();
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	double otime()
+	{
+		int64 now = (int64)oclocktime();
+		int64 offset = sClockOffset.load(std::memory_order_relaxed);
+		if(offset == NoClockOffset)
+		{
+			// First call: start counting from now. Concurrent first calls agree on one origin.
+			if(sClockOffset.compare_exchange_strong(offset, -now, std::memory_order_relaxed)) offset = -now;
+		}
+		return now + offset > 0 ? (now + offset) / 1000000.0 : 0.0;
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////
+	uint otimestamp()
+	{
+		uint64 ms = oclocktime() / 1000;
+		return (uint)(ms % 1000 + ((ms / 1000) & 0xfffff) * 1000);
+	}
 }